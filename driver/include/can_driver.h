@@ -6,6 +6,28 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
+#if defined(FLEXCAN_HOST_MODEL)
+#include "flexcan_model.h"
+#endif
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Rx FIFO flags reported to the IRQ callback in place of MB5-MB7 */
+#define FLEXCAN_RX_FIFO_FLAG_AVAILABLE (0x00000020U)
+#define FLEXCAN_RX_FIFO_FLAG_WARNING (0x00000040U)
+#define FLEXCAN_RX_FIFO_FLAG_OVERFLOW (0x00000080U)
+#define FLEXCAN_RX_FIFO_FLAG_MASK (0x000000E0U)
+#define FLEXCAN_RX_FIFO_MAX_FILTER (128U)
+/* Payload bytes held by every frame in RAM, i.e. by each ring or queue slot: 8
+ * for classic CAN builds, 16, 32 or 64 for CAN FD. FlexCAN_Init refuses a
+ * wordSize whose mailboxes carry more */
+#ifndef FLEXCAN_MAX_PAYLOAD
+#define FLEXCAN_MAX_PAYLOAD (64U)
+#endif
+#if (FLEXCAN_MAX_PAYLOAD != 8U) && (FLEXCAN_MAX_PAYLOAD != 16U) && (FLEXCAN_MAX_PAYLOAD != 32U) && (FLEXCAN_MAX_PAYLOAD != 64U)
+#error "FLEXCAN_MAX_PAYLOAD must be 8, 16, 32 or 64"
+#endif
 
 /*******************************************************************************
  * Datatype Definiton
@@ -14,9 +36,25 @@ typedef enum
 {
     FLEXCAN_RETURN_CODE_SUCCESS = 0U,
     FLEXCAN_RETURN_CODE_FAIL,
-    FLEXCAN_RETURN_CODE_INVALID_INS
+    FLEXCAN_RETURN_CODE_INVALID_INS,
+    FLEXCAN_RETURN_CODE_BUSY          /* Mailbox still holds a pending frame, try again later */
 } FlexCAN_ReturnCode_t;
 
+typedef enum
+{
+    FLEXCAN_TX_STATUS_PENDING = 0U,   /* Loaded, waiting for or in arbitration */
+    FLEXCAN_TX_STATUS_DONE,           /* Sent and acknowledged */
+    FLEXCAN_TX_STATUS_ABORTED,        /* Withdrawn by an abort before it reached the bus */
+    FLEXCAN_TX_STATUS_ERROR,          /* Still pending while the instance is bus off */
+    FLEXCAN_TX_STATUS_EXPIRED         /* Handle no longer tracked, the mailbox was loaded again */
+} FlexCAN_TxStatus_t;
+
+typedef enum
+{
+    FLEXCAN_TX_ARB_LOWEST_ID = 0U,    /* Mailbox with the lowest ID is sent first */
+    FLEXCAN_TX_ARB_LOWEST_BUFFER      /* Lowest numbered mailbox is sent first */
+} FlexCAN_TxArbitration_t;
+
 typedef struct
 {
     uint32_t timeStamp : 16;
@@ -49,9 +87,80 @@ typedef struct
 {
     FlexCAN_control_MB_t cfControl;
     FlexCAN_ID_config_MB_t cfID;
-    uint8_t dataByte[64];
+    uint8_t dataByte[FLEXCAN_MAX_PAYLOAD];
+    uint64_t time;                  /* cfControl.timeStamp on the 64-bit timeline of FlexCAN_GetTime */
 } FlexCAN_TX_MessageBuffer_t;
 
+/* Control/status and ID words of a mailbox as the hardware lays them out, built
+ * with explicit shifts (CODE and TIME_STAMP left at 0). A message packed once
+ * is loaded with two stores, whatever the compiler does with bitfields */
+typedef struct
+{
+    uint32_t cs;
+    uint32_t id;
+} FlexCAN_MB_image_t;
+
+/* Data phase bit timing for CAN FD, FDCBT fields plus the transceiver delay
+ * compensation offset (0 -> compensation disabled) */
+typedef struct
+{
+    uint16_t fpresdiv;
+    uint8_t frjw;
+    uint8_t fpropseg;
+    uint8_t fpseg1;
+    uint8_t fpseg2;
+    uint8_t tdcOffset;
+} FlexCAN_fd_bit_timing_t;
+
+/* One Rx FIFO ID filter element. id and mask use the mailbox ID word layout
+ * (standard IDs in bits 28-18); mask bits set to 1 must match */
+typedef struct
+{
+    uint32_t id;
+    uint32_t mask;
+    uint8_t ide;
+    uint8_t rtr;
+} FlexCAN_RxFifo_filter_t;
+
+/* Accepted identifiers idLow to idHigh (inclusive) for FlexCAN_ConfigRxFilter,
+ * in the mailbox ID word layout like FlexCAN_RxFifo_filter_t */
+typedef struct
+{
+    uint32_t idLow;
+    uint32_t idHigh;
+    uint8_t ide;
+} FlexCAN_RxFilter_range_t;
+
+/* Counters of one instance, see FlexCAN_GetStats. Frame counts are per mailbox,
+ * Rx FIFO frames count against MB0. Interrupt durations are in core cycles on
+ * target (DWT CYCCNT) and in host nanoseconds on the host model */
+typedef struct
+{
+    uint32_t txFrames;          /* Transmit mailboxes completed */
+    uint32_t rxFrames;          /* Frames read from mailboxes, the Rx FIFO or its DMA ring */
+    uint32_t rxOverruns;        /* Mailbox overwritten before it was read (CODE 0x6), FIFO overflows */
+    uint32_t txAborts;          /* Pending transmissions withdrawn by an abort that won */
+    uint32_t busOffCount;       /* Entries into bus off seen since the last read */
+    uint8_t txErrorCounter;     /* ECR TXERRCNT at the time of the read */
+    uint8_t rxErrorCounter;     /* ECR RXERRCNT at the time of the read */
+    uint8_t faultConfinement;   /* ESR1 FLTCONF: 0 error active, 1 error passive, 2-3 bus off */
+    uint32_t irqCount;
+    uint32_t irqCyclesLast;
+    uint32_t irqCyclesMax;
+    uint64_t irqCyclesTotal;
+    uint32_t mbTxCount[32];
+    uint32_t mbRxCount[32];
+} FlexCAN_Stats_t;
+
+/* Rx FIFO output as copied by the DMA: control/status word, ID word and the
+ * payload words (big-endian, byte 0 in bits 31-24 of data[0]) */
+typedef struct
+{
+    uint32_t cs;
+    uint32_t id;
+    uint32_t data[2];
+} FlexCAN_RxFifo_dma_frame_t;
+
 typedef struct
 {
     uint8_t presdiv;
@@ -65,7 +174,20 @@ typedef struct
 /*******************************************************************************
  * APIs
  ******************************************************************************/
-typedef void (*FlexCAN_CallbackIRQ)(uint8_t);
+/* Called once per interrupt entry with the bitmask of mailboxes that raised a
+ * flag; the flags are already acknowledged, except the Rx FIFO "frames
+ * available" flag (bit 5) which is cleared by reading the FIFO */
+typedef void (*FlexCAN_CallbackIRQ)(uint32_t flagMaskMB);
+/* Transmission handle: mailbox in bits 7-0, sequence number above, never 0 */
+typedef uint32_t FlexCAN_TxHandle_t;
+#define FLEXCAN_TX_HANDLE_INVALID (0U)
+/* Called from the mailbox interrupt when an asynchronous transmission ends */
+typedef void (*FlexCAN_CallbackTx)(uint32_t instance, FlexCAN_TxHandle_t handle, FlexCAN_TxStatus_t status);
+/* Called from the DMA interrupt when a half of the ring is full, or from
+ * FlexCAN_PollRxFifoDma: frames ring[firstFrame] to
+ * ring[firstFrame + numberOfFrame - 1] are ready and stay valid until the DMA
+ * wraps around to them */
+typedef void (*FlexCAN_CallbackDMA)(uint32_t instance, uint16_t firstFrame, uint16_t numberOfFrame);
 FlexCAN_ReturnCode_t FlexCAN_Init(uint32_t instance, uint8_t wordSize, FlexCAN_bit_timing_t *bitTiming);
 FlexCAN_ReturnCode_t FlexCAN_Config_Tx_MessageBuffer(uint32_t instance, uint8_t indexOfMB, FlexCAN_TX_MessageBuffer_t *DataOfMB);
 FlexCAN_ReturnCode_t FlexCAN_Config_RX_MessageBuffer(uint32_t instance, uint8_t IndexOfMb, FlexCAN_RX_MessageBuffer_t *config);
@@ -74,6 +196,37 @@ FlexCAN_ReturnCode_t FlexCAN_Receive(uint32_t instance, uint8_t IndexOfMb, FlexC
 FlexCAN_ReturnCode_t FlexCAN_ConfigInterrupt(uint32_t instance, uint8_t IndexOfMb);
 FlexCAN_ReturnCode_t FlexCAN_InitIRQ(uint32_t instance, IRQn_Type irqIndex, FlexCAN_CallbackIRQ CAN_MiddlewareCallback);
 FlexCAN_ReturnCode_t FlexCAN_ClearInterruptFlag(uint32_t instance, uint32_t flagIndex);
+FlexCAN_ReturnCode_t FlexCAN_ConfigFD(uint32_t instance, FlexCAN_fd_bit_timing_t *fdBitTiming);
+uint8_t FlexCAN_DlcToLength(uint8_t dlc);
+uint8_t FlexCAN_LengthToDlc(uint8_t length);
+uint8_t FlexCAN_GetNumberOfMB(uint32_t instance);
+FlexCAN_ReturnCode_t FlexCAN_ConfigRxFifo(uint32_t instance, const FlexCAN_RxFifo_filter_t *filterTable, uint8_t numberOfFilter);
+FlexCAN_ReturnCode_t FlexCAN_ReadRxFifo(uint32_t instance, FlexCAN_TX_MessageBuffer_t *mbData, uint16_t *idHit);
+uint8_t FlexCAN_GetFirstFreeMB(uint32_t instance);
+FlexCAN_ReturnCode_t FlexCAN_ConfigRxFifoDma(uint32_t instance, FlexCAN_RxFifo_dma_frame_t *ring, uint16_t numberOfFrame, FlexCAN_CallbackDMA callback);
+FlexCAN_ReturnCode_t FlexCAN_PollRxFifoDma(uint32_t instance);
+void FlexCAN_DecodeRxFifoFrame(const FlexCAN_RxFifo_dma_frame_t *frame, FlexCAN_TX_MessageBuffer_t *mbData);
+FlexCAN_ReturnCode_t FlexCAN_ConfigTxArbitration(uint32_t instance, FlexCAN_TxArbitration_t arbitration);
+FlexCAN_ReturnCode_t FlexCAN_DisableIRQ(uint32_t instance);
+FlexCAN_ReturnCode_t FlexCAN_EnableIRQ(uint32_t instance);
+FlexCAN_ReturnCode_t FlexCAN_ConfigInterruptMask(uint32_t instance, uint32_t mbMask);
+FlexCAN_ReturnCode_t FlexCAN_ConfigBitTiming(uint32_t instance, FlexCAN_bit_timing_t *bitTiming);
+FlexCAN_ReturnCode_t FlexCAN_ConfigBegin(uint32_t instance);
+FlexCAN_ReturnCode_t FlexCAN_ConfigCommit(uint32_t instance);
+uint64_t FlexCAN_GetTime(uint32_t instance);
+uint64_t FlexCAN_ExtendTimeStamp(uint64_t now, uint16_t timeStamp);
+FlexCAN_ReturnCode_t FlexCAN_GetTxTimeStamp(uint32_t instance, uint8_t indexOfMB, uint64_t *timeStamp);
+void FlexCAN_PackMbImage(const FlexCAN_TX_MessageBuffer_t *mbData, FlexCAN_MB_image_t *image);
+void FlexCAN_UnpackMbImage(const FlexCAN_MB_image_t *image, FlexCAN_TX_MessageBuffer_t *mbData);
+FlexCAN_ReturnCode_t FlexCAN_Config_Tx_Image(uint32_t instance, uint8_t indexOfMB, const FlexCAN_MB_image_t *image, const uint8_t *data);
+FlexCAN_ReturnCode_t FlexCAN_SendAsync(uint32_t instance, uint8_t indexOfMB, FlexCAN_TX_MessageBuffer_t *mbData, FlexCAN_TxHandle_t *handle);
+FlexCAN_TxStatus_t FlexCAN_GetTxStatus(uint32_t instance, FlexCAN_TxHandle_t handle);
+FlexCAN_ReturnCode_t FlexCAN_AbortAsync(uint32_t instance, FlexCAN_TxHandle_t handle);
+FlexCAN_ReturnCode_t FlexCAN_ConfigTxCallback(uint32_t instance, FlexCAN_CallbackTx callback);
+FlexCAN_ReturnCode_t FlexCAN_GetStats(uint32_t instance, FlexCAN_Stats_t *stats);
+FlexCAN_ReturnCode_t FlexCAN_ResetStats(uint32_t instance);
+FlexCAN_ReturnCode_t FlexCAN_ConfigRxFilter(uint32_t instance, const FlexCAN_RxFilter_range_t *ranges, uint8_t numberOfRange,
+                                            uint32_t mbMask, uint32_t *usedMbMask);
 
 #endif /* __CAN_H__ */
 /*******************************************************************************
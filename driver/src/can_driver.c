@@ -1,6 +1,7 @@
 /*******************************************************************************
  * Include
  ******************************************************************************/
+#include <string.h>
 #include "can_driver.h"
 
 /*******************************************************************************
@@ -8,6 +9,9 @@
  ******************************************************************************/
 #define NUM_BYTES_EACH_WORD (4U)
 #define MAX_NUMBER_OF_WORD (18U)
+#define MIN_NUMBER_OF_WORD (4U)
+#define CLASSIC_MAX_DATA_LENGTH (8U)
+#define FD_MAX_DLC (15U)
 
 #define ONE_BYTE (8U)
 #define THREE_BYTES (24U)
@@ -20,6 +24,14 @@
 #define FLEXCAN_INSTANCE_2 (2u)
 
 #define CAN_INSTANCE_NUMBER (3U)
+#define MAX_IRQ_PER_INSTANCE (2U)
+
+#define MB_IRQ_MASK_0_15 (0x0000FFFFU)
+#define MB_IRQ_MASK_16_31 (0xFFFF0000U)
+
+/* CTRL1 fields written by FlexCAN_ConfigBitTiming */
+#define CTRL1_BIT_TIMING_MASK (CAN_CTRL1_PRESDIV_MASK | CAN_CTRL1_RJW_MASK | CAN_CTRL1_PSEG1_MASK | \
+                               CAN_CTRL1_PSEG2_MASK | CAN_CTRL1_SMP_MASK | CAN_CTRL1_PROPSEG_MASK)
 
 #define CODE_SEND (0xC)                /* 1100 */
 #define CODE_RECEIVE_EMPTY (0x4U)      /* 0100 */
@@ -27,6 +39,15 @@
 #define CODE_INACTIVE_RX (0x0U)           /* 0000 */
 #define CODE_INACTIVE_TX (0x8U)           /* 1000 */
 #define CODE_BUSY (0x1u)
+#define CODE_RECEIVE_OVERRUN (0x6U)    /* 0110 */
+/* IFLAG reads FlexCAN_Send spends waiting for an abort to settle */
+#define ABORT_POLL_LIMIT (64U)
+/* Transmission handle layout */
+#define TX_HANDLE_MB_MASK (0xFFU)
+#define TX_HANDLE_SEQUENCE_SHIFT (8U)
+#define TX_HANDLE_SEQUENCE_MASK (0x00FFFFFFU)
+/* ESR1 FLTCONF from this value on means bus off */
+#define FLTCONF_BUS_OFF (2U)
 
 #define OFFSET_START_OF_DATA_MB (2U)
 
@@ -39,8 +60,15 @@
 #define MB_RTR_SHIFT (20U)
 #define MB_DLC_SHIFT (16U)
 #define MB_ID_SHIFT (0U)
+#define MB_PRIO_SHIFT (29U)
 
 #define MB_ID_MASK (0x1FFFFFFFU)
+#define MB_SRR_MASK (0x00400000U)
+#define MB_EDL_MASK (0x80000000U)
+#define MB_BRS_MASK (0x40000000U)
+#define MB_ESI_MASK (0x20000000U)
+#define MB_IDE_MASK (0x00200000U)
+#define MB_RTR_MASK (0x00100000U)
 #define MB_DLC_MASK (0x000F0000U)
 #define MB_CODE_MASK (0x0F000000U)
 
@@ -48,16 +76,109 @@
 #define OFFSET_ID_OF_MB (1U)
 #define OFFSET_DATA_START_OF_MB (2U)
 
+/* Rx FIFO: output in MB0, format A filter table from MB6 */
+#define FIFO_FILTER_TABLE_WORD (24U)
+#define FIFO_FILTERS_PER_RFFN (8U)
+#define FIFO_FIRST_MB_AFTER_FIFO (8U)
+#define FIFO_FILTER_RTR_SHIFT (31U)
+#define FIFO_FILTER_IDE_SHIFT (30U)
+#define FIFO_FILTER_EXT_SHIFT (1U)
+#define FIFO_FILTER_STD_SHIFT (19U)
+#define MB_STD_ID_SHIFT (18U)
+
+/* Rx filter compiler: identifier widths and size of the working block list */
+#define FILTER_STD_ID_MASK (0x7FFU)
+#define FILTER_EXT_ID_MASK (0x1FFFFFFFU)
+#define FILTER_MAX_BLOCK (64U)
+
+/* eDMA draining of the Rx FIFO: one minor loop copies the 16 byte output in
+ * 32-bit beats and steps the source back to MB0 */
+#define FIFO_DMA_FRAME_BYTES (16U)
+#define FIFO_DMA_MAX_FRAME (0x7FFFU)
+#define DMA_TRANSFER_SIZE_32BIT (2U)
+
+/* TIME_STAMP field of the control and status word */
+#define MB_TIME_STAMP_MASK (0x0000FFFFU)
+
+/* Keep the timer extension consistent when an interrupt reads the timer too */
+#if defined(FLEXCAN_HOST_MODEL)
+#define FLEXCAN_ENTER_CRITICAL(state) ((state) = 0U)
+#define FLEXCAN_EXIT_CRITICAL(state) ((void)(state))
+#else
+#define FLEXCAN_ENTER_CRITICAL(state) __asm volatile ("mrs %0, primask\n cpsid i" : "=r" (state) :: "memory")
+#define FLEXCAN_EXIT_CRITICAL(state) __asm volatile ("msr primask, %0" :: "r" (state) : "memory")
+#endif
+
+/* Interrupt duration measurement: DWT cycle counter on target, host clock on
+ * the model */
+#if defined(FLEXCAN_HOST_MODEL)
+#define FLEXCAN_CYCLE_COUNTER_ENABLE()
+#define FLEXCAN_CYCLE_COUNT() FlexCAN_Model_CycleCount()
+#else
+#define DEMCR_TRCENA_MASK (0x01000000U)
+#define DWT_CTRL_CYCCNTENA_MASK (0x00000001U)
+#define DEMCR_REG (*(volatile uint32_t *)0xE000EDFCU)
+#define DWT_CTRL_REG (*(volatile uint32_t *)0xE0001000U)
+#define DWT_CYCCNT_REG (*(volatile uint32_t *)0xE0001004U)
+#define FLEXCAN_CYCLE_COUNTER_ENABLE() \
+    do { DEMCR_REG |= DEMCR_TRCENA_MASK; DWT_CTRL_REG |= DWT_CTRL_CYCCNTENA_MASK; } while (0)
+#define FLEXCAN_CYCLE_COUNT() DWT_CYCCNT_REG
+#endif
+
+/* Mailbox payload words are big-endian: byte 0 sits in bits 31-24 */
+#define FLEXCAN_SWAP_BYTES(x) __builtin_bswap32(x)
+
+/*******************************************************************************
+ * Datatype Definiton
+ ******************************************************************************/
+/* State owned by one FlexCAN instance, so the controllers can run side by side
+ * with their own mailbox layout */
+typedef struct
+{
+    uint8_t mbWordLength;                          /* Words per mailbox */
+    uint8_t rangeOfMB;                             /* Mailboxes that fit in this instance's RAM */
+    bool fdEnabled;
+    uint8_t firstFreeMB;                           /* First mailbox after the Rx FIFO and its filters, 0 -> no FIFO */
+    FlexCAN_CallbackIRQ callbackIrq;
+    IRQn_Type irqIndex[MAX_IRQ_PER_INSTANCE];      /* Vectors enabled by FlexCAN_InitIRQ */
+    uint8_t irqCount;
+    FlexCAN_CallbackDMA callbackDma;
+    uint16_t dmaRingFrame;                         /* Frames in the DMA ring, 0 -> FIFO read by the CPU */
+    uint16_t dmaNextFrame;                         /* First frame not yet handed to callbackDma */
+    uint8_t freezeDepth;                           /* Nested freeze requests, the module leaves freeze at 0 */
+    uint64_t timerExtended;                        /* Last TIMER value read, with its wraps counted */
+    uint32_t txMbMask;                             /* Mailboxes last loaded for transmission */
+    uint32_t asyncMbMask;                          /* Mailboxes holding a frame from FlexCAN_SendAsync */
+    uint32_t txSequence;                           /* Sequence part of the last handle given out */
+    FlexCAN_TxHandle_t txHandle[32];               /* Handle of the last frame loaded per mailbox */
+    uint8_t txStatus[32];                          /* FlexCAN_TxStatus_t of that frame */
+    FlexCAN_CallbackTx callbackTx;
+    FlexCAN_Stats_t stats;
+} FlexCAN_Context_t;
+
+/* Aligned block of identifiers: every ID whose care bits equal those of id */
+typedef struct
+{
+    uint32_t id;
+    uint32_t care;
+    uint8_t ide;
+} FlexCAN_Filter_block_t;
+
 /*******************************************************************************
  * Variable Definiion
  ******************************************************************************/
 
-static uint8_t s_mbWordLength;
-static uint8_t s_rangeOfMB;
-static FlexCAN_CallbackIRQ s_callbackIrq_0;
-static FlexCAN_CallbackIRQ s_callbackIrq_1;
-static FlexCAN_CallbackIRQ s_callbackIrq_2;
+static FlexCAN_Context_t s_context[CAN_INSTANCE_NUMBER];
 CAN_Type *const insCanBase[CAN_INSTANCE_NUMBER] = CAN_BASE_PTRS; /* (0x40024000u, 0x40025000u, 0x4002B000u } */
+/* Clock gate of each instance */
+static const uint8_t s_pccIndex[CAN_INSTANCE_NUMBER] = { PCC_FlexCAN0_INDEX, PCC_FlexCAN1_INDEX, PCC_FlexCAN2_INDEX };
+/* Mailbox RAM: CAN0 has 32 mailboxes of 16 bytes, CAN1 and CAN2 have 16 */
+static const uint16_t s_ramBytes[CAN_INSTANCE_NUMBER] = { 512U, 256U, 256U };
+/* Rx FIFO DMA channel and DMAMUX request source of each instance */
+static const uint8_t s_dmaChannel[CAN_INSTANCE_NUMBER] = { 0U, 1U, 2U };
+static const uint8_t s_dmaSource[CAN_INSTANCE_NUMBER] = { 54U, 55U, 56U };
+/* Payload length of each DLC code, codes 9-15 only exist in FD frames */
+static const uint8_t s_dlcToLength[FD_MAX_DLC + 1U] = { 0U, 1U, 2U, 3U, 4U, 5U, 6U, 7U, 8U, 12U, 16U, 20U, 24U, 32U, 48U, 64U };
 
 /*******************************************************************************
  * Prototypes
@@ -67,6 +188,17 @@ static void FlexCAN_Exit_Freeze_Mode(uint32_t instance);
 static void FlexCAN_Clear_Message_Buffer(uint32_t instance);
 static void FlexCAN_Set_Bit_Rate(uint32_t instance, FlexCAN_bit_timing_t *bit_timing);
 static FlexCAN_ReturnCode_t FlexCAN_Get_Base_Address(uint32_t instance, CAN_Type **bassAddress);
+static void FlexCAN_Write_Payload(CAN_Type *sp_base, uint32_t indexOfRAM, const uint8_t *data, uint8_t length);
+static void FlexCAN_Read_Payload(CAN_Type *sp_base, uint32_t indexOfRAM, uint8_t *data, uint8_t length);
+static uint32_t FlexCAN_Fifo_Filter_Word(uint32_t id, uint8_t ide, uint8_t rtr);
+static uint64_t FlexCAN_Read_Timer(uint32_t instance, CAN_Type *sp_base);
+static void FlexCAN_Stats_Irq(FlexCAN_Stats_t *stats, uint32_t cycles);
+static void FlexCAN_Tx_Settle(uint32_t instance, uint8_t indexOfMB, uint32_t code);
+static void FlexCAN_Tx_Account(FlexCAN_Context_t *ctx, uint8_t indexOfMB, uint32_t code);
+static void FlexCAN_DMA_Deliver(uint32_t instance, uint16_t firstFrame, uint16_t numberOfFrame);
+static void FlexCAN_DMA_Collect(uint32_t instance);
+static uint8_t FlexCAN_Filter_Merge(FlexCAN_Filter_block_t *block, uint8_t count, uint8_t limit);
+static uint8_t FlexCAN_Filter_Add_Range(FlexCAN_Filter_block_t *block, uint8_t count, const FlexCAN_RxFilter_range_t *range);
 
 /*******************************************************************************
  * Function
@@ -95,24 +227,31 @@ static FlexCAN_ReturnCode_t FlexCAN_Get_Base_Address(uint32_t instance, CAN_Type
     return retVal;
 }
 
+/* Freeze requests nest: only the outermost enter and exit touch the module, so
+ * configuration calls made between FlexCAN_ConfigBegin and FlexCAN_ConfigCommit
+ * share one freeze window */
 static void FlexCAN_Enter_Freeze_Mode(uint32_t instance)
 {
     FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
     CAN_Type *sp_base;
 
     retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
-    /* Enable to enter FreezeMode */
-    sp_base->MCR = (sp_base->MCR & ~CAN_MCR_FRZ_MASK) | CAN_MCR_FRZ(1U);
-    /* Enter FreezeMode */
-    sp_base->MCR = (sp_base->MCR & ~CAN_MCR_HALT_MASK) | CAN_MCR_HALT(1U);
-    /* Check whether bit MDIS in CAN_MCR is set to 1. If it is, clear it to 0 */
-    if (((sp_base->MCR & CAN_MCR_MDIS_MASK) >> CAN_MCR_MDIS_SHIFT) != 0U)
-    {
-        sp_base->MCR &= ~CAN_MCR_MDIS_MASK;
-    }
-    while ((sp_base->MCR & CAN_MCR_FRZACK_MASK) == 0U)
+    s_context[instance].freezeDepth++;
+    if (s_context[instance].freezeDepth == 1U)
     {
-        /* do nothing to wait enter freezeMode */
+        /* Enable to enter FreezeMode */
+        sp_base->MCR = (sp_base->MCR & ~CAN_MCR_FRZ_MASK) | CAN_MCR_FRZ(1U);
+        /* Enter FreezeMode */
+        sp_base->MCR = (sp_base->MCR & ~CAN_MCR_HALT_MASK) | CAN_MCR_HALT(1U);
+        /* Check whether bit MDIS in CAN_MCR is set to 1. If it is, clear it to 0 */
+        if (((sp_base->MCR & CAN_MCR_MDIS_MASK) >> CAN_MCR_MDIS_SHIFT) != 0U)
+        {
+            sp_base->MCR &= ~CAN_MCR_MDIS_MASK;
+        }
+        while ((sp_base->MCR & CAN_MCR_FRZACK_MASK) == 0U)
+        {
+            /* do nothing to wait enter freezeMode */
+        }
     }
 }
 
@@ -122,19 +261,26 @@ static void FlexCAN_Exit_Freeze_Mode(uint32_t instance)
     CAN_Type *sp_base;
 
     retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
-    /* No Freeze mode request */
-    sp_base->MCR = (sp_base->MCR & ~CAN_MCR_HALT_MASK) | CAN_MCR_HALT(0U);
-    /* Disable to enter FreezeMode */
-    sp_base->MCR = (sp_base->MCR & ~CAN_MCR_FRZ_MASK) | CAN_MCR_FRZ(0U);
-    
-    while ((sp_base->MCR & CAN_MCR_FRZACK_MASK) != 0U)
+    if (s_context[instance].freezeDepth != 0U)
     {
-        /* do nothing to sure exit freezeMode */
+        s_context[instance].freezeDepth--;
     }
-    /* Check FlexCAN module is either in Normal mode, Listen-Only mode, or Loop-Back mode */
-    while ((sp_base->MCR & CAN_MCR_NOTRDY_MASK) != 0U)
+    if (s_context[instance].freezeDepth == 0U)
     {
-        /* do nothing */
+        /* No Freeze mode request */
+        sp_base->MCR = (sp_base->MCR & ~CAN_MCR_HALT_MASK) | CAN_MCR_HALT(0U);
+        /* Disable to enter FreezeMode */
+        sp_base->MCR = (sp_base->MCR & ~CAN_MCR_FRZ_MASK) | CAN_MCR_FRZ(0U);
+
+        while ((sp_base->MCR & CAN_MCR_FRZACK_MASK) != 0U)
+        {
+            /* do nothing to sure exit freezeMode */
+        }
+        /* Check FlexCAN module is either in Normal mode, Listen-Only mode, or Loop-Back mode */
+        while ((sp_base->MCR & CAN_MCR_NOTRDY_MASK) != 0U)
+        {
+            /* do nothing */
+        }
     }
 }
 
@@ -168,66 +314,193 @@ static void FlexCAN_Set_Bit_Rate(uint32_t instance, FlexCAN_bit_timing_t *bitTim
                      CAN_CTRL1_PROPSEG(bitTiming->propseg);
 }
 
-FlexCAN_ReturnCode_t FlexCAN_Config_Tx_MessageBuffer(uint32_t instance, uint8_t indexOfMB, FlexCAN_TX_MessageBuffer_t *DataOfMB)
+/* Assemble each payload word in a register and write it with a single store;
+ * only length bytes of data are read, the rest of the last word is sent as zero */
+static void FlexCAN_Write_Payload(CAN_Type *sp_base, uint32_t indexOfRAM, const uint8_t *data, uint8_t length)
+{
+    uint32_t word;
+    uint8_t indexOfWord = 0;
+    uint8_t numOfWord = (uint8_t)((length + NUM_BYTES_EACH_WORD - 1U) / NUM_BYTES_EACH_WORD);
+    uint8_t remainBytes = length % NUM_BYTES_EACH_WORD;
+
+    for (indexOfWord = 0; indexOfWord < numOfWord; indexOfWord++)
+    {
+        if ((indexOfWord == (numOfWord - 1U)) && (remainBytes != 0U))
+        {
+            word = 0U;
+            memcpy(&word, &data[indexOfWord * NUM_BYTES_EACH_WORD], remainBytes);
+        }
+        else
+        {
+            memcpy(&word, &data[indexOfWord * NUM_BYTES_EACH_WORD], NUM_BYTES_EACH_WORD);
+        }
+        sp_base->RAMn[indexOfRAM + indexOfWord] = FLEXCAN_SWAP_BYTES(word);
+    }
+}
+
+/* One load per payload word; whole words are copied, so data must have room for
+ * the length rounded up to a multiple of 4 */
+static void FlexCAN_Read_Payload(CAN_Type *sp_base, uint32_t indexOfRAM, uint8_t *data, uint8_t length)
+{
+    uint32_t word;
+    uint8_t indexOfWord = 0;
+    uint8_t numOfWord = (uint8_t)((length + NUM_BYTES_EACH_WORD - 1U) / NUM_BYTES_EACH_WORD);
+
+    for (indexOfWord = 0; indexOfWord < numOfWord; indexOfWord++)
+    {
+        word = FLEXCAN_SWAP_BYTES(sp_base->RAMn[indexOfRAM + indexOfWord]);
+        memcpy(&data[indexOfWord * NUM_BYTES_EACH_WORD], &word, NUM_BYTES_EACH_WORD);
+    }
+}
+
+/* Read the 16-bit free running timer (one tick per nominal bit) and extend it to
+ * 64 bits by counting wraps since the previous read; the timer has to be read at
+ * least once per 65536 bit times for no wrap to be missed */
+static uint64_t FlexCAN_Read_Timer(uint32_t instance, CAN_Type *sp_base)
+{
+    FlexCAN_Context_t *ctx = &s_context[instance];
+    uint32_t state;
+    uint64_t now;
+
+    FLEXCAN_ENTER_CRITICAL(state);
+    now = ctx->timerExtended;
+    now += (uint16_t)((uint16_t)(sp_base->TIMER & CAN_TIMER_TIMER_MASK) - (uint16_t)now);
+    ctx->timerExtended = now;
+    FLEXCAN_EXIT_CRITICAL(state);
+
+    return now;
+}
+
+void FlexCAN_PackMbImage(const FlexCAN_TX_MessageBuffer_t *mbData, FlexCAN_MB_image_t *image)
+{
+    image->cs = ((uint32_t)mbData->cfControl.edl << MB_EDL_SHIFT) |
+                ((uint32_t)mbData->cfControl.brs << MB_BRS_SHIFT) |
+                ((uint32_t)mbData->cfControl.esi << MB_ESI_SHIFT) |
+                ((uint32_t)mbData->cfControl.srr << MB_SRR_SHIFT) |
+                ((uint32_t)mbData->cfControl.ide << MB_IDE_SHIFT) |
+                ((uint32_t)mbData->cfControl.rtr << MB_RTR_SHIFT) |
+                ((uint32_t)mbData->cfControl.dlc << MB_DLC_SHIFT);
+    image->id = ((uint32_t)mbData->cfID.prio << MB_PRIO_SHIFT) | (((uint32_t)mbData->cfID.id << MB_ID_SHIFT) & MB_ID_MASK);
+}
+
+/* Every cfControl and cfID field from the words read out of a mailbox */
+void FlexCAN_UnpackMbImage(const FlexCAN_MB_image_t *image, FlexCAN_TX_MessageBuffer_t *mbData)
+{
+    mbData->cfControl.timeStamp = image->cs & MB_TIME_STAMP_MASK;
+    mbData->cfControl.dlc = (image->cs & MB_DLC_MASK) >> MB_DLC_SHIFT;
+    mbData->cfControl.rtr = (image->cs & MB_RTR_MASK) >> MB_RTR_SHIFT;
+    mbData->cfControl.ide = (image->cs & MB_IDE_MASK) >> MB_IDE_SHIFT;
+    mbData->cfControl.srr = (image->cs & MB_SRR_MASK) >> MB_SRR_SHIFT;
+    mbData->cfControl.code = (image->cs & MB_CODE_MASK) >> MB_CODE_SHIFT;
+    mbData->cfControl.esi = (image->cs & MB_ESI_MASK) >> MB_ESI_SHIFT;
+    mbData->cfControl.brs = (image->cs & MB_BRS_MASK) >> MB_BRS_SHIFT;
+    mbData->cfControl.edl = (image->cs & MB_EDL_MASK) >> MB_EDL_SHIFT;
+    mbData->cfID.id = (image->id & MB_ID_MASK) >> MB_ID_SHIFT;
+    mbData->cfID.prio = image->id >> MB_PRIO_SHIFT;
+}
+
+/*
+ * Load a transmit mailbox from a packed image: payload, then the ID word, then
+ * the CS word with CODE = DATA, which starts the transmission. The length comes
+ * from the image DLC; DLC codes 9-15 carry 12-64 bytes in FD frames and 8 bytes
+ * in classic frames
+ */
+FlexCAN_ReturnCode_t FlexCAN_Config_Tx_Image(uint32_t instance, uint8_t indexOfMB, const FlexCAN_MB_image_t *image, const uint8_t *data)
 {
     CAN_Type *sp_base;
     uint8_t dataLength = 0;
-    uint8_t indexOfData = 0;
     FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
-    uint8_t byteIndex = 0;
-    uint8_t IndexOfRAM = 0;
-    uint32_t *mbData;
+    FlexCAN_Context_t *ctx;
+    uint32_t indexOfRAM = 0;
+    bool edl;
 
-    mbData = DataOfMB;
     retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
-    /* DLC max value is 8  with CAN 2.0 standard frame */
-    if (indexOfMB <= s_rangeOfMB)
-    {
-        dataLength = (uint8_t)(DataOfMB->cfControl.dlc);
-        /* Write the payload date bytes */
-        for (indexOfData = 0; indexOfData < dataLength; indexOfData++)
-        {
-            byteIndex = indexOfData / NUM_BYTES_EACH_WORD;
-            IndexOfRAM = indexOfMB * s_mbWordLength + OFFSET_START_OF_DATA_MB + byteIndex;
-            /* write data for each byte of word by sequence */
-            sp_base->RAMn[IndexOfRAM] = sp_base->RAMn[IndexOfRAM] << ONE_BYTE;
-            sp_base->RAMn[IndexOfRAM] |= DataOfMB->dataByte[indexOfData];
-        }
-        /* Config the Control and Status word with desired configuration */
-        sp_base->RAMn[indexOfMB * s_mbWordLength + OFFSET_START_OF_MB] = 0U;
-        sp_base->RAMn[indexOfMB * s_mbWordLength + OFFSET_START_OF_MB] = *mbData;
-        sp_base->RAMn[indexOfMB * s_mbWordLength + OFFSET_ID_OF_MB] = 0U;
-        sp_base->RAMn[indexOfMB * s_mbWordLength + OFFSET_ID_OF_MB] = *(mbData + 1);
-        /* Activate the message buffer to transmit the CAN frame */
-        sp_base->RAMn[indexOfMB * s_mbWordLength + OFFSET_START_OF_MB] &= ~(MB_CODE_MASK);
-        sp_base->RAMn[indexOfMB * s_mbWordLength + OFFSET_START_OF_MB] |= (CODE_SEND << MB_CODE_SHIFT);
-        retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+    if ((retVal == FLEXCAN_RETURN_CODE_SUCCESS) && (image != NULL) && (data != NULL) &&
+        (indexOfMB < s_context[instance].rangeOfMB))
+    {
+        ctx = &s_context[instance];
+        indexOfRAM = indexOfMB * ctx->mbWordLength;
+        edl = ((image->cs & MB_EDL_MASK) != 0U);
+        dataLength = FlexCAN_DlcToLength((uint8_t)((image->cs & MB_DLC_MASK) >> MB_DLC_SHIFT));
+        if ((!edl) && (dataLength > CLASSIC_MAX_DATA_LENGTH))
+        {
+            dataLength = CLASSIC_MAX_DATA_LENGTH;
+        }
+        /* Frame must fit in the mailbox and FD frames need FD mode */
+        if ((dataLength <= (ctx->mbWordLength - OFFSET_START_OF_DATA_MB) * NUM_BYTES_EACH_WORD) &&
+            ((!edl) || (ctx->fdEnabled)))
+        {
+            FlexCAN_Write_Payload(sp_base, indexOfRAM + OFFSET_START_OF_DATA_MB, data, dataLength);
+            sp_base->RAMn[indexOfRAM + OFFSET_ID_OF_MB] = image->id;
+            sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] = (image->cs & ~(MB_CODE_MASK | MB_TIME_STAMP_MASK)) |
+                                                              (CODE_SEND << MB_CODE_SHIFT);
+            ctx->txMbMask |= (1UL << indexOfMB);
+            ctx->asyncMbMask &= ~(1UL << indexOfMB);
+            retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+        }
+        else
+        {
+            retVal = FLEXCAN_RETURN_CODE_FAIL;
+        }
+    }
+    else
+    {
+        retVal = FLEXCAN_RETURN_CODE_FAIL;
+    }
+
+    return retVal;
+}
+
+FlexCAN_ReturnCode_t FlexCAN_Config_Tx_MessageBuffer(uint32_t instance, uint8_t indexOfMB, FlexCAN_TX_MessageBuffer_t *DataOfMB)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    FlexCAN_MB_image_t image;
+
+    if (DataOfMB != NULL)
+    {
+        FlexCAN_PackMbImage(DataOfMB, &image);
+        retVal = FlexCAN_Config_Tx_Image(instance, indexOfMB, &image, DataOfMB->dataByte);
     }
 
     return retVal;
 }
 
-/* CAN FD disable, IRMQ disable */
+/* IRMQ disable, CAN FD is enabled afterwards with FlexCAN_ConfigFD */
 /*
  * wordSize = 4: -> 8 bytes payload -> plus 2 word for configuration field
- * wordSize = 6: -> 16 bytes payload
- * wordSize = 10: -> 32 bytes payload
- * wordSize = 18: -> 64 bytes payload
+ * wordSize = 6: -> 16 bytes payload (CAN FD only)
+ * wordSize = 10: -> 32 bytes payload (CAN FD only)
+ * wordSize = 18: -> 64 bytes payload (CAN FD only)
  */
 FlexCAN_ReturnCode_t FlexCAN_Init(uint32_t instance, uint8_t wordSize, FlexCAN_bit_timing_t *bitTiming)
 {
     FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
     CAN_Type *sp_base;
+    FlexCAN_Context_t *ctx;
 
     retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
     if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
     {
-        if ((instance < CAN_INSTANCE_COUNT) && (bitTiming != NULL) && (wordSize <= MAX_NUMBER_OF_WORD))
+        if ((instance < CAN_INSTANCE_COUNT) && (bitTiming != NULL) &&
+            (wordSize >= MIN_NUMBER_OF_WORD) && (wordSize <= MAX_NUMBER_OF_WORD) &&
+            (((wordSize - OFFSET_START_OF_DATA_MB) * NUM_BYTES_EACH_WORD) <= FLEXCAN_MAX_PAYLOAD))
         {
-            s_mbWordLength = wordSize;
-            s_rangeOfMB = (uint8_t)(512 / (s_mbWordLength * NUM_BYTES_EACH_WORD));
-            /* enable clock to CAN_Driver0 */
-            PCC->PCCn[PCC_FlexCAN0_INDEX] |= PCC_PCCn_CGC_MASK;
+            ctx = &s_context[instance];
+            ctx->mbWordLength = wordSize;
+            ctx->rangeOfMB = (uint8_t)(s_ramBytes[instance] / (wordSize * NUM_BYTES_EACH_WORD));
+            ctx->fdEnabled = false;
+            ctx->firstFreeMB = 0U;
+            ctx->dmaRingFrame = 0U;
+            ctx->freezeDepth = 0U;
+            ctx->timerExtended = 0U;
+            ctx->txMbMask = 0U;
+            ctx->asyncMbMask = 0U;
+            ctx->callbackTx = NULL;
+            memset(&ctx->txHandle, 0, sizeof(ctx->txHandle));
+            memset(&ctx->stats, 0, sizeof(ctx->stats));
+            FLEXCAN_CYCLE_COUNTER_ENABLE();
+            /* enable clock to this instance */
+            PCC->PCCn[s_pccIndex[instance]] |= PCC_PCCn_CGC_MASK;
             /* Disable module before selecting clock   */
             sp_base->MCR |= CAN_MCR_MDIS_MASK;
             /* CLKSRC=0 -> CAN engine clock source is the oscillator clock, the oscillator clock frequency must be lower than bus clock */
@@ -236,8 +509,12 @@ FlexCAN_ReturnCode_t FlexCAN_Init(uint32_t instance, uint8_t wordSize, FlexCAN_b
             FlexCAN_Enter_Freeze_Mode(instance);
             FlexCAN_Set_Bit_Rate(instance, bitTiming);
             FlexCAN_Clear_Message_Buffer(instance);
+            /* Make every mailbox that fits in RAM take part in matching and arbitration */
+            sp_base->MCR = (sp_base->MCR & ~CAN_MCR_MAXMB_MASK) | CAN_MCR_MAXMB(ctx->rangeOfMB - 1U);
             /* Self-reception disabled -> module cannot receive frames which are transmitted by itself */
             sp_base->MCR = (sp_base->MCR & ~CAN_MCR_SRXDIS_MASK) | CAN_MCR_SRXDIS(1U);
+            /* Abort enabled -> an ABORT code withdraws a pending frame and reports through IFLAG */
+            sp_base->MCR |= CAN_MCR_AEN_MASK;
             /* Exit freeze mode */
             FlexCAN_Exit_Freeze_Mode(instance);
             /* Check whether FlexCAN is synchronized to the CAN bus and able to join communication process */
@@ -255,36 +532,45 @@ FlexCAN_ReturnCode_t FlexCAN_Init(uint32_t instance, uint8_t wordSize, FlexCAN_b
     return retVal;
 }
 
-FlexCAN_ReturnCode_t FlexCAN_Config_RX_MessageBuffer(uint32_t instance, uint8_t IndexOfMb, FlexCAN_RX_MessageBuffer_t *config)
+/*
+ * Switch an initialized instance to ISO CAN FD with bit rate switching allowed.
+ * The mailbox data size follows the wordSize given to FlexCAN_Init (6, 10 or 18
+ * words -> 16, 32 or 64 bytes, 4 -> 8 bytes), mailbox RAM is cleared because
+ * its layout changes. BRS is then chosen per frame through cfControl.brs
+ */
+FlexCAN_ReturnCode_t FlexCAN_ConfigFD(uint32_t instance, FlexCAN_fd_bit_timing_t *fdBitTiming)
 {
-    uint8_t index = 0;
     FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
     CAN_Type *sp_base;
+    FlexCAN_Context_t *ctx;
+    uint32_t dataSize = 0;
 
     retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
     if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
     {
-        if ((config->cfID.id <= MB_ID_MASK) && (IndexOfMb <= s_rangeOfMB))
+        ctx = &s_context[instance];
+        /* Payload of 2, 4, 8 or 16 words */
+        dataSize = (uint32_t)(ctx->mbWordLength - OFFSET_START_OF_DATA_MB) / 2U;
+        if ((fdBitTiming != NULL) && (ctx->firstFreeMB == 0U) && (ctx->mbWordLength >= MIN_NUMBER_OF_WORD) &&
+            ((ctx->mbWordLength % 2U) == 0U) && ((dataSize & (dataSize - 1U)) == 0U))
         {
-            if ((((sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_START_OF_MB]) >> MB_CODE_SHIFT) & 0x0F) != CODE_INACTIVE_RX)
-            {
-                sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_START_OF_MB] &= ~(MB_CODE_MASK);
-                sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_START_OF_MB] |= (CODE_INACTIVE_RX << MB_CODE_SHIFT);
-            }
+            /* MBDSR0: 0 -> 8 bytes, 1 -> 16 bytes, 2 -> 32 bytes, 3 -> 64 bytes */
+            dataSize = (uint32_t)__builtin_ctz(dataSize);
             FlexCAN_Enter_Freeze_Mode(instance);
-            /* Set Rx Global mask*/
-            sp_base->RXMGMASK = 0;
-            sp_base->RXMGMASK = config->RxIdMask;
-            /* Set Rx Global mask */
-            sp_base->RXIMR[1] = 0;
+            sp_base->MCR |= CAN_MCR_FDEN_MASK;
+            sp_base->CTRL2 |= CAN_CTRL2_ISOCANFDEN_MASK;
+            sp_base->FDCBT = CAN_FDCBT_FPRESDIV(fdBitTiming->fpresdiv) |
+                             CAN_FDCBT_FRJW(fdBitTiming->frjw) |
+                             CAN_FDCBT_FPROPSEG(fdBitTiming->fpropseg) |
+                             CAN_FDCBT_FPSEG1(fdBitTiming->fpseg1) |
+                             CAN_FDCBT_FPSEG2(fdBitTiming->fpseg2);
+            sp_base->FDCTRL = CAN_FDCTRL_FDRATE(1U) |
+                              CAN_FDCTRL_MBDSR0(dataSize) |
+                              CAN_FDCTRL_TDCEN((fdBitTiming->tdcOffset != 0U) ? 1U : 0U) |
+                              CAN_FDCTRL_TDCOFF(fdBitTiming->tdcOffset);
+            FlexCAN_Clear_Message_Buffer(instance);
             FlexCAN_Exit_Freeze_Mode(instance);
-            /* Set config for MB, write 0b0100 to Control and Status word to activate MB */
-            sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_START_OF_MB] &= ~(MB_CODE_MASK);
-            sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_START_OF_MB] = (CODE_RECEIVE_EMPTY << MB_CODE_SHIFT) | (config->cfControl.ide << MB_IDE_SHIFT);
-            /* Write the ID word */
-            sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_ID_OF_MB] = 0;
-            sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_ID_OF_MB] = config->cfID.id;
-            retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+            ctx->fdEnabled = true;
         }
         else
         {
@@ -295,59 +581,84 @@ FlexCAN_ReturnCode_t FlexCAN_Config_RX_MessageBuffer(uint32_t instance, uint8_t
     return retVal;
 }
 
-FlexCAN_ReturnCode_t FlexCAN_ClearInterruptFlag(uint32_t instance, uint32_t flagIndex)
+/* Filter element in format A: RTR bit 31, IDE bit 30, extended ID in bits 29-1
+ * or standard ID in bits 29-19 */
+static uint32_t FlexCAN_Fifo_Filter_Word(uint32_t id, uint8_t ide, uint8_t rtr)
 {
-    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
-    CAN_Type *sp_base;
+    uint32_t word = ((uint32_t)(rtr & 1U) << FIFO_FILTER_RTR_SHIFT) | ((uint32_t)(ide & 1U) << FIFO_FILTER_IDE_SHIFT);
 
-    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
-    if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+    if (ide != 0U)
     {
-        if (flagIndex <= s_rangeOfMB)
-        {
-            sp_base->IFLAG1 |= (1 << flagIndex);
-            retVal = FLEXCAN_RETURN_CODE_SUCCESS;
-        }
-        else
-        {
-            retVal = FLEXCAN_RETURN_CODE_FAIL;
-        }
+        word |= (id & MB_ID_MASK) << FIFO_FILTER_EXT_SHIFT;
+    }
+    else
+    {
+        word |= ((id & MB_ID_MASK) >> MB_STD_ID_SHIFT) << FIFO_FILTER_STD_SHIFT;
     }
 
-    return retVal;
+    return word;
 }
 
-FlexCAN_ReturnCode_t FlexCAN_Send(uint32_t instance, uint8_t IndexOfMb, FlexCAN_TX_MessageBuffer_t *mbData)
+/*
+ * Enable the 6 frame deep Rx FIFO (MB0-5) with an ID filter table in format A.
+ * The table grows in steps of 8 elements (RFFN), each step taking 2 mailboxes
+ * after MB5; unused elements repeat the last filter. Individual masking is on:
+ * the first 8 + 2 * RFFN elements have their own mask, the rest share RXFGMASK
+ * set to the intersection of their masks so none of them loses frames. Regular
+ * mailboxes after the table keep the global mask through their RXIMR entry.
+ * Classic CAN with 4 word mailboxes only; frames are read with FlexCAN_ReadRxFifo
+ */
+FlexCAN_ReturnCode_t FlexCAN_ConfigRxFifo(uint32_t instance, const FlexCAN_RxFifo_filter_t *filterTable, uint8_t numberOfFilter)
 {
     FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
     CAN_Type *sp_base;
+    FlexCAN_Context_t *ctx;
+    const FlexCAN_RxFifo_filter_t *filter;
+    uint32_t rffn = 0;
+    uint32_t firstFreeMB = 0;
+    uint32_t globalMask = 0;
+    uint32_t mask = 0;
+    uint32_t index = 0;
 
     retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
     if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
     {
-        if (mbData != NULL)
+        ctx = &s_context[instance];
+        if ((filterTable != NULL) && (numberOfFilter != 0U))
         {
-            /* Clear interrupt flag */
-            retVal = FlexCAN_ClearInterruptFlag(instance, IndexOfMb);
-            /* Check whether MB is active */
-            if (((((sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_START_OF_MB]) >> MB_CODE_SHIFT) & 0x0F) != CODE_INACTIVE_TX) &&
-                ((((sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_START_OF_MB]) >> MB_CODE_SHIFT) & 0x0F) != CODE_ABORT_TRANSMISSION) &&
-                ((((sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_START_OF_MB]) >> MB_CODE_SHIFT) & 0x0F) != CODE_INACTIVE_RX))
+            rffn = ((uint32_t)numberOfFilter + FIFO_FILTERS_PER_RFFN - 1U) / FIFO_FILTERS_PER_RFFN - 1U;
+            firstFreeMB = FIFO_FIRST_MB_AFTER_FIFO + 2U * rffn;
+        }
+        if ((firstFreeMB != 0U) && (firstFreeMB <= ctx->rangeOfMB) &&
+            (!ctx->fdEnabled) && (ctx->mbWordLength == MIN_NUMBER_OF_WORD))
+        {
+            FlexCAN_Enter_Freeze_Mode(instance);
+            sp_base->MCR = (sp_base->MCR & ~CAN_MCR_IDAM_MASK) | CAN_MCR_RFEN_MASK | CAN_MCR_IRMQ_MASK | CAN_MCR_IDAM(0U);
+            /* MRP = 0: the FIFO is matched before the mailboxes */
+            sp_base->CTRL2 = (sp_base->CTRL2 & ~(CAN_CTRL2_RFFN_MASK | CAN_CTRL2_MRP_MASK)) | CAN_CTRL2_RFFN(rffn);
+            globalMask = 0xFFFFFFFFU;
+            for (index = 0U; index < FIFO_FILTERS_PER_RFFN * (rffn + 1U); index++)
             {
-                /* Write ABORT code to the CODE field */
-                sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_START_OF_MB] &= ~(MB_CODE_MASK);
-                sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_START_OF_MB] |= (CODE_ABORT_TRANSMISSION << MB_CODE_SHIFT);
-                /* Wait for the corresponding IFLAG bit to be asserted */
-                while (((sp_base->IFLAG1) >> IndexOfMb) == 0U)
+                filter = &filterTable[(index < numberOfFilter) ? index : (numberOfFilter - 1U)];
+                sp_base->RAMn[FIFO_FILTER_TABLE_WORD + index] = FlexCAN_Fifo_Filter_Word(filter->id, filter->ide, filter->rtr);
+                /* IDE and RTR always have to match */
+                mask = FlexCAN_Fifo_Filter_Word(filter->mask, filter->ide, 1U) | (1UL << FIFO_FILTER_IDE_SHIFT);
+                if (index < firstFreeMB)
                 {
-                    /* Do nothing */
+                    sp_base->RXIMR[index] = mask;
+                }
+                else
+                {
+                    globalMask &= mask;
                 }
-                /* Clear the corresponding IFLAG */
-                retVal = FlexCAN_ClearInterruptFlag(instance, IndexOfMb);
             }
-            /* Config TX message buffer to send */
-            retVal = FlexCAN_Config_Tx_MessageBuffer(instance, IndexOfMb, mbData);
-            retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+            sp_base->RXFGMASK = globalMask;
+            for (index = firstFreeMB; index < ctx->rangeOfMB; index++)
+            {
+                sp_base->RXIMR[index] = sp_base->RXMGMASK;
+            }
+            FlexCAN_Exit_Freeze_Mode(instance);
+            ctx->firstFreeMB = (uint8_t)firstFreeMB;
         }
         else
         {
@@ -358,33 +669,39 @@ FlexCAN_ReturnCode_t FlexCAN_Send(uint32_t instance, uint8_t IndexOfMb, FlexCAN_
     return retVal;
 }
 
-FlexCAN_ReturnCode_t FlexCAN_Receive(uint32_t instance, uint8_t IndexOfMb, FlexCAN_TX_MessageBuffer_t *mbData)
+/* Read the frame at the FIFO output and pop it by clearing the "frames available"
+ * flag. Fails when the FIFO is off or empty, so callers drain with a loop */
+FlexCAN_ReturnCode_t FlexCAN_ReadRxFifo(uint32_t instance, FlexCAN_TX_MessageBuffer_t *mbData, uint16_t *idHit)
 {
-    uint8_t indexData = 0;
     FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
     CAN_Type *sp_base;
+    FlexCAN_MB_image_t image;
+    uint8_t dataLength = 0;
 
     retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
     if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
     {
-        if (IndexOfMb <= s_rangeOfMB)
+        if ((mbData != NULL) && (s_context[instance].firstFreeMB != 0U) &&
+            ((sp_base->IFLAG1 & FLEXCAN_RX_FIFO_FLAG_AVAILABLE) != 0U))
         {
-            /* Waiting CAN update mailbox data by move-in process, wait for busy bit be negated */
-            while ((sp_base->RAMn[IndexOfMb * s_mbWordLength] >> MB_CODE_SHIFT) & CODE_BUSY)
+            /* FIFO frames are classic, the FD bits of the CS word read 0 */
+            image.cs = sp_base->RAMn[OFFSET_START_OF_MB];
+            image.id = sp_base->RAMn[OFFSET_ID_OF_MB] & MB_ID_MASK;
+            FlexCAN_UnpackMbImage(&image, mbData);
+            mbData->time = FlexCAN_ExtendTimeStamp(FlexCAN_Read_Timer(instance, sp_base), (uint16_t)mbData->cfControl.timeStamp);
+            dataLength = FlexCAN_DlcToLength((uint8_t)mbData->cfControl.dlc);
+            if (dataLength > CLASSIC_MAX_DATA_LENGTH)
             {
-                /* Do nothing */
+                dataLength = CLASSIC_MAX_DATA_LENGTH;
             }
-            /* Get data and configuration from MB */
-            mbData->cfID.id = 0;
-            mbData->cfID.id = (sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_ID_OF_MB] & MB_ID_MASK) >> MB_ID_SHIFT;
-            mbData->cfControl.dlc = (sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_START_OF_MB] & MB_DLC_MASK) >> MB_DLC_SHIFT;
-            for (indexData = 0U; indexData < (uint8_t)mbData->cfControl.dlc; indexData++)
+            FlexCAN_Read_Payload(sp_base, OFFSET_DATA_START_OF_MB, mbData->dataByte, dataLength);
+            if (idHit != NULL)
             {
-                mbData->dataByte[indexData] = (uint8_t)(sp_base->RAMn[IndexOfMb * s_mbWordLength + OFFSET_DATA_START_OF_MB + (indexData / NUM_BYTES_EACH_WORD)] >> (THREE_BYTES - ONE_BYTE * (indexData % NUM_BYTES_EACH_WORD)));
+                *idHit = (uint16_t)(sp_base->RXFIR & CAN_RXFIR_IDHIT_MASK);
             }
-            mbData->cfID.prio = 0;
-            /* Read free running timer to unlock mailbox */
-            (void)sp_base->TIMER;
+            sp_base->IFLAG1 = FLEXCAN_RX_FIFO_FLAG_AVAILABLE;
+            s_context[instance].stats.rxFrames++;
+            s_context[instance].stats.mbRxCount[OFFSET_START_OF_MB]++;
             retVal = FLEXCAN_RETURN_CODE_SUCCESS;
         }
         else
@@ -396,49 +713,163 @@ FlexCAN_ReturnCode_t FlexCAN_Receive(uint32_t instance, uint8_t IndexOfMb, FlexC
     return retVal;
 }
 
-FlexCAN_ReturnCode_t FlexCAN_ConfigInterrupt(uint32_t instance, uint8_t IndexOfMb)
+/*
+ * Let the eDMA empty the Rx FIFO into a ring of numberOfFrame raw frames
+ * instead of taking one interrupt per frame. Instance n uses DMA channel n.
+ * The channel interrupts at the half and at the end of the ring and callback
+ * gets the frames filled since the last delivery; frames below the next
+ * watermark wait in the ring until FlexCAN_PollRxFifoDma hands them over. The
+ * FIFO interrupts (IMASK1 bits 5-7) are turned off, the FIFO must be
+ * configured first and numberOfFrame must be even
+ */
+FlexCAN_ReturnCode_t FlexCAN_ConfigRxFifoDma(uint32_t instance, FlexCAN_RxFifo_dma_frame_t *ring, uint16_t numberOfFrame, FlexCAN_CallbackDMA callback)
 {
     FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
     CAN_Type *sp_base;
+    FlexCAN_Context_t *ctx;
+    uint8_t channel = 0;
 
     retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
     if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
     {
-        FlexCAN_Enter_Freeze_Mode(instance);
-        /* Enable interrupt for both transmission and reception */
-        sp_base->IMASK1 |= (1 << IndexOfMb);
-        FlexCAN_Exit_Freeze_Mode(instance);
+        ctx = &s_context[instance];
+        if ((ring != NULL) && (ctx->firstFreeMB != 0U) && (numberOfFrame >= 2U) &&
+            (numberOfFrame <= FIFO_DMA_MAX_FRAME) && ((numberOfFrame % 2U) == 0U))
+        {
+            channel = s_dmaChannel[instance];
+            ctx->callbackDma = callback;
+            ctx->dmaRingFrame = numberOfFrame;
+            ctx->dmaNextFrame = 0U;
+            PCC->PCCn[PCC_DMAMUX_INDEX] |= PCC_PCCn_CGC_MASK;
+            DMAMUX->CHCFG[channel] = 0U;
+            /* Minor loop offsets are needed to rewind the source to MB0 */
+            DMA->CR |= DMA_CR_EMLM_MASK;
+            DMA->TCD[channel].SADDR = (uintptr_t)&sp_base->RAMn[OFFSET_START_OF_MB];
+            DMA->TCD[channel].SOFF = (int16_t)NUM_BYTES_EACH_WORD;
+            DMA->TCD[channel].ATTR = DMA_TCD_ATTR_SSIZE(DMA_TRANSFER_SIZE_32BIT) | DMA_TCD_ATTR_DSIZE(DMA_TRANSFER_SIZE_32BIT);
+            DMA->TCD[channel].NBYTES.MLOFFYES = DMA_TCD_NBYTES_MLOFFYES_SMLOE_MASK |
+                                               DMA_TCD_NBYTES_MLOFFYES_MLOFF(-(int32_t)FIFO_DMA_FRAME_BYTES) |
+                                               DMA_TCD_NBYTES_MLOFFYES_NBYTES(FIFO_DMA_FRAME_BYTES);
+            DMA->TCD[channel].SLAST = 0;
+            DMA->TCD[channel].DADDR = (uintptr_t)ring;
+            DMA->TCD[channel].DOFF = (int16_t)NUM_BYTES_EACH_WORD;
+            DMA->TCD[channel].CITER.ELINKNO = DMA_TCD_CITER_ELINKNO_CITER(numberOfFrame);
+            DMA->TCD[channel].BITER.ELINKNO = DMA_TCD_BITER_ELINKNO_BITER(numberOfFrame);
+            /* Back to the start of the ring after the major loop */
+            DMA->TCD[channel].DLASTSGA = -((int32_t)numberOfFrame * (int32_t)FIFO_DMA_FRAME_BYTES);
+            DMA->TCD[channel].CSR = DMA_TCD_CSR_INTHALF_MASK | DMA_TCD_CSR_INTMAJOR_MASK;
+            DMAMUX->CHCFG[channel] = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(s_dmaSource[instance]);
+            DMA->ERQ |= (1UL << channel);
+            S32_NVIC->ISER[(DMA0_IRQn + channel) / 32] = (1UL << ((DMA0_IRQn + channel) % 32));
+            FlexCAN_Enter_Freeze_Mode(instance);
+            /* "Frames available" now requests the DMA instead of the CPU */
+            sp_base->IMASK1 &= ~FLEXCAN_RX_FIFO_FLAG_MASK;
+            sp_base->MCR |= CAN_MCR_DMA_MASK;
+            FlexCAN_Exit_Freeze_Mode(instance);
+        }
+        else
+        {
+            retVal = FLEXCAN_RETURN_CODE_FAIL;
+        }
     }
 
     return retVal;
 }
 
-FlexCAN_ReturnCode_t FlexCAN_InitIRQ(uint32_t instance, IRQn_Type irqIndex, FlexCAN_CallbackIRQ CAN_MiddlewareCallback)
+/* Turn a frame copied by the DMA into the driver's frame layout. Only the 16-bit
+ * cfControl.timeStamp is set, FlexCAN_ExtendTimeStamp places it on the timeline */
+void FlexCAN_DecodeRxFifoFrame(const FlexCAN_RxFifo_dma_frame_t *frame, FlexCAN_TX_MessageBuffer_t *mbData)
+{
+    FlexCAN_MB_image_t image;
+    uint32_t word;
+    uint8_t indexOfWord = 0;
+
+    image.cs = frame->cs;
+    image.id = frame->id & MB_ID_MASK;
+    FlexCAN_UnpackMbImage(&image, mbData);
+    for (indexOfWord = 0U; indexOfWord < (CLASSIC_MAX_DATA_LENGTH / NUM_BYTES_EACH_WORD); indexOfWord++)
+    {
+        word = FLEXCAN_SWAP_BYTES(frame->data[indexOfWord]);
+        memcpy(&mbData->dataByte[indexOfWord * NUM_BYTES_EACH_WORD], &word, NUM_BYTES_EACH_WORD);
+    }
+}
+
+uint8_t FlexCAN_GetFirstFreeMB(uint32_t instance)
+{
+    uint8_t firstFreeMB = 0;
+
+    if (instance < CAN_INSTANCE_NUMBER)
+    {
+        firstFreeMB = s_context[instance].firstFreeMB;
+    }
+
+    return firstFreeMB;
+}
+
+uint8_t FlexCAN_DlcToLength(uint8_t dlc)
+{
+    return s_dlcToLength[dlc & FD_MAX_DLC];
+}
+
+/* Smallest DLC code whose payload holds length bytes */
+uint8_t FlexCAN_LengthToDlc(uint8_t length)
+{
+    uint8_t dlc = 0;
+
+    while ((dlc < FD_MAX_DLC) && (s_dlcToLength[dlc] < length))
+    {
+        dlc++;
+    }
+
+    return dlc;
+}
+
+uint8_t FlexCAN_GetNumberOfMB(uint32_t instance)
+{
+    uint8_t numberOfMB = 0;
+
+    if (instance < CAN_INSTANCE_NUMBER)
+    {
+        numberOfMB = s_context[instance].rangeOfMB;
+    }
+
+    return numberOfMB;
+}
+
+FlexCAN_ReturnCode_t FlexCAN_Config_RX_MessageBuffer(uint32_t instance, uint8_t IndexOfMb, FlexCAN_RX_MessageBuffer_t *config)
 {
+    uint8_t index = 0;
     FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
     CAN_Type *sp_base;
+    uint32_t indexOfRAM = 0;
 
     retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
     if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
     {
-        if ((irqIndex >= CAN0_ORed_IRQn) && (irqIndex <= CAN2_ORed_0_15_MB_IRQn))
+        if ((config->cfID.id <= MB_ID_MASK) && (IndexOfMb < s_context[instance].rangeOfMB))
         {
-            S32_NVIC->ISER[irqIndex / 32] |= (1 << (irqIndex % 32));
-           switch (instance)
-           {
-            case FLEXCAN_INSTANCE_0:
-                s_callbackIrq_0 = CAN_MiddlewareCallback;
-                break;
-            case FLEXCAN_INSTANCE_1:
-                s_callbackIrq_1 = CAN_MiddlewareCallback;
-                break;
-            case FLEXCAN_INSTANCE_2:
-                s_callbackIrq_2 = CAN_MiddlewareCallback;
-                break;
-            default:
-                /* Do nothing */
-                break;
-           }
+            indexOfRAM = IndexOfMb * s_context[instance].mbWordLength;
+            if ((((sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB]) >> MB_CODE_SHIFT) & 0x0F) != CODE_INACTIVE_RX)
+            {
+                sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] &= ~(MB_CODE_MASK);
+                sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] |= (CODE_INACTIVE_RX << MB_CODE_SHIFT);
+            }
+            FlexCAN_Enter_Freeze_Mode(instance);
+            /* Own mask of this mailbox when individual masking is on, otherwise
+             * the global mask shared by every mailbox */
+            sp_base->RXIMR[IndexOfMb] = config->RxIdMask;
+            if ((sp_base->MCR & CAN_MCR_IRMQ_MASK) == 0U)
+            {
+                sp_base->RXMGMASK = config->RxIdMask;
+            }
+            FlexCAN_Exit_Freeze_Mode(instance);
+            /* Set config for MB, write 0b0100 to Control and Status word to activate MB */
+            sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] &= ~(MB_CODE_MASK);
+            sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] = (CODE_RECEIVE_EMPTY << MB_CODE_SHIFT) | (config->cfControl.ide << MB_IDE_SHIFT);
+            /* Write the ID word */
+            sp_base->RAMn[indexOfRAM + OFFSET_ID_OF_MB] = 0;
+            sp_base->RAMn[indexOfRAM + OFFSET_ID_OF_MB] = config->cfID.id;
+            s_context[instance].txMbMask &= ~(1UL << IndexOfMb);
             retVal = FLEXCAN_RETURN_CODE_SUCCESS;
         }
         else
@@ -450,58 +881,1014 @@ FlexCAN_ReturnCode_t FlexCAN_InitIRQ(uint32_t instance, IRQn_Type irqIndex, Flex
     return retVal;
 }
 
-void CAN0_ORed_0_15_MB_IRQHandler()
+/* Shrink the block list: drop blocks covered by another one and join pairs
+ * that differ in a single care bit, which keeps the accepted set unchanged.
+ * While more than limit blocks remain, join the pair whose union adds the
+ * fewest identifiers; blocks of different ID types are never joined */
+static uint8_t FlexCAN_Filter_Merge(FlexCAN_Filter_block_t *block, uint8_t count, uint8_t limit)
 {
-    uint8_t flagIndex = 0;
-    CAN_Type *sp_base;
-    uint8_t g_flagInterruptMB = 0;
+    uint8_t i = 0;
+    uint8_t j = 0;
+    uint8_t bestI = 0;
+    uint8_t bestJ = 0;
+    uint32_t diff = 0;
+    uint32_t care = 0;
+    uint32_t cost = 0;
+    uint32_t bestCost = 0;
+    bool merged = true;
 
-    sp_base = insCanBase[FLEXCAN_0_INDEX];
-    for (flagIndex = 0; flagIndex < s_rangeOfMB; flagIndex++)
+    while (merged)
     {
-        if (((sp_base->IFLAG1) >> flagIndex) & 1U)
+        merged = false;
+        for (i = 0U; (i < count) && (!merged); i++)
+        {
+            for (j = 0U; (j < count) && (!merged); j++)
+            {
+                diff = (block[i].id ^ block[j].id) & block[i].care;
+                if ((i == j) || (block[i].ide != block[j].ide))
+                {
+                    /* Not comparable */
+                }
+                else if (((block[i].care & block[j].care) == block[j].care) && ((diff & block[j].care) == 0U))
+                {
+                    /* Block i lies inside block j */
+                    block[i] = block[count - 1U];
+                    count--;
+                    merged = true;
+                }
+                else if ((block[i].care == block[j].care) && (__builtin_popcount(diff) == 1))
+                {
+                    block[j].care &= ~diff;
+                    block[j].id &= block[j].care;
+                    block[i] = block[count - 1U];
+                    count--;
+                    merged = true;
+                }
+            }
+        }
+        if ((!merged) && (count > limit))
         {
-            g_flagInterruptMB = flagIndex;
-            break;
+            bestCost = 0xFFFFFFFFU;
+            for (i = 0U; i < count; i++)
+            {
+                for (j = (uint8_t)(i + 1U); j < count; j++)
+                {
+                    if (block[i].ide == block[j].ide)
+                    {
+                        care = block[i].care & block[j].care & ~(block[i].id ^ block[j].id);
+                        cost = (uint32_t)__builtin_popcount(((block[i].ide != 0U) ? FILTER_EXT_ID_MASK : FILTER_STD_ID_MASK) & ~care);
+                        if (cost < bestCost)
+                        {
+                            bestCost = cost;
+                            bestI = i;
+                            bestJ = j;
+                        }
+                    }
+                }
+            }
+            if (bestCost != 0xFFFFFFFFU)
+            {
+                block[bestI].care &= block[bestJ].care & ~(block[bestI].id ^ block[bestJ].id);
+                block[bestI].id &= block[bestI].care;
+                block[bestJ] = block[count - 1U];
+                count--;
+                merged = true;
+            }
         }
     }
-    s_callbackIrq_0(g_flagInterruptMB);
+
+    return count;
 }
 
-void CAN1_ORed_0_15_MB_IRQHandler()
+/* Split a range into the fewest aligned power-of-two blocks, largest first.
+ * Returns FILTER_MAX_BLOCK + 1 when the range is empty or does not fit */
+static uint8_t FlexCAN_Filter_Add_Range(FlexCAN_Filter_block_t *block, uint8_t count, const FlexCAN_RxFilter_range_t *range)
 {
-    uint8_t flagIndex = 0;
-    CAN_Type *sp_base;
-    uint8_t g_flagInterruptMB = 0;
+    uint32_t widthMask = (range->ide != 0U) ? FILTER_EXT_ID_MASK : FILTER_STD_ID_MASK;
+    uint32_t low = (range->ide != 0U) ? (range->idLow & MB_ID_MASK) : ((range->idLow & MB_ID_MASK) >> MB_STD_ID_SHIFT);
+    uint32_t high = (range->ide != 0U) ? (range->idHigh & MB_ID_MASK) : ((range->idHigh & MB_ID_MASK) >> MB_STD_ID_SHIFT);
+    uint32_t size = 0;
+    bool done = (low > high);
 
-    sp_base = insCanBase[FLEXCAN_1_INDEX];
-    for (flagIndex = 0; flagIndex < s_rangeOfMB; flagIndex++)
+    if (done)
+    {
+        count = FILTER_MAX_BLOCK + 1U;
+    }
+    while (!done)
     {
-        if (((sp_base->IFLAG1) >> flagIndex) & 1U)
+        size = (low == 0U) ? (widthMask + 1U) : (low & (~low + 1U));
+        while ((size - 1U) > (high - low))
+        {
+            size >>= 1U;
+        }
+        if (count == FILTER_MAX_BLOCK)
+        {
+            count = FlexCAN_Filter_Merge(block, count, FILTER_MAX_BLOCK - 1U);
+        }
+        if (count < FILTER_MAX_BLOCK)
+        {
+            block[count].id = low;
+            block[count].care = widthMask & ~(size - 1U);
+            block[count].ide = range->ide;
+            count++;
+            done = ((high - low) == (size - 1U));
+            low += size;
+        }
+        else
         {
-            g_flagInterruptMB = flagIndex;
-            break;
+            count = FILTER_MAX_BLOCK + 1U;
+            done = true;
         }
     }
-    s_callbackIrq_1(g_flagInterruptMB);
+
+    return count;
 }
 
-void CAN2_ORed_0_15_MB_IRQHandler()
+/*
+ * Compile a list of accepted identifier ranges into mailbox filters with
+ * individual masking (IRMQ): every range is split into aligned blocks, blocks
+ * are joined where that loses nothing, and each remaining block becomes one
+ * receive mailbox with its own RXIMR mask. Mailboxes are taken from mbMask,
+ * lowest first, skipping the Rx FIFO area; only when there are too few of them
+ * are blocks widened so the hardware accepts a superset. Frames outside the
+ * filters never reach a mailbox. usedMbMask returns the receive mailboxes,
+ * whose interrupts the caller enables
+ */
+FlexCAN_ReturnCode_t FlexCAN_ConfigRxFilter(uint32_t instance, const FlexCAN_RxFilter_range_t *ranges, uint8_t numberOfRange,
+                                            uint32_t mbMask, uint32_t *usedMbMask)
 {
-    uint8_t flagIndex = 0;
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
     CAN_Type *sp_base;
-    uint8_t g_flagInterruptMB = 0;
+    FlexCAN_Context_t *ctx;
+    FlexCAN_Filter_block_t block[FILTER_MAX_BLOCK];
+    uint8_t count = 0;
+    uint8_t index = 0;
+    uint8_t indexOfMB = 0;
+    uint32_t indexOfRAM = 0;
+    uint32_t usedMask = 0;
 
-    sp_base = insCanBase[FLEXCAN_2_INDEX];
-    for (flagIndex = 0; flagIndex < s_rangeOfMB; flagIndex++)
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
     {
-        if (((sp_base->IFLAG1) >> flagIndex) & 1U)
+        ctx = &s_context[instance];
+        if (ctx->rangeOfMB < 32U)
         {
-            g_flagInterruptMB = flagIndex;
-            break;
+            mbMask &= (1UL << ctx->rangeOfMB) - 1U;
+        }
+        mbMask &= ~((1UL << ctx->firstFreeMB) - 1U);
+        for (index = 0U; (ranges != NULL) && (index < numberOfRange) && (count <= FILTER_MAX_BLOCK); index++)
+        {
+            count = FlexCAN_Filter_Add_Range(block, count, &ranges[index]);
+        }
+        if ((count != 0U) && (count <= FILTER_MAX_BLOCK))
+        {
+            count = FlexCAN_Filter_Merge(block, count, (uint8_t)__builtin_popcount(mbMask));
+        }
+        if ((usedMbMask != NULL) && (count != 0U) && (count <= (uint8_t)__builtin_popcount(mbMask)))
+        {
+            FlexCAN_Enter_Freeze_Mode(instance);
+            sp_base->MCR |= CAN_MCR_IRMQ_MASK;
+            for (index = 0U; index < count; index++)
+            {
+                indexOfMB = (uint8_t)__builtin_ctz(mbMask);
+                mbMask &= mbMask - 1U;
+                indexOfRAM = indexOfMB * ctx->mbWordLength;
+                sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] = (CODE_INACTIVE_RX << MB_CODE_SHIFT);
+                if (block[index].ide != 0U)
+                {
+                    sp_base->RXIMR[indexOfMB] = block[index].care;
+                    sp_base->RAMn[indexOfRAM + OFFSET_ID_OF_MB] = block[index].id;
+                }
+                else
+                {
+                    sp_base->RXIMR[indexOfMB] = block[index].care << MB_STD_ID_SHIFT;
+                    sp_base->RAMn[indexOfRAM + OFFSET_ID_OF_MB] = block[index].id << MB_STD_ID_SHIFT;
+                }
+                sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] = (CODE_RECEIVE_EMPTY << MB_CODE_SHIFT) |
+                                                                 ((uint32_t)block[index].ide << MB_IDE_SHIFT);
+                usedMask |= (1UL << indexOfMB);
+            }
+            ctx->txMbMask &= ~usedMask;
+            FlexCAN_Exit_Freeze_Mode(instance);
+            *usedMbMask = usedMask;
+        }
+        else
+        {
+            retVal = FLEXCAN_RETURN_CODE_FAIL;
         }
     }
-    s_callbackIrq_2(g_flagInterruptMB);
+
+    return retVal;
+}
+
+FlexCAN_ReturnCode_t FlexCAN_ClearInterruptFlag(uint32_t instance, uint32_t flagIndex)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+    {
+        if (flagIndex < s_context[instance].rangeOfMB)
+        {
+            /* IFLAG1 is write-1-to-clear: a read-modify-write would clear every pending flag */
+            sp_base->IFLAG1 = (1UL << flagIndex);
+            retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+        }
+        else
+        {
+            retVal = FLEXCAN_RETURN_CODE_FAIL;
+        }
+    }
+
+    return retVal;
+}
+
+/*
+ * Load a frame, replacing the one still pending in the mailbox. The old frame
+ * is aborted and the call waits a bounded number of IFLAG reads for the abort
+ * to settle; a frame already on the bus cannot be aborted, then the call
+ * returns FLEXCAN_RETURN_CODE_BUSY and leaves it to complete. The abort stays
+ * pending then: the mailbox interrupt tells whether the old frame went out
+ */
+FlexCAN_ReturnCode_t FlexCAN_Send(uint32_t instance, uint8_t IndexOfMb, FlexCAN_TX_MessageBuffer_t *mbData)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+    uint32_t indexOfRAM = 0;
+    uint32_t controlWord = 0;
+    uint32_t poll = 0;
+    uint32_t code = 0;
+    uint32_t state;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+    {
+        if ((mbData != NULL) && (IndexOfMb < s_context[instance].rangeOfMB))
+        {
+            indexOfRAM = IndexOfMb * s_context[instance].mbWordLength;
+            controlWord = sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB];
+            /* Check whether MB is active */
+            if (((controlWord >> MB_CODE_SHIFT) & 0x0F) == CODE_SEND)
+            {
+                /* Clear interrupt flag, then write ABORT in one store: an intermediate
+                 * code would inactivate the mailbox instead */
+                retVal = FlexCAN_ClearInterruptFlag(instance, IndexOfMb);
+                sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] = (controlWord & ~MB_CODE_MASK) | (CODE_ABORT_TRANSMISSION << MB_CODE_SHIFT);
+                /* Wait for the corresponding IFLAG bit to be asserted */
+                while ((poll < ABORT_POLL_LIMIT) && (((sp_base->IFLAG1 >> IndexOfMb) & 1U) == 0U))
+                {
+                    poll++;
+                }
+                retVal = (poll < ABORT_POLL_LIMIT) ? FLEXCAN_RETURN_CODE_SUCCESS : FLEXCAN_RETURN_CODE_BUSY;
+                if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+                {
+                    /* Clear the corresponding IFLAG and report the outcome of the old frame */
+                    FLEXCAN_ENTER_CRITICAL(state);
+                    sp_base->IFLAG1 = (1UL << IndexOfMb);
+                    code = (sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] >> MB_CODE_SHIFT) & 0x0F;
+                    FlexCAN_Tx_Account(&s_context[instance], IndexOfMb, code);
+                    FlexCAN_Tx_Settle(instance, IndexOfMb, code);
+                    FLEXCAN_EXIT_CRITICAL(state);
+                }
+            }
+            if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+            {
+                /* Config TX message buffer to send */
+                retVal = FlexCAN_Config_Tx_MessageBuffer(instance, IndexOfMb, mbData);
+            }
+        }
+        else
+        {
+            retVal = FLEXCAN_RETURN_CODE_FAIL;
+        }
+    }
+
+    return retVal;
+}
+
+/* Count a settled transmit mailbox: CODE reads ABORT when the abort won,
+ * anything else means the frame went out */
+static void FlexCAN_Tx_Account(FlexCAN_Context_t *ctx, uint8_t indexOfMB, uint32_t code)
+{
+    if (code == CODE_ABORT_TRANSMISSION)
+    {
+        ctx->stats.txAborts++;
+    }
+    else
+    {
+        ctx->stats.mbTxCount[indexOfMB]++;
+        ctx->stats.txFrames++;
+    }
+}
+
+/* End the tracking of an asynchronous frame: CODE reads ABORT when the abort
+ * won, anything else means the frame went out */
+static void FlexCAN_Tx_Settle(uint32_t instance, uint8_t indexOfMB, uint32_t code)
+{
+    FlexCAN_Context_t *ctx = &s_context[instance];
+    FlexCAN_TxStatus_t status;
+
+    if ((ctx->asyncMbMask & (1UL << indexOfMB)) != 0U)
+    {
+        ctx->asyncMbMask &= ~(1UL << indexOfMB);
+        status = (code == CODE_ABORT_TRANSMISSION) ? FLEXCAN_TX_STATUS_ABORTED : FLEXCAN_TX_STATUS_DONE;
+        ctx->txStatus[indexOfMB] = (uint8_t)status;
+        if (ctx->callbackTx != NULL)
+        {
+            ctx->callbackTx(instance, ctx->txHandle[indexOfMB], status);
+        }
+    }
+}
+
+/*
+ * Load a frame without waiting: a mailbox still holding a pending frame gives
+ * FLEXCAN_RETURN_CODE_BUSY and is left untouched. On success *handle (may be
+ * NULL) identifies the frame for FlexCAN_GetTxStatus and FlexCAN_AbortAsync and
+ * the end of the transmission is reported to the FlexCAN_ConfigTxCallback
+ * callback from the mailbox interrupt. A completion of the previous frame not
+ * yet taken by the interrupt is acknowledged and reported here
+ */
+FlexCAN_ReturnCode_t FlexCAN_SendAsync(uint32_t instance, uint8_t indexOfMB, FlexCAN_TX_MessageBuffer_t *mbData, FlexCAN_TxHandle_t *handle)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+    FlexCAN_Context_t *ctx;
+    uint32_t code = 0;
+    uint32_t state;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if ((retVal == FLEXCAN_RETURN_CODE_SUCCESS) && (mbData != NULL) && (indexOfMB < s_context[instance].rangeOfMB))
+    {
+        ctx = &s_context[instance];
+        FLEXCAN_ENTER_CRITICAL(state);
+        code = (sp_base->RAMn[indexOfMB * ctx->mbWordLength + OFFSET_START_OF_MB] >> MB_CODE_SHIFT) & 0x0F;
+        if (code == CODE_SEND)
+        {
+            retVal = FLEXCAN_RETURN_CODE_BUSY;
+        }
+        else
+        {
+            if (((sp_base->IFLAG1 >> indexOfMB) & 1U) != 0U)
+            {
+                sp_base->IFLAG1 = (1UL << indexOfMB);
+                FlexCAN_Tx_Settle(instance, indexOfMB, code);
+            }
+            retVal = FlexCAN_Config_Tx_MessageBuffer(instance, indexOfMB, mbData);
+        }
+        if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+        {
+            ctx->txSequence = (ctx->txSequence + 1U) & TX_HANDLE_SEQUENCE_MASK;
+            if (ctx->txSequence == 0U)
+            {
+                ctx->txSequence = 1U;
+            }
+            ctx->txHandle[indexOfMB] = (ctx->txSequence << TX_HANDLE_SEQUENCE_SHIFT) | indexOfMB;
+            ctx->txStatus[indexOfMB] = (uint8_t)FLEXCAN_TX_STATUS_PENDING;
+            ctx->asyncMbMask |= (1UL << indexOfMB);
+            if (handle != NULL)
+            {
+                *handle = ctx->txHandle[indexOfMB];
+            }
+        }
+        FLEXCAN_EXIT_CRITICAL(state);
+    }
+    else
+    {
+        retVal = FLEXCAN_RETURN_CODE_FAIL;
+    }
+
+    return retVal;
+}
+
+/*
+ * State of a frame loaded by FlexCAN_SendAsync. Without the mailbox interrupt
+ * enabled the state is read from the mailbox itself, so polling works as well.
+ * FLEXCAN_TX_STATUS_EXPIRED once the mailbox has been loaded again
+ */
+FlexCAN_TxStatus_t FlexCAN_GetTxStatus(uint32_t instance, FlexCAN_TxHandle_t handle)
+{
+    FlexCAN_TxStatus_t status = FLEXCAN_TX_STATUS_EXPIRED;
+    CAN_Type *sp_base;
+    FlexCAN_Context_t *ctx;
+    uint8_t indexOfMB = (uint8_t)(handle & TX_HANDLE_MB_MASK);
+    uint32_t code = 0;
+
+    if ((FlexCAN_Get_Base_Address(instance, &sp_base) == FLEXCAN_RETURN_CODE_SUCCESS) &&
+        (indexOfMB < s_context[instance].rangeOfMB) && (handle != FLEXCAN_TX_HANDLE_INVALID) &&
+        (s_context[instance].txHandle[indexOfMB] == handle))
+    {
+        ctx = &s_context[instance];
+        status = (FlexCAN_TxStatus_t)ctx->txStatus[indexOfMB];
+        if (status == FLEXCAN_TX_STATUS_PENDING)
+        {
+            code = (sp_base->RAMn[indexOfMB * ctx->mbWordLength + OFFSET_START_OF_MB] >> MB_CODE_SHIFT) & 0x0F;
+            if (code == CODE_ABORT_TRANSMISSION)
+            {
+                status = FLEXCAN_TX_STATUS_ABORTED;
+            }
+            else if (code != CODE_SEND)
+            {
+                status = FLEXCAN_TX_STATUS_DONE;
+            }
+            else if (((sp_base->ESR1 & CAN_ESR1_FLTCONF_MASK) >> CAN_ESR1_FLTCONF_SHIFT) >= FLTCONF_BUS_OFF)
+            {
+                status = FLEXCAN_TX_STATUS_ERROR;
+            }
+        }
+    }
+
+    return status;
+}
+
+/*
+ * Ask the controller to withdraw a pending frame and return at once. The
+ * outcome arrives like any other completion: FLEXCAN_TX_STATUS_ABORTED, or
+ * FLEXCAN_TX_STATUS_DONE when the frame had already won arbitration
+ */
+FlexCAN_ReturnCode_t FlexCAN_AbortAsync(uint32_t instance, FlexCAN_TxHandle_t handle)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+    FlexCAN_Context_t *ctx;
+    uint8_t indexOfMB = (uint8_t)(handle & TX_HANDLE_MB_MASK);
+    uint32_t indexOfRAM = 0;
+    uint32_t controlWord = 0;
+    uint32_t state;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if ((retVal == FLEXCAN_RETURN_CODE_SUCCESS) && (indexOfMB < s_context[instance].rangeOfMB) &&
+        (handle != FLEXCAN_TX_HANDLE_INVALID))
+    {
+        ctx = &s_context[instance];
+        indexOfRAM = indexOfMB * ctx->mbWordLength;
+        retVal = FLEXCAN_RETURN_CODE_FAIL;
+        FLEXCAN_ENTER_CRITICAL(state);
+        controlWord = sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB];
+        if ((ctx->txHandle[indexOfMB] == handle) && ((ctx->asyncMbMask & (1UL << indexOfMB)) != 0U) &&
+            (((controlWord >> MB_CODE_SHIFT) & 0x0F) == CODE_SEND))
+        {
+            sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] = (controlWord & ~MB_CODE_MASK) | (CODE_ABORT_TRANSMISSION << MB_CODE_SHIFT);
+            retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+        }
+        FLEXCAN_EXIT_CRITICAL(state);
+    }
+    else
+    {
+        retVal = FLEXCAN_RETURN_CODE_FAIL;
+    }
+
+    return retVal;
+}
+
+FlexCAN_ReturnCode_t FlexCAN_ConfigTxCallback(uint32_t instance, FlexCAN_CallbackTx callback)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+    {
+        s_context[instance].callbackTx = callback;
+    }
+
+    return retVal;
+}
+
+FlexCAN_ReturnCode_t FlexCAN_Receive(uint32_t instance, uint8_t IndexOfMb, FlexCAN_TX_MessageBuffer_t *mbData)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+    uint32_t indexOfRAM = 0;
+    uint32_t controlWord = 0;
+    FlexCAN_MB_image_t image;
+    uint8_t dataLength = 0;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+    {
+        if (IndexOfMb < s_context[instance].rangeOfMB)
+        {
+            indexOfRAM = IndexOfMb * s_context[instance].mbWordLength;
+            /* Waiting CAN update mailbox data by move-in process, wait for busy bit be negated */
+            while ((sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] >> MB_CODE_SHIFT) & CODE_BUSY)
+            {
+                /* Do nothing */
+            }
+            /* Get data and configuration from MB */
+            image.id = sp_base->RAMn[indexOfRAM + OFFSET_ID_OF_MB] & MB_ID_MASK;
+            controlWord = sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB];
+            image.cs = controlWord;
+            FlexCAN_UnpackMbImage(&image, mbData);
+            dataLength = FlexCAN_DlcToLength((uint8_t)mbData->cfControl.dlc);
+            if ((mbData->cfControl.edl == 0U) && (dataLength > CLASSIC_MAX_DATA_LENGTH))
+            {
+                dataLength = CLASSIC_MAX_DATA_LENGTH;
+            }
+            /* A longer FD frame is stored cut to the mailbox size */
+            if (dataLength > ((s_context[instance].mbWordLength - OFFSET_DATA_START_OF_MB) * NUM_BYTES_EACH_WORD))
+            {
+                dataLength = (uint8_t)((s_context[instance].mbWordLength - OFFSET_DATA_START_OF_MB) * NUM_BYTES_EACH_WORD);
+            }
+            FlexCAN_Read_Payload(sp_base, indexOfRAM + OFFSET_DATA_START_OF_MB, mbData->dataByte, dataLength);
+            /* Read free running timer to unlock mailbox, it also dates the frame */
+            mbData->time = FlexCAN_ExtendTimeStamp(FlexCAN_Read_Timer(instance, sp_base), (uint16_t)mbData->cfControl.timeStamp);
+            s_context[instance].stats.rxFrames++;
+            s_context[instance].stats.mbRxCount[IndexOfMb]++;
+            if (((controlWord & MB_CODE_MASK) >> MB_CODE_SHIFT) == CODE_RECEIVE_OVERRUN)
+            {
+                s_context[instance].stats.rxOverruns++;
+            }
+            /* Hand the mailbox back as EMPTY, so a frame only lands in a FULL
+             * mailbox (CODE 0x6) when the previous one was really not read */
+            sp_base->RAMn[indexOfRAM + OFFSET_START_OF_MB] = (CODE_RECEIVE_EMPTY << MB_CODE_SHIFT) | (controlWord & MB_IDE_MASK);
+            retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+        }
+        else
+        {
+            retVal = FLEXCAN_RETURN_CODE_FAIL;
+        }
+    }
+
+    return retVal;
+}
+
+/* Free running timer extended to 64 bits, in nominal bit times */
+uint64_t FlexCAN_GetTime(uint32_t instance)
+{
+    uint64_t now = 0;
+    CAN_Type *sp_base;
+
+    if (FlexCAN_Get_Base_Address(instance, &sp_base) == FLEXCAN_RETURN_CODE_SUCCESS)
+    {
+        now = FlexCAN_Read_Timer(instance, sp_base);
+    }
+
+    return now;
+}
+
+/* Place a 16-bit mailbox timestamp captured less than 65536 bit times before
+ * now on the 64-bit timeline */
+uint64_t FlexCAN_ExtendTimeStamp(uint64_t now, uint16_t timeStamp)
+{
+    return now - (uint16_t)((uint16_t)now - timeStamp);
+}
+
+/* Time a transmit mailbox sent its frame, valid from its interrupt flag until
+ * the mailbox is loaded again */
+FlexCAN_ReturnCode_t FlexCAN_GetTxTimeStamp(uint32_t instance, uint8_t indexOfMB, uint64_t *timeStamp)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+    uint32_t controlWord = 0;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if ((retVal == FLEXCAN_RETURN_CODE_SUCCESS) && (timeStamp != NULL) && (indexOfMB < s_context[instance].rangeOfMB))
+    {
+        controlWord = sp_base->RAMn[indexOfMB * s_context[instance].mbWordLength + OFFSET_START_OF_MB];
+        *timeStamp = FlexCAN_ExtendTimeStamp(FlexCAN_Read_Timer(instance, sp_base), (uint16_t)(controlWord & MB_TIME_STAMP_MASK));
+    }
+    else
+    {
+        retVal = FLEXCAN_RETURN_CODE_FAIL;
+    }
+
+    return retVal;
+}
+
+/*
+ * Snapshot of the counters of one instance plus the error state read from ECR
+ * and ESR1. The mailbox interrupt is masked only for the copy, so sampling at a
+ * high rate costs a few hundred cycles per read. A bus off entry latches BOFFINT
+ * until it is counted here, several entries between two reads count once
+ */
+FlexCAN_ReturnCode_t FlexCAN_GetStats(uint32_t instance, FlexCAN_Stats_t *stats)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+    uint32_t errorCounter = 0;
+    uint32_t errorStatus = 0;
+    uint32_t state;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if ((retVal == FLEXCAN_RETURN_CODE_SUCCESS) && (stats != NULL))
+    {
+        errorCounter = sp_base->ECR;
+        errorStatus = sp_base->ESR1;
+        /* The CAN and the Rx FIFO DMA interrupts both count; the caller may
+         * already run with interrupts masked, so their state is restored */
+        FLEXCAN_ENTER_CRITICAL(state);
+        if ((errorStatus & CAN_ESR1_BOFFINT_MASK) != 0U)
+        {
+            sp_base->ESR1 = CAN_ESR1_BOFFINT_MASK;
+            s_context[instance].stats.busOffCount++;
+        }
+        s_context[instance].stats.txErrorCounter = (uint8_t)((errorCounter & CAN_ECR_TXERRCNT_MASK) >> CAN_ECR_TXERRCNT_SHIFT);
+        s_context[instance].stats.rxErrorCounter = (uint8_t)((errorCounter & CAN_ECR_RXERRCNT_MASK) >> CAN_ECR_RXERRCNT_SHIFT);
+        s_context[instance].stats.faultConfinement = (uint8_t)((errorStatus & CAN_ESR1_FLTCONF_MASK) >> CAN_ESR1_FLTCONF_SHIFT);
+        *stats = s_context[instance].stats;
+        FLEXCAN_EXIT_CRITICAL(state);
+    }
+    else
+    {
+        retVal = FLEXCAN_RETURN_CODE_FAIL;
+    }
+
+    return retVal;
+}
+
+FlexCAN_ReturnCode_t FlexCAN_ResetStats(uint32_t instance)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    uint32_t state;
+
+    if (instance < CAN_INSTANCE_NUMBER)
+    {
+        FLEXCAN_ENTER_CRITICAL(state);
+        memset(&s_context[instance].stats, 0, sizeof(FlexCAN_Stats_t));
+        FLEXCAN_EXIT_CRITICAL(state);
+        retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+    }
+
+    return retVal;
+}
+
+FlexCAN_ReturnCode_t FlexCAN_ConfigInterrupt(uint32_t instance, uint8_t IndexOfMb)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+    {
+        FlexCAN_Enter_Freeze_Mode(instance);
+        /* Enable interrupt for both transmission and reception */
+        sp_base->IMASK1 |= (1 << IndexOfMb);
+        FlexCAN_Exit_Freeze_Mode(instance);
+    }
+
+    return retVal;
+}
+
+/* Enable the interrupt of every mailbox in mbMask with one IMASK1 write */
+FlexCAN_ReturnCode_t FlexCAN_ConfigInterruptMask(uint32_t instance, uint32_t mbMask)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+    {
+        FlexCAN_Enter_Freeze_Mode(instance);
+        sp_base->IMASK1 |= mbMask;
+        FlexCAN_Exit_Freeze_Mode(instance);
+    }
+
+    return retVal;
+}
+
+/* Change the nominal bit timing of an initialized instance, the other CTRL1
+ * settings are kept */
+FlexCAN_ReturnCode_t FlexCAN_ConfigBitTiming(uint32_t instance, FlexCAN_bit_timing_t *bitTiming)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if ((retVal == FLEXCAN_RETURN_CODE_SUCCESS) && (bitTiming != NULL))
+    {
+        FlexCAN_Enter_Freeze_Mode(instance);
+        sp_base->CTRL1 = (sp_base->CTRL1 & ~CTRL1_BIT_TIMING_MASK) |
+                         CAN_CTRL1_PRESDIV(bitTiming->presdiv) |
+                         CAN_CTRL1_RJW(bitTiming->rjw) |
+                         CAN_CTRL1_PSEG1(bitTiming->pseg1) |
+                         CAN_CTRL1_PSEG2(bitTiming->pseg2) |
+                         CAN_CTRL1_SMP(bitTiming->smp) |
+                         CAN_CTRL1_PROPSEG(bitTiming->propseg);
+        FlexCAN_Exit_Freeze_Mode(instance);
+    }
+    else
+    {
+        retVal = FLEXCAN_RETURN_CODE_FAIL;
+    }
+
+    return retVal;
+}
+
+/*
+ * Configuration transaction: FlexCAN_ConfigBegin freezes the module and every
+ * configuration call until FlexCAN_ConfigCommit (bit timing, FD, Rx FIFO,
+ * masks, mailboxes, interrupt masks, arbitration) is applied inside that one
+ * freeze window, so setting up N mailboxes costs one FRZACK/NOTRDY handshake
+ * instead of N. Frames are neither sent nor received before the commit, so
+ * FlexCAN_Send and FlexCAN_Receive must not be called in between
+ */
+FlexCAN_ReturnCode_t FlexCAN_ConfigBegin(uint32_t instance)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+    {
+        FlexCAN_Enter_Freeze_Mode(instance);
+    }
+
+    return retVal;
+}
+
+FlexCAN_ReturnCode_t FlexCAN_ConfigCommit(uint32_t instance)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if ((retVal == FLEXCAN_RETURN_CODE_SUCCESS) && (s_context[instance].freezeDepth != 0U))
+    {
+        FlexCAN_Exit_Freeze_Mode(instance);
+    }
+    else
+    {
+        retVal = FLEXCAN_RETURN_CODE_FAIL;
+    }
+
+    return retVal;
+}
+
+FlexCAN_ReturnCode_t FlexCAN_InitIRQ(uint32_t instance, IRQn_Type irqIndex, FlexCAN_CallbackIRQ CAN_MiddlewareCallback)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    uint8_t index = 0;
+    CAN_Type *sp_base;
+    FlexCAN_Context_t *ctx;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+    {
+        if ((irqIndex >= CAN0_ORed_IRQn) && (irqIndex <= CAN2_ORed_0_15_MB_IRQn))
+        {
+            ctx = &s_context[instance];
+            S32_NVIC->ISER[irqIndex / 32] |= (1 << (irqIndex % 32));
+            for (index = 0U; index < ctx->irqCount; index++)
+            {
+                if (ctx->irqIndex[index] == irqIndex)
+                {
+                    break;
+                }
+            }
+            if ((index == ctx->irqCount) && (index < MAX_IRQ_PER_INSTANCE))
+            {
+                ctx->irqIndex[index] = irqIndex;
+                ctx->irqCount++;
+            }
+            ctx->callbackIrq = CAN_MiddlewareCallback;
+            retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+        }
+        else
+        {
+            retVal = FLEXCAN_RETURN_CODE_FAIL;
+        }
+    }
+
+    return retVal;
+}
+
+FlexCAN_ReturnCode_t FlexCAN_ConfigTxArbitration(uint32_t instance, FlexCAN_TxArbitration_t arbitration)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    CAN_Type *sp_base;
+
+    retVal = FlexCAN_Get_Base_Address(instance, &sp_base);
+    if (retVal == FLEXCAN_RETURN_CODE_SUCCESS)
+    {
+        FlexCAN_Enter_Freeze_Mode(instance);
+        /* LBUF = 0: lowest ID first, LBUF = 1: lowest number buffer first */
+        if (arbitration == FLEXCAN_TX_ARB_LOWEST_BUFFER)
+        {
+            sp_base->CTRL1 |= CAN_CTRL1_LBUF_MASK;
+        }
+        else
+        {
+            sp_base->CTRL1 &= ~CAN_CTRL1_LBUF_MASK;
+        }
+        FlexCAN_Exit_Freeze_Mode(instance);
+    }
+
+    return retVal;
+}
+
+/* Mask the mailbox interrupt of an instance in the NVIC, used by upper layers to
+ * protect data shared with the callback. With the Rx FIFO DMA on, the channel
+ * interrupt that runs callbackDma is masked too. A pending interrupt fires on
+ * enable */
+FlexCAN_ReturnCode_t FlexCAN_DisableIRQ(uint32_t instance)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    uint8_t index = 0;
+    uint32_t dmaIrq;
+
+    if ((instance < CAN_INSTANCE_NUMBER) && (s_context[instance].irqCount != 0U))
+    {
+        for (index = 0U; index < s_context[instance].irqCount; index++)
+        {
+            S32_NVIC->ICER[s_context[instance].irqIndex[index] / 32] = (1UL << (s_context[instance].irqIndex[index] % 32));
+        }
+        if (s_context[instance].dmaRingFrame != 0U)
+        {
+            dmaIrq = (uint32_t)DMA0_IRQn + s_dmaChannel[instance];
+            S32_NVIC->ICER[dmaIrq / 32] = (1UL << (dmaIrq % 32));
+        }
+#if !defined(FLEXCAN_HOST_MODEL)
+        __asm volatile ("dsb 0xF" ::: "memory");
+        __asm volatile ("isb 0xF" ::: "memory");
+#endif
+        retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+    }
+
+    return retVal;
+}
+
+FlexCAN_ReturnCode_t FlexCAN_EnableIRQ(uint32_t instance)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    uint8_t index = 0;
+    uint32_t dmaIrq;
+
+    if ((instance < CAN_INSTANCE_NUMBER) && (s_context[instance].irqCount != 0U))
+    {
+        for (index = 0U; index < s_context[instance].irqCount; index++)
+        {
+            S32_NVIC->ISER[s_context[instance].irqIndex[index] / 32] = (1UL << (s_context[instance].irqIndex[index] % 32));
+        }
+        if (s_context[instance].dmaRingFrame != 0U)
+        {
+            dmaIrq = (uint32_t)DMA0_IRQn + s_dmaChannel[instance];
+            S32_NVIC->ISER[dmaIrq / 32] = (1UL << (dmaIrq % 32));
+        }
+        retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+    }
+
+    return retVal;
+}
+
+static void FlexCAN_Stats_Irq(FlexCAN_Stats_t *stats, uint32_t cycles)
+{
+    stats->irqCount++;
+    stats->irqCyclesLast = cycles;
+    stats->irqCyclesTotal += cycles;
+    if (cycles > stats->irqCyclesMax)
+    {
+        stats->irqCyclesMax = cycles;
+    }
+}
+
+/* Service every pending mailbox of one interrupt vector in a single entry:
+ * IFLAG1 is read once, the snapshot is acknowledged with one w1c write and the
+ * callback walks the set bits */
+static void FlexCAN_IRQ_Dispatch(uint32_t instance, uint32_t vectorMask)
+{
+    uint32_t startCycle = FLEXCAN_CYCLE_COUNT();
+    CAN_Type *sp_base = insCanBase[instance];
+    FlexCAN_Context_t *ctx = &s_context[instance];
+    FlexCAN_CallbackIRQ callback = ctx->callbackIrq;
+    uint32_t pendingMB;
+    uint32_t completedMB;
+    uint32_t code;
+    uint8_t indexOfMB;
+
+    pendingMB = sp_base->IFLAG1 & sp_base->IMASK1 & vectorMask;
+    if (pendingMB != 0U)
+    {
+        /* "Frames available" stays set until the FIFO has been read empty */
+        if (ctx->firstFreeMB != 0U)
+        {
+            sp_base->IFLAG1 = pendingMB & ~FLEXCAN_RX_FIFO_FLAG_AVAILABLE;
+            if ((pendingMB & FLEXCAN_RX_FIFO_FLAG_OVERFLOW) != 0U)
+            {
+                ctx->stats.rxOverruns++;
+            }
+        }
+        else
+        {
+            sp_base->IFLAG1 = pendingMB;
+        }
+        /* Aborted frames raise the flag too, CODE tells them apart */
+        completedMB = pendingMB & ctx->txMbMask;
+        while (completedMB != 0U)
+        {
+            indexOfMB = (uint8_t)__builtin_ctz(completedMB);
+            code = (sp_base->RAMn[indexOfMB * ctx->mbWordLength + OFFSET_START_OF_MB] >> MB_CODE_SHIFT) & 0x0F;
+            FlexCAN_Tx_Account(ctx, indexOfMB, code);
+            FlexCAN_Tx_Settle(instance, indexOfMB, code);
+            completedMB &= completedMB - 1U;
+        }
+        if (callback != NULL)
+        {
+            callback(pendingMB);
+        }
+    }
+    FlexCAN_Stats_Irq(&ctx->stats, FLEXCAN_CYCLE_COUNT() - startCycle);
+}
+
+static void FlexCAN_DMA_Deliver(uint32_t instance, uint16_t firstFrame, uint16_t numberOfFrame)
+{
+    FlexCAN_Context_t *ctx = &s_context[instance];
+
+    ctx->stats.rxFrames += numberOfFrame;
+    ctx->stats.mbRxCount[OFFSET_START_OF_MB] += numberOfFrame;
+    if (ctx->callbackDma != NULL)
+    {
+        ctx->callbackDma(instance, firstFrame, numberOfFrame);
+    }
+}
+
+/* Hand over every frame the DMA has copied since the last delivery. The
+ * position comes from CITER and DONE rather than from which watermark fired,
+ * so a half and a major interrupt merged into one entry are both delivered.
+ * DONE is read first: a wrap after it leaves CITER behind dmaNextFrame and the
+ * tail waits for the next call */
+static void FlexCAN_DMA_Collect(uint32_t instance)
+{
+    FlexCAN_Context_t *ctx = &s_context[instance];
+    uint8_t channel = s_dmaChannel[instance];
+    uint16_t position;
+
+    if ((DMA->TCD[channel].CSR & DMA_TCD_CSR_DONE_MASK) != 0U)
+    {
+        /* The major loop wrapped: whatever was left of the ring is complete */
+        DMA->TCD[channel].CSR &= ~DMA_TCD_CSR_DONE_MASK;
+        FlexCAN_DMA_Deliver(instance, ctx->dmaNextFrame, (uint16_t)(ctx->dmaRingFrame - ctx->dmaNextFrame));
+        ctx->dmaNextFrame = 0U;
+    }
+    position = (uint16_t)(ctx->dmaRingFrame - DMA->TCD[channel].CITER.ELINKNO);
+    if (position > ctx->dmaNextFrame)
+    {
+        FlexCAN_DMA_Deliver(instance, ctx->dmaNextFrame, (uint16_t)(position - ctx->dmaNextFrame));
+        ctx->dmaNextFrame = position;
+    }
+}
+
+static void FlexCAN_DMA_Dispatch(uint32_t instance)
+{
+    uint32_t startCycle = FLEXCAN_CYCLE_COUNT();
+
+    DMA->INT = (1UL << s_dmaChannel[instance]);
+    FlexCAN_DMA_Collect(instance);
+    FlexCAN_Stats_Irq(&s_context[instance].stats, FLEXCAN_CYCLE_COUNT() - startCycle);
+}
+
+/* Hand the frames waiting below the next DMA watermark to callbackDma, from
+ * the caller's context with interrupts held off. For callers that cannot wait
+ * for a half of the ring to fill, e.g. from a periodic tick */
+FlexCAN_ReturnCode_t FlexCAN_PollRxFifoDma(uint32_t instance)
+{
+    FlexCAN_ReturnCode_t retVal = FLEXCAN_RETURN_CODE_FAIL;
+    uint32_t state;
+
+    if ((instance < CAN_INSTANCE_NUMBER) && (s_context[instance].dmaRingFrame != 0U))
+    {
+        FLEXCAN_ENTER_CRITICAL(state);
+        FlexCAN_DMA_Collect(instance);
+        FLEXCAN_EXIT_CRITICAL(state);
+        retVal = FLEXCAN_RETURN_CODE_SUCCESS;
+    }
+
+    return retVal;
+}
+
+void CAN0_ORed_0_15_MB_IRQHandler()
+{
+    FlexCAN_IRQ_Dispatch(FLEXCAN_0_INDEX, MB_IRQ_MASK_0_15);
+}
+
+void CAN0_ORed_16_31_MB_IRQHandler()
+{
+    FlexCAN_IRQ_Dispatch(FLEXCAN_0_INDEX, MB_IRQ_MASK_16_31);
+}
+
+void CAN1_ORed_0_15_MB_IRQHandler()
+{
+    FlexCAN_IRQ_Dispatch(FLEXCAN_1_INDEX, MB_IRQ_MASK_0_15);
+}
+
+void CAN2_ORed_0_15_MB_IRQHandler()
+{
+    FlexCAN_IRQ_Dispatch(FLEXCAN_2_INDEX, MB_IRQ_MASK_0_15);
+}
+
+void DMA0_IRQHandler()
+{
+    FlexCAN_DMA_Dispatch(FLEXCAN_0_INDEX);
+}
+
+void DMA1_IRQHandler()
+{
+    FlexCAN_DMA_Dispatch(FLEXCAN_1_INDEX);
+}
+
+void DMA2_IRQHandler()
+{
+    FlexCAN_DMA_Dispatch(FLEXCAN_2_INDEX);
 }
 /*******************************************************************************
  * End of file
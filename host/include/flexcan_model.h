@@ -0,0 +1,553 @@
+#ifndef __FLEXCAN_MODEL_H__
+#define __FLEXCAN_MODEL_H__
+/*******************************************************************************
+ * Include
+ ******************************************************************************/
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Host-side stand-in for the S32K144 device header. Only the peripherals used by
+ * the CAN driver and middleware are described. Register blocks of the FlexCAN
+ * instances and of the NVIC live on their own protected page: every access
+ * from the driver traps into the model, which applies the hardware side effects
+ * (FRZACK handshake, w1c flags, mailbox CODE state machine) before and after
+ * the access. Supported on x86-64 Linux only. */
+#ifndef __IO
+#define __IO volatile
+#endif
+#ifndef __I
+#define __I volatile
+#endif
+
+#define FLEXCAN_MODEL_PAGE_SIZE (4096U)
+
+/* CAN - Peripheral instance base addresses */
+#define CAN_INSTANCE_COUNT (3U)
+#define CAN_RAMn_COUNT (128U)
+#define CAN_RXIMR_COUNT (32U)
+#define CAN_WMB_COUNT (4U)
+
+#define CAN0 (&g_flexcanModelCanPage[0].regs)
+#define CAN1 (&g_flexcanModelCanPage[1].regs)
+#define CAN2 (&g_flexcanModelCanPage[2].regs)
+#define CAN_BASE_PTRS { CAN0, CAN1, CAN2 }
+
+/* MCR */
+#define CAN_MCR_MAXMB_MASK (0x7FU)
+#define CAN_MCR_MAXMB_SHIFT (0U)
+#define CAN_MCR_MAXMB(x) (((uint32_t)(x) << CAN_MCR_MAXMB_SHIFT) & CAN_MCR_MAXMB_MASK)
+#define CAN_MCR_IDAM_MASK (0x300U)
+#define CAN_MCR_IDAM_SHIFT (8U)
+#define CAN_MCR_IDAM(x) (((uint32_t)(x) << CAN_MCR_IDAM_SHIFT) & CAN_MCR_IDAM_MASK)
+#define CAN_MCR_FDEN_MASK (0x800U)
+#define CAN_MCR_FDEN_SHIFT (11U)
+#define CAN_MCR_FDEN(x) (((uint32_t)(x) << CAN_MCR_FDEN_SHIFT) & CAN_MCR_FDEN_MASK)
+#define CAN_MCR_AEN_MASK (0x1000U)
+#define CAN_MCR_AEN_SHIFT (12U)
+#define CAN_MCR_AEN(x) (((uint32_t)(x) << CAN_MCR_AEN_SHIFT) & CAN_MCR_AEN_MASK)
+#define CAN_MCR_LPRIOEN_MASK (0x2000U)
+#define CAN_MCR_LPRIOEN_SHIFT (13U)
+#define CAN_MCR_LPRIOEN(x) (((uint32_t)(x) << CAN_MCR_LPRIOEN_SHIFT) & CAN_MCR_LPRIOEN_MASK)
+#define CAN_MCR_PNET_EN_MASK (0x4000U)
+#define CAN_MCR_PNET_EN_SHIFT (14U)
+#define CAN_MCR_PNET_EN(x) (((uint32_t)(x) << CAN_MCR_PNET_EN_SHIFT) & CAN_MCR_PNET_EN_MASK)
+#define CAN_MCR_DMA_MASK (0x8000U)
+#define CAN_MCR_DMA_SHIFT (15U)
+#define CAN_MCR_DMA(x) (((uint32_t)(x) << CAN_MCR_DMA_SHIFT) & CAN_MCR_DMA_MASK)
+#define CAN_MCR_IRMQ_MASK (0x10000U)
+#define CAN_MCR_IRMQ_SHIFT (16U)
+#define CAN_MCR_IRMQ(x) (((uint32_t)(x) << CAN_MCR_IRMQ_SHIFT) & CAN_MCR_IRMQ_MASK)
+#define CAN_MCR_SRXDIS_MASK (0x20000U)
+#define CAN_MCR_SRXDIS_SHIFT (17U)
+#define CAN_MCR_SRXDIS(x) (((uint32_t)(x) << CAN_MCR_SRXDIS_SHIFT) & CAN_MCR_SRXDIS_MASK)
+#define CAN_MCR_LPMACK_MASK (0x100000U)
+#define CAN_MCR_LPMACK_SHIFT (20U)
+#define CAN_MCR_WRNEN_MASK (0x200000U)
+#define CAN_MCR_WRNEN_SHIFT (21U)
+#define CAN_MCR_WRNEN(x) (((uint32_t)(x) << CAN_MCR_WRNEN_SHIFT) & CAN_MCR_WRNEN_MASK)
+#define CAN_MCR_SUPV_MASK (0x800000U)
+#define CAN_MCR_SUPV_SHIFT (23U)
+#define CAN_MCR_FRZACK_MASK (0x1000000U)
+#define CAN_MCR_FRZACK_SHIFT (24U)
+#define CAN_MCR_SOFTRST_MASK (0x2000000U)
+#define CAN_MCR_SOFTRST_SHIFT (25U)
+#define CAN_MCR_SOFTRST(x) (((uint32_t)(x) << CAN_MCR_SOFTRST_SHIFT) & CAN_MCR_SOFTRST_MASK)
+#define CAN_MCR_NOTRDY_MASK (0x8000000U)
+#define CAN_MCR_NOTRDY_SHIFT (27U)
+#define CAN_MCR_HALT_MASK (0x10000000U)
+#define CAN_MCR_HALT_SHIFT (28U)
+#define CAN_MCR_HALT(x) (((uint32_t)(x) << CAN_MCR_HALT_SHIFT) & CAN_MCR_HALT_MASK)
+#define CAN_MCR_RFEN_MASK (0x20000000U)
+#define CAN_MCR_RFEN_SHIFT (29U)
+#define CAN_MCR_RFEN(x) (((uint32_t)(x) << CAN_MCR_RFEN_SHIFT) & CAN_MCR_RFEN_MASK)
+#define CAN_MCR_FRZ_MASK (0x40000000U)
+#define CAN_MCR_FRZ_SHIFT (30U)
+#define CAN_MCR_FRZ(x) (((uint32_t)(x) << CAN_MCR_FRZ_SHIFT) & CAN_MCR_FRZ_MASK)
+#define CAN_MCR_MDIS_MASK (0x80000000U)
+#define CAN_MCR_MDIS_SHIFT (31U)
+#define CAN_MCR_MDIS(x) (((uint32_t)(x) << CAN_MCR_MDIS_SHIFT) & CAN_MCR_MDIS_MASK)
+
+/* CTRL1 */
+#define CAN_CTRL1_PROPSEG_MASK (0x7U)
+#define CAN_CTRL1_PROPSEG_SHIFT (0U)
+#define CAN_CTRL1_PROPSEG(x) (((uint32_t)(x) << CAN_CTRL1_PROPSEG_SHIFT) & CAN_CTRL1_PROPSEG_MASK)
+#define CAN_CTRL1_LOM_MASK (0x8U)
+#define CAN_CTRL1_LOM_SHIFT (3U)
+#define CAN_CTRL1_LBUF_MASK (0x10U)
+#define CAN_CTRL1_LBUF_SHIFT (4U)
+#define CAN_CTRL1_LBUF(x) (((uint32_t)(x) << CAN_CTRL1_LBUF_SHIFT) & CAN_CTRL1_LBUF_MASK)
+#define CAN_CTRL1_TSYN_MASK (0x20U)
+#define CAN_CTRL1_TSYN_SHIFT (5U)
+#define CAN_CTRL1_BOFFREC_MASK (0x40U)
+#define CAN_CTRL1_BOFFREC_SHIFT (6U)
+#define CAN_CTRL1_SMP_MASK (0x80U)
+#define CAN_CTRL1_SMP_SHIFT (7U)
+#define CAN_CTRL1_SMP(x) (((uint32_t)(x) << CAN_CTRL1_SMP_SHIFT) & CAN_CTRL1_SMP_MASK)
+#define CAN_CTRL1_RWRNMSK_MASK (0x400U)
+#define CAN_CTRL1_RWRNMSK_SHIFT (10U)
+#define CAN_CTRL1_TWRNMSK_MASK (0x800U)
+#define CAN_CTRL1_TWRNMSK_SHIFT (11U)
+#define CAN_CTRL1_LPB_MASK (0x1000U)
+#define CAN_CTRL1_LPB_SHIFT (12U)
+#define CAN_CTRL1_CLKSRC_MASK (0x2000U)
+#define CAN_CTRL1_CLKSRC_SHIFT (13U)
+#define CAN_CTRL1_CLKSRC(x) (((uint32_t)(x) << CAN_CTRL1_CLKSRC_SHIFT) & CAN_CTRL1_CLKSRC_MASK)
+#define CAN_CTRL1_ERRMSK_MASK (0x4000U)
+#define CAN_CTRL1_ERRMSK_SHIFT (14U)
+#define CAN_CTRL1_BOFFMSK_MASK (0x8000U)
+#define CAN_CTRL1_BOFFMSK_SHIFT (15U)
+#define CAN_CTRL1_PSEG2_MASK (0x70000U)
+#define CAN_CTRL1_PSEG2_SHIFT (16U)
+#define CAN_CTRL1_PSEG2(x) (((uint32_t)(x) << CAN_CTRL1_PSEG2_SHIFT) & CAN_CTRL1_PSEG2_MASK)
+#define CAN_CTRL1_PSEG1_MASK (0x380000U)
+#define CAN_CTRL1_PSEG1_SHIFT (19U)
+#define CAN_CTRL1_PSEG1(x) (((uint32_t)(x) << CAN_CTRL1_PSEG1_SHIFT) & CAN_CTRL1_PSEG1_MASK)
+#define CAN_CTRL1_RJW_MASK (0xC00000U)
+#define CAN_CTRL1_RJW_SHIFT (22U)
+#define CAN_CTRL1_RJW(x) (((uint32_t)(x) << CAN_CTRL1_RJW_SHIFT) & CAN_CTRL1_RJW_MASK)
+#define CAN_CTRL1_PRESDIV_MASK (0xFF000000U)
+#define CAN_CTRL1_PRESDIV_SHIFT (24U)
+#define CAN_CTRL1_PRESDIV(x) (((uint32_t)(x) << CAN_CTRL1_PRESDIV_SHIFT) & CAN_CTRL1_PRESDIV_MASK)
+
+/* TIMER */
+#define CAN_TIMER_TIMER_MASK (0xFFFFU)
+#define CAN_TIMER_TIMER_SHIFT (0U)
+
+/* ECR */
+#define CAN_ECR_TXERRCNT_MASK (0xFFU)
+#define CAN_ECR_TXERRCNT_SHIFT (0U)
+#define CAN_ECR_RXERRCNT_MASK (0xFF00U)
+#define CAN_ECR_RXERRCNT_SHIFT (8U)
+
+/* ESR1 */
+#define CAN_ESR1_ERRINT_MASK (0x2U)
+#define CAN_ESR1_BOFFINT_MASK (0x4U)
+#define CAN_ESR1_RX_MASK (0x8U)
+#define CAN_ESR1_FLTCONF_MASK (0x30U)
+#define CAN_ESR1_FLTCONF_SHIFT (4U)
+#define CAN_ESR1_TX_MASK (0x40U)
+#define CAN_ESR1_IDLE_MASK (0x80U)
+#define CAN_ESR1_RXWRN_MASK (0x100U)
+#define CAN_ESR1_TXWRN_MASK (0x200U)
+#define CAN_ESR1_RWRNINT_MASK (0x10000U)
+#define CAN_ESR1_TWRNINT_MASK (0x20000U)
+#define CAN_ESR1_SYNCH_MASK (0x40000U)
+#define CAN_ESR1_SYNCH_SHIFT (18U)
+#define CAN_ESR1_SYNCH_WIDTH (1U)
+#define CAN_ESR1_BOFFDONEINT_MASK (0x80000U)
+#define CAN_ESR1_ERRINT_FAST_MASK (0x100000U)
+#define CAN_ESR1_ERROVR_MASK (0x200000U)
+
+/* CTRL2 */
+#define CAN_CTRL2_EDFLTDIS_MASK (0x800U)
+#define CAN_CTRL2_ISOCANFDEN_MASK (0x1000U)
+#define CAN_CTRL2_ISOCANFDEN_SHIFT (12U)
+#define CAN_CTRL2_ISOCANFDEN(x) (((uint32_t)(x) << CAN_CTRL2_ISOCANFDEN_SHIFT) & CAN_CTRL2_ISOCANFDEN_MASK)
+#define CAN_CTRL2_TIMER_SRC_MASK (0x8000U)
+#define CAN_CTRL2_EACEN_MASK (0x10000U)
+#define CAN_CTRL2_RRS_MASK (0x20000U)
+#define CAN_CTRL2_MRP_MASK (0x40000U)
+#define CAN_CTRL2_MRP_SHIFT (18U)
+#define CAN_CTRL2_MRP(x) (((uint32_t)(x) << CAN_CTRL2_MRP_SHIFT) & CAN_CTRL2_MRP_MASK)
+#define CAN_CTRL2_TASD_MASK (0xF80000U)
+#define CAN_CTRL2_TASD_SHIFT (19U)
+#define CAN_CTRL2_RFFN_MASK (0xF000000U)
+#define CAN_CTRL2_RFFN_SHIFT (24U)
+#define CAN_CTRL2_RFFN(x) (((uint32_t)(x) << CAN_CTRL2_RFFN_SHIFT) & CAN_CTRL2_RFFN_MASK)
+#define CAN_CTRL2_BOFFDONEMSK_MASK (0x40000000U)
+#define CAN_CTRL2_ERRMSK_FAST_MASK (0x80000000U)
+
+/* RXFIR */
+#define CAN_RXFIR_IDHIT_MASK (0x1FFU)
+#define CAN_RXFIR_IDHIT_SHIFT (0U)
+
+/* CBT */
+#define CAN_CBT_EPSEG2_MASK (0x1FU)
+#define CAN_CBT_EPSEG2_SHIFT (0U)
+#define CAN_CBT_EPSEG1_MASK (0x3E0U)
+#define CAN_CBT_EPSEG1_SHIFT (5U)
+#define CAN_CBT_EPROPSEG_MASK (0xFC00U)
+#define CAN_CBT_EPROPSEG_SHIFT (10U)
+#define CAN_CBT_ERJW_MASK (0x1F0000U)
+#define CAN_CBT_ERJW_SHIFT (16U)
+#define CAN_CBT_EPRESDIV_MASK (0x7FE00000U)
+#define CAN_CBT_EPRESDIV_SHIFT (21U)
+#define CAN_CBT_BTF_MASK (0x80000000U)
+#define CAN_CBT_BTF_SHIFT (31U)
+
+/* FDCTRL */
+#define CAN_FDCTRL_TDCVAL_MASK (0x3FU)
+#define CAN_FDCTRL_TDCOFF_MASK (0x1F00U)
+#define CAN_FDCTRL_TDCOFF_SHIFT (8U)
+#define CAN_FDCTRL_TDCOFF(x) (((uint32_t)(x) << CAN_FDCTRL_TDCOFF_SHIFT) & CAN_FDCTRL_TDCOFF_MASK)
+#define CAN_FDCTRL_TDCEN_MASK (0x8000U)
+#define CAN_FDCTRL_TDCEN_SHIFT (15U)
+#define CAN_FDCTRL_TDCEN(x) (((uint32_t)(x) << CAN_FDCTRL_TDCEN_SHIFT) & CAN_FDCTRL_TDCEN_MASK)
+#define CAN_FDCTRL_MBDSR0_MASK (0x30000U)
+#define CAN_FDCTRL_MBDSR0_SHIFT (16U)
+#define CAN_FDCTRL_MBDSR0(x) (((uint32_t)(x) << CAN_FDCTRL_MBDSR0_SHIFT) & CAN_FDCTRL_MBDSR0_MASK)
+#define CAN_FDCTRL_FDRATE_MASK (0x80000000U)
+#define CAN_FDCTRL_FDRATE_SHIFT (31U)
+#define CAN_FDCTRL_FDRATE(x) (((uint32_t)(x) << CAN_FDCTRL_FDRATE_SHIFT) & CAN_FDCTRL_FDRATE_MASK)
+
+/* FDCBT */
+#define CAN_FDCBT_FPSEG2_MASK (0x7U)
+#define CAN_FDCBT_FPSEG2_SHIFT (0U)
+#define CAN_FDCBT_FPSEG2(x) (((uint32_t)(x) << CAN_FDCBT_FPSEG2_SHIFT) & CAN_FDCBT_FPSEG2_MASK)
+#define CAN_FDCBT_FPSEG1_MASK (0xE0U)
+#define CAN_FDCBT_FPSEG1_SHIFT (5U)
+#define CAN_FDCBT_FPSEG1(x) (((uint32_t)(x) << CAN_FDCBT_FPSEG1_SHIFT) & CAN_FDCBT_FPSEG1_MASK)
+#define CAN_FDCBT_FPROPSEG_MASK (0x7C00U)
+#define CAN_FDCBT_FPROPSEG_SHIFT (10U)
+#define CAN_FDCBT_FPROPSEG(x) (((uint32_t)(x) << CAN_FDCBT_FPROPSEG_SHIFT) & CAN_FDCBT_FPROPSEG_MASK)
+#define CAN_FDCBT_FRJW_MASK (0x70000U)
+#define CAN_FDCBT_FRJW_SHIFT (16U)
+#define CAN_FDCBT_FRJW(x) (((uint32_t)(x) << CAN_FDCBT_FRJW_SHIFT) & CAN_FDCBT_FRJW_MASK)
+#define CAN_FDCBT_FPRESDIV_MASK (0x3FF00000U)
+#define CAN_FDCBT_FPRESDIV_SHIFT (20U)
+#define CAN_FDCBT_FPRESDIV(x) (((uint32_t)(x) << CAN_FDCBT_FPRESDIV_SHIFT) & CAN_FDCBT_FPRESDIV_MASK)
+
+/* PCC */
+#define PCC_PCCn_COUNT (116U)
+#define PCC_FlexCAN0_INDEX (36U)
+#define PCC_FlexCAN1_INDEX (37U)
+#define PCC_FlexCAN2_INDEX (43U)
+#define PCC_PCCn_CGC_MASK (0x40000000U)
+#define PCC (&g_flexcanModelPcc)
+
+/* PORT */
+#define PORT_PCR_COUNT (32U)
+#define PORT_PCR_MUX_MASK (0x700U)
+#define PORT_PCR_MUX_SHIFT (8U)
+#define PORT_PCR_MUX(x) (((uint32_t)(x) << PORT_PCR_MUX_SHIFT) & PORT_PCR_MUX_MASK)
+#define PORTA (&g_flexcanModelPort[0])
+#define PORTB (&g_flexcanModelPort[1])
+#define PORTC (&g_flexcanModelPort[2])
+#define PORTD (&g_flexcanModelPort[3])
+#define PORTE (&g_flexcanModelPort[4])
+
+/* NVIC */
+#define S32_NVIC (&g_flexcanModelNvicPage.regs)
+
+/* DMA - the TCD array is moved down so the block fits one page, and the TCD
+ * addresses are pointer sized so host buffers can be reached */
+#define DMA_CHANNEL_COUNT (16U)
+#define DMA_CR_EMLM_MASK (0x80U)
+#define DMA_TCD_ATTR_DSIZE_MASK (0x7U)
+#define DMA_TCD_ATTR_DSIZE_SHIFT (0U)
+#define DMA_TCD_ATTR_DSIZE(x) (((uint16_t)(x) << DMA_TCD_ATTR_DSIZE_SHIFT) & DMA_TCD_ATTR_DSIZE_MASK)
+#define DMA_TCD_ATTR_SSIZE_MASK (0x700U)
+#define DMA_TCD_ATTR_SSIZE_SHIFT (8U)
+#define DMA_TCD_ATTR_SSIZE(x) (((uint16_t)(x) << DMA_TCD_ATTR_SSIZE_SHIFT) & DMA_TCD_ATTR_SSIZE_MASK)
+#define DMA_TCD_NBYTES_MLOFFYES_NBYTES_MASK (0x3FFU)
+#define DMA_TCD_NBYTES_MLOFFYES_NBYTES_SHIFT (0U)
+#define DMA_TCD_NBYTES_MLOFFYES_NBYTES(x) (((uint32_t)(x) << DMA_TCD_NBYTES_MLOFFYES_NBYTES_SHIFT) & DMA_TCD_NBYTES_MLOFFYES_NBYTES_MASK)
+#define DMA_TCD_NBYTES_MLOFFYES_MLOFF_MASK (0x3FFFFC00U)
+#define DMA_TCD_NBYTES_MLOFFYES_MLOFF_SHIFT (10U)
+#define DMA_TCD_NBYTES_MLOFFYES_MLOFF(x) (((uint32_t)(x) << DMA_TCD_NBYTES_MLOFFYES_MLOFF_SHIFT) & DMA_TCD_NBYTES_MLOFFYES_MLOFF_MASK)
+#define DMA_TCD_NBYTES_MLOFFYES_DMLOE_MASK (0x40000000U)
+#define DMA_TCD_NBYTES_MLOFFYES_SMLOE_MASK (0x80000000U)
+#define DMA_TCD_CITER_ELINKNO_CITER_MASK (0x7FFFU)
+#define DMA_TCD_CITER_ELINKNO_CITER(x) ((uint16_t)(x) & DMA_TCD_CITER_ELINKNO_CITER_MASK)
+#define DMA_TCD_BITER_ELINKNO_BITER_MASK (0x7FFFU)
+#define DMA_TCD_BITER_ELINKNO_BITER(x) ((uint16_t)(x) & DMA_TCD_BITER_ELINKNO_BITER_MASK)
+#define DMA_TCD_CSR_INTMAJOR_MASK (0x2U)
+#define DMA_TCD_CSR_INTHALF_MASK (0x4U)
+#define DMA_TCD_CSR_DREQ_MASK (0x8U)
+#define DMA_TCD_CSR_DONE_MASK (0x80U)
+#define DMA (&g_flexcanModelDmaPage.regs)
+
+/* DMAMUX */
+#define DMAMUX_CHCFG_COUNT (16U)
+#define DMAMUX_CHCFG_SOURCE_MASK (0x3FU)
+#define DMAMUX_CHCFG_SOURCE(x) ((uint8_t)(x) & DMAMUX_CHCFG_SOURCE_MASK)
+#define DMAMUX_CHCFG_ENBL_MASK (0x80U)
+#define PCC_DMAMUX_INDEX (33U)
+#define DMAMUX (&g_flexcanModelDmamux)
+
+/*******************************************************************************
+ * Datatype Definiton
+ ******************************************************************************/
+typedef enum
+{
+    DMA0_IRQn               = 0U,
+    DMA1_IRQn               = 1U,
+    DMA2_IRQn               = 2U,
+    DMA3_IRQn               = 3U,
+    DMA4_IRQn               = 4U,
+    DMA5_IRQn               = 5U,
+    DMA6_IRQn               = 6U,
+    DMA7_IRQn               = 7U,
+    DMA8_IRQn               = 8U,
+    DMA9_IRQn               = 9U,
+    DMA10_IRQn              = 10U,
+    DMA11_IRQn              = 11U,
+    DMA12_IRQn              = 12U,
+    DMA13_IRQn              = 13U,
+    DMA14_IRQn              = 14U,
+    DMA15_IRQn              = 15U,
+    CAN0_ORed_IRQn          = 78U,
+    CAN0_Error_IRQn         = 79U,
+    CAN0_Wake_Up_IRQn       = 80U,
+    CAN0_ORed_0_15_MB_IRQn  = 81U,
+    CAN0_ORed_16_31_MB_IRQn = 82U,
+    CAN1_ORed_IRQn          = 85U,
+    CAN1_Error_IRQn         = 86U,
+    CAN1_ORed_0_15_MB_IRQn  = 88U,
+    CAN1_ORed_16_31_MB_IRQn = 89U,
+    CAN2_ORed_IRQn          = 92U,
+    CAN2_Error_IRQn         = 93U,
+    CAN2_ORed_0_15_MB_IRQn  = 95U,
+    CAN2_ORed_16_31_MB_IRQn = 96U
+} IRQn_Type;
+
+typedef struct
+{
+    __IO uint32_t MCR;
+    __IO uint32_t CTRL1;
+    __IO uint32_t TIMER;
+    uint8_t RESERVED_0[4];
+    __IO uint32_t RXMGMASK;
+    __IO uint32_t RX14MASK;
+    __IO uint32_t RX15MASK;
+    __IO uint32_t ECR;
+    __IO uint32_t ESR1;
+    uint8_t RESERVED_1[4];
+    __IO uint32_t IMASK1;
+    uint8_t RESERVED_2[4];
+    __IO uint32_t IFLAG1;
+    __IO uint32_t CTRL2;
+    __I uint32_t ESR2;
+    uint8_t RESERVED_3[8];
+    __I uint32_t CRCR;
+    __IO uint32_t RXFGMASK;
+    __I uint32_t RXFIR;
+    __IO uint32_t CBT;
+    uint8_t RESERVED_4[44];
+    __IO uint32_t RAMn[CAN_RAMn_COUNT];
+    uint8_t RESERVED_5[1536];
+    __IO uint32_t RXIMR[CAN_RXIMR_COUNT];
+    uint8_t RESERVED_6[512];
+    __IO uint32_t CTRL1_PN;
+    __IO uint32_t CTRL2_PN;
+    __IO uint32_t WU_MTC;
+    __IO uint32_t FLT_ID1;
+    __IO uint32_t FLT_DLC;
+    __IO uint32_t PL1_LO;
+    __IO uint32_t PL1_HI;
+    __IO uint32_t FLT_ID2_IDMASK;
+    __IO uint32_t PL2_PLMASK_LO;
+    __IO uint32_t PL2_PLMASK_HI;
+    uint8_t RESERVED_7[24];
+    struct
+    {
+        __I uint32_t WMBn_CS;
+        __I uint32_t WMBn_ID;
+        __I uint32_t WMBn_D03;
+        __I uint32_t WMBn_D47;
+    } WMB[CAN_WMB_COUNT];
+    uint8_t RESERVED_8[128];
+    __IO uint32_t FDCTRL;
+    __IO uint32_t FDCBT;
+    __I uint32_t FDCRC;
+} CAN_Type;
+
+typedef struct
+{
+    __IO uint32_t PCCn[PCC_PCCn_COUNT];
+} PCC_Type;
+
+typedef struct
+{
+    __IO uint32_t PCR[PORT_PCR_COUNT];
+    __IO uint32_t GPCLR;
+    __IO uint32_t GPCHR;
+    uint8_t RESERVED_0[24];
+    __IO uint32_t ISFR;
+    uint8_t RESERVED_1[28];
+    __IO uint32_t DFER;
+    __IO uint32_t DFCR;
+    __IO uint32_t DFWR;
+} PORT_Type;
+
+typedef struct
+{
+    __IO uint32_t ISER[8];
+    uint8_t RESERVED_0[96];
+    __IO uint32_t ICER[8];
+    uint8_t RESERVED_1[96];
+    __IO uint32_t ISPR[8];
+    uint8_t RESERVED_2[96];
+    __IO uint32_t ICPR[8];
+    uint8_t RESERVED_3[96];
+    __I uint32_t IABR[8];
+    uint8_t RESERVED_4[224];
+    __IO uint8_t IP[240];
+    uint8_t RESERVED_5[2576];
+    __IO uint32_t STIR;
+} S32_NVIC_Type;
+
+typedef struct
+{
+    __IO uint32_t CR;
+    __I uint32_t ES;
+    uint8_t RESERVED_0[4];
+    __IO uint32_t ERQ;
+    uint8_t RESERVED_1[4];
+    __IO uint32_t EEI;
+    __IO uint8_t CEEI;
+    __IO uint8_t SEEI;
+    __IO uint8_t CERQ;
+    __IO uint8_t SERQ;
+    __IO uint8_t CDNE;
+    __IO uint8_t SSRT;
+    __IO uint8_t CERR;
+    __IO uint8_t CINT;
+    uint8_t RESERVED_2[4];
+    __IO uint32_t INT;
+    uint8_t RESERVED_3[4];
+    __IO uint32_t ERR;
+    uint8_t RESERVED_4[4];
+    __I uint32_t HRS;
+    uint8_t RESERVED_5[12];
+    __IO uint32_t EARS;
+    uint8_t RESERVED_6[184];
+    __IO uint8_t DCHPRI[DMA_CHANNEL_COUNT];
+    uint8_t RESERVED_7[240];
+    struct
+    {
+        __IO uintptr_t SADDR;
+        __IO int16_t SOFF;
+        __IO uint16_t ATTR;
+        union
+        {
+            __IO uint32_t MLNO;
+            __IO uint32_t MLOFFNO;
+            __IO uint32_t MLOFFYES;
+        } NBYTES;
+        __IO int32_t SLAST;
+        __IO uintptr_t DADDR;
+        __IO int16_t DOFF;
+        union
+        {
+            __IO uint16_t ELINKNO;
+            __IO uint16_t ELINKYES;
+        } CITER;
+        __IO int32_t DLASTSGA;
+        __IO uint16_t CSR;
+        union
+        {
+            __IO uint16_t ELINKNO;
+            __IO uint16_t ELINKYES;
+        } BITER;
+    } TCD[DMA_CHANNEL_COUNT];
+} DMA_Type;
+
+typedef struct
+{
+    __IO uint8_t CHCFG[DMAMUX_CHCFG_COUNT];
+} DMAMUX_Type;
+
+typedef union
+{
+    CAN_Type regs;
+    uint8_t page[FLEXCAN_MODEL_PAGE_SIZE];
+} __attribute__((aligned(FLEXCAN_MODEL_PAGE_SIZE))) FlexCAN_Model_CanPage_t;
+
+typedef union
+{
+    S32_NVIC_Type regs;
+    uint8_t page[FLEXCAN_MODEL_PAGE_SIZE];
+} __attribute__((aligned(FLEXCAN_MODEL_PAGE_SIZE))) FlexCAN_Model_NvicPage_t;
+
+typedef union
+{
+    DMA_Type regs;
+    uint8_t page[FLEXCAN_MODEL_PAGE_SIZE];
+} __attribute__((aligned(FLEXCAN_MODEL_PAGE_SIZE))) FlexCAN_Model_DmaPage_t;
+
+/* A frame as seen on the bus. id holds the value of the mailbox ID field
+ * (standard identifiers in bits 28-18, extended identifiers in bits 28-0) */
+typedef struct
+{
+    uint32_t id;
+    uint8_t ide;
+    uint8_t rtr;
+    uint8_t edl;
+    uint8_t brs;
+    uint8_t esi;
+    uint8_t length;
+    uint8_t data[64];
+    uint64_t timeNs;
+} FlexCAN_Model_Frame_t;
+
+typedef struct
+{
+    uint64_t regReads;
+    uint64_t regWrites;
+    uint64_t txFrames;
+    uint64_t rxFrames;
+    uint64_t rxDropped;
+    uint64_t rxOverrun;
+    uint64_t busBusyNs;
+    uint64_t irqEntries;
+    uint64_t dmaFrames;
+} FlexCAN_Model_Stats_t;
+
+typedef void (*FlexCAN_Model_TxListener)(uint32_t instance, const FlexCAN_Model_Frame_t *frame);
+
+/*******************************************************************************
+ * Variables
+ ******************************************************************************/
+extern FlexCAN_Model_CanPage_t g_flexcanModelCanPage[CAN_INSTANCE_COUNT];
+extern FlexCAN_Model_NvicPage_t g_flexcanModelNvicPage;
+extern FlexCAN_Model_DmaPage_t g_flexcanModelDmaPage;
+extern DMAMUX_Type g_flexcanModelDmamux;
+extern PCC_Type g_flexcanModelPcc;
+extern PORT_Type g_flexcanModelPort[5];
+
+/*******************************************************************************
+ * APIs
+ ******************************************************************************/
+void FlexCAN_Model_Init(void);
+void FlexCAN_Model_Deinit(void);
+void FlexCAN_Model_SetPeClock(uint32_t hz);
+void FlexCAN_Model_SetAccessCost(uint32_t ns);
+uint64_t FlexCAN_Model_GetTimeNs(void);
+void FlexCAN_Model_Advance(uint64_t ns);
+bool FlexCAN_Model_RunUntilIdle(uint64_t maxNs);
+bool FlexCAN_Model_InjectFrame(uint32_t instance, const FlexCAN_Model_Frame_t *frame);
+void FlexCAN_Model_SetTxListener(uint32_t instance, FlexCAN_Model_TxListener listener);
+void FlexCAN_Model_GetStats(uint32_t instance, FlexCAN_Model_Stats_t *stats);
+void FlexCAN_Model_ResetStats(void);
+uint32_t FlexCAN_Model_CycleCount(void);
+void FlexCAN_Model_SetErrorCounters(uint32_t instance, uint8_t txErrors, uint8_t rxErrors, bool busOff);
+
+#endif /* __FLEXCAN_MODEL_H__ */
+/*******************************************************************************
+ * End of file
+ ******************************************************************************/
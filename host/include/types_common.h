@@ -0,0 +1,30 @@
+#ifndef __TYPES_COMMON_H__
+#define __TYPES_COMMON_H__
+/*******************************************************************************
+ * Include
+ ******************************************************************************/
+#include <stdint.h>
+
+/*******************************************************************************
+ * Datatype Definiton
+ ******************************************************************************/
+/* Host-side stand-in for the application's node description, only what the
+ * middleware uses */
+typedef enum
+{
+    NODE_TYPE_FORWARDER = 0U,
+    NODE_TYPE_DISTANCE  = 1U,
+    NODE_TYPE_ANGLE     = 2U
+} Node_Type_t;
+
+typedef struct
+{
+    uint8_t nodeType;
+    uint16_t nodeID;
+    uint8_t threshold;
+} Node_Config_t;
+
+#endif /* __TYPES_COMMON_H__ */
+/*******************************************************************************
+ * End of file
+ ******************************************************************************/
@@ -0,0 +1,857 @@
+/*******************************************************************************
+ * Include
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "can_driver.h"
+#include "can_middleware.h"
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BENCH_INSTANCE (0U)
+#define BENCH_WORD_SIZE (4U)
+#define BENCH_FD_WORD_SIZE (18U)
+#define BENCH_MB_TX (0U)
+#define BENCH_MB_RX (1U)
+#define BENCH_DEFAULT_FRAMES (1000U)
+#define BENCH_RUN_LIMIT_NS (1000000000ULL)
+#define BENCH_ID_SHIFT (18U)
+#define BENCH_COPY_ITERATIONS (200U)
+#define BENCH_COPY_MB (2U)
+
+/* Segmented transport checks: the peer is played through the model. 2200 bytes
+ * take a first frame and 314 consecutive frames, more than 256 per block */
+#define BENCH_TP_NODE_ID (0x12U)
+#define BENCH_TP_TX_ID (0x7E8U << BENCH_ID_SHIFT)
+#define BENCH_TP_RX_ID (BENCH_TP_NODE_ID << BENCH_ID_SHIFT)
+#define BENCH_TP_LENGTH (2200U)
+#define BENCH_TP_BIT_TIMES_PER_MS (500U)
+#define BENCH_TP_STEP_NS (200000U)
+#define BENCH_TP_STEPS (1000U)
+#define BENCH_TP_NOT_DONE (-1)
+
+/* Node frames: distance nodes send to ID 0, angle nodes to ID 1 */
+#define BENCH_FWD_NODE_ID (0x05U)
+#define BENCH_NODE_ID (0x0123U)
+#define BENCH_NODE_FRAME_TYPE (6U)
+
+/* Rx FIFO and DMA checks: frames carry a sequence number the UART frames keep
+ * in byte 6. The model runs every 4 frames, within the 6 the FIFO holds */
+#define BENCH_RX_ID (0x0AU << BENCH_ID_SHIFT)
+#define BENCH_RX_RUN_EVERY (4U)
+#define BENCH_RX_DMA_RING (16U)
+#define BENCH_RX_FIFO_DEPTH (6U)
+#define BENCH_RX_FIFO_BURST (8U)
+#define BENCH_RX_DMA_BURST (64U)
+#define BENCH_UART_SEQUENCE (6U)
+
+/* Mailbox layout used by the legacy reference routines */
+#define LEGACY_CODE_SEND (0xCU)
+#define LEGACY_CODE_MASK (0x0F000000U)
+#define LEGACY_CODE_SHIFT (24U)
+#define LEGACY_DLC_MASK (0x000F0000U)
+#define LEGACY_DLC_SHIFT (16U)
+#define LEGACY_ID_MASK (0x1FFFFFFFU)
+
+/*******************************************************************************
+ * Datatype Definiton
+ ******************************************************************************/
+typedef struct
+{
+    const char *name;
+    uint32_t frames;
+    uint64_t simNs;
+    uint64_t hostNs;
+    uint64_t regReads;
+    uint64_t regWrites;
+    uint64_t latencySumNs;
+    uint64_t latencyMaxNs;
+    uint64_t busBusyNs;
+    uint64_t irqEntries;
+    uint64_t lost;
+    uint64_t payloadBytes;
+} Bench_Result_t;
+
+/*******************************************************************************
+ * Variables Definition
+ ******************************************************************************/
+static FlexCAN_bit_timing_t s_bitTiming =
+{
+    .propseg = 6u,
+    .pseg1 = 3u,
+    .pseg2 = 3u,
+    .rjw = 3u,
+    .presdiv = 0u,
+    .smp = 1u
+};
+
+/* 2 Mbit/s data phase with the 8 MHz PE clock: 4 tq per bit */
+static FlexCAN_fd_bit_timing_t s_fdBitTiming =
+{
+    .fpresdiv = 0u,
+    .frjw = 1u,
+    .fpropseg = 0u,
+    .fpseg1 = 1u,
+    .fpseg2 = 1u,
+    .tdcOffset = 3u
+};
+
+static volatile uint32_t s_txDone;
+static volatile uint32_t s_rxCount;
+static uint64_t s_lastIrqNs;
+static FlexCAN_TX_MessageBuffer_t s_rxBuffer;
+static Node_Config_t s_tpNode = { NODE_TYPE_DISTANCE, BENCH_TP_NODE_ID, 0U };
+static Node_Config_t s_fwdNode = { NODE_TYPE_FORWARDER, BENCH_FWD_NODE_ID, 0U };
+static uint8_t s_tpData[BENCH_TP_LENGTH];
+static uint8_t s_tpBuffer[BENCH_TP_LENGTH];
+static int32_t s_tpTxDone;
+static int32_t s_tpRxDone;
+static uint16_t s_tpTxLength;
+static uint16_t s_tpRxLength;
+static uint64_t s_tpTxDoneNs;
+static uint64_t s_tpLastFrameNs;
+static uint32_t s_tpFlowControls;
+static uint32_t s_tpConsecutive;
+static uint32_t s_tpSequenceErrors;
+static FlexCAN_RxFifo_dma_frame_t s_rxDmaRing[BENCH_RX_DMA_RING];
+static const FlexCAN_RxFifo_filter_t s_rxFifoFilter[1] = { { 0U, 0U, 1U, 0U } };
+static uint8_t s_rxSequence;
+static uint8_t s_rxExpected;
+static uint32_t s_rxOrderErrors;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+static uint64_t Bench_HostNs(void);
+static void Bench_IrqCallback(uint32_t flagMaskMB);
+static void Bench_Setup(uint8_t wordSize, FlexCAN_fd_bit_timing_t *fdBitTiming);
+static void Bench_Transmit(const char *name, const FlexCAN_TX_MessageBuffer_t *message,
+                           uint32_t frames, Bench_Result_t *result);
+static void Bench_ReceiveBurst(uint32_t frames, Bench_Result_t *result);
+static uint32_t Bench_Print(const Bench_Result_t *result);
+static void Bench_LegacyConfigTx(CAN_Type *base, uint8_t indexOfMB, FlexCAN_TX_MessageBuffer_t *DataOfMB);
+static void Bench_LegacyReceive(CAN_Type *base, uint8_t IndexOfMb, FlexCAN_TX_MessageBuffer_t *mbData);
+static void Bench_CopyCompare(uint32_t iterations);
+static void Bench_TpListener(uint32_t instance, const FlexCAN_Model_Frame_t *frame);
+static void Bench_TpTxDone(bool success, uint16_t length);
+static void Bench_TpRxDone(bool success, uint16_t length);
+static void Bench_TpInject(const uint8_t *data, uint8_t length);
+static void Bench_TpSetup(uint8_t blockSize);
+static uint32_t Bench_TpReceive(void);
+static uint32_t Bench_TpSend(void);
+static uint32_t Bench_TpSequenceError(void);
+static void Bench_MiddlewareSetup(CAN_MiddlewareConfig_t *config);
+static void Bench_NodeInject(uint8_t nodeType, uint16_t nodeID);
+static uint32_t Bench_ForwarderFilter(void);
+static void Bench_RxInject(uint32_t frames, bool run);
+static uint32_t Bench_RxDrain(void);
+static uint32_t Bench_RxDmaPartial(void);
+static uint32_t Bench_RxFifoBurst(void);
+static uint32_t Bench_RxDmaBurst(void);
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+static uint64_t Bench_HostNs(void)
+{
+    struct timespec now;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/* Mirrors what the middleware does on each mailbox interrupt */
+static void Bench_IrqCallback(uint32_t flagMaskMB)
+{
+    s_lastIrqNs = FlexCAN_Model_GetTimeNs();
+    if ((flagMaskMB >> BENCH_MB_TX) & 1U)
+    {
+        s_txDone++;
+    }
+    if ((flagMaskMB >> BENCH_MB_RX) & 1U)
+    {
+        FlexCAN_Receive(BENCH_INSTANCE, BENCH_MB_RX, &s_rxBuffer);
+        s_rxCount++;
+    }
+}
+
+static void Bench_Setup(uint8_t wordSize, FlexCAN_fd_bit_timing_t *fdBitTiming)
+{
+    FlexCAN_RX_MessageBuffer_t configMbRx;
+
+    FlexCAN_Model_Init();
+    memset(&configMbRx, 0, sizeof(configMbRx));
+    configMbRx.cfControl.ide = 1U;
+    configMbRx.RxIdMask = 0U;
+    FlexCAN_Init(BENCH_INSTANCE, wordSize, &s_bitTiming);
+    if (fdBitTiming != NULL)
+    {
+        FlexCAN_ConfigFD(BENCH_INSTANCE, fdBitTiming);
+    }
+    FlexCAN_Config_RX_MessageBuffer(BENCH_INSTANCE, BENCH_MB_RX, &configMbRx);
+    FlexCAN_ConfigInterrupt(BENCH_INSTANCE, BENCH_MB_TX);
+    FlexCAN_ConfigInterrupt(BENCH_INSTANCE, BENCH_MB_RX);
+    FlexCAN_InitIRQ(BENCH_INSTANCE, CAN0_ORed_0_15_MB_IRQn, Bench_IrqCallback);
+    (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+    FlexCAN_Model_ResetStats();
+}
+
+/* One frame in flight at a time, next one queued from the completion */
+static void Bench_Transmit(const char *name, const FlexCAN_TX_MessageBuffer_t *message,
+                           uint32_t frames, Bench_Result_t *result)
+{
+    FlexCAN_TX_MessageBuffer_t msg;
+    FlexCAN_Model_Stats_t stats;
+    uint64_t simStart;
+    uint64_t sendNs;
+    uint64_t hostStart;
+    uint64_t latency;
+    uint32_t index;
+
+    msg = *message;
+    memset(result, 0, sizeof(Bench_Result_t));
+    result->name = name;
+    simStart = FlexCAN_Model_GetTimeNs();
+    for (index = 0U; index < frames; index++)
+    {
+        msg.cfID.id = (index & 0x7FFU) << BENCH_ID_SHIFT;
+        msg.dataByte[0] = (uint8_t)index;
+        s_txDone = 0U;
+        sendNs = FlexCAN_Model_GetTimeNs();
+        hostStart = Bench_HostNs();
+        FlexCAN_Send(BENCH_INSTANCE, BENCH_MB_TX, &msg);
+        result->hostNs += Bench_HostNs() - hostStart;
+        (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+        if (s_txDone == 0U)
+        {
+            result->lost++;
+            continue;
+        }
+        result->payloadBytes += FlexCAN_DlcToLength(msg.cfControl.dlc);
+        latency = s_lastIrqNs - sendNs;
+        result->latencySumNs += latency;
+        if (latency > result->latencyMaxNs)
+        {
+            result->latencyMaxNs = latency;
+        }
+    }
+    FlexCAN_Model_GetStats(BENCH_INSTANCE, &stats);
+    result->frames = frames;
+    result->simNs = FlexCAN_Model_GetTimeNs() - simStart;
+    result->regReads = stats.regReads;
+    result->regWrites = stats.regWrites;
+    result->busBusyNs = stats.busBusyNs;
+    result->irqEntries = stats.irqEntries;
+}
+
+/* Frames from other nodes arrive back to back */
+static void Bench_ReceiveBurst(uint32_t frames, Bench_Result_t *result)
+{
+    FlexCAN_Model_Frame_t frame;
+    FlexCAN_Model_Stats_t stats;
+    uint64_t simStart;
+    uint64_t hostStart;
+    uint32_t index;
+    uint32_t injected;
+
+    memset(&frame, 0, sizeof(frame));
+    memset(result, 0, sizeof(Bench_Result_t));
+    result->name = "rx burst 8B";
+    frame.ide = 1U;
+    frame.length = 8U;
+    s_rxCount = 0U;
+    simStart = FlexCAN_Model_GetTimeNs();
+    hostStart = Bench_HostNs();
+    for (index = 0U; index < frames; index += injected)
+    {
+        for (injected = 0U; (index + injected < frames) && (injected < 128U); injected++)
+        {
+            frame.id = ((index + injected) & 0x7FFU) << BENCH_ID_SHIFT;
+            frame.data[0] = (uint8_t)(index + injected);
+            frame.timeNs = FlexCAN_Model_GetTimeNs();
+            (void)FlexCAN_Model_InjectFrame(BENCH_INSTANCE, &frame);
+        }
+        (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+    }
+    FlexCAN_Model_GetStats(BENCH_INSTANCE, &stats);
+    result->hostNs = Bench_HostNs() - hostStart;
+    result->frames = s_rxCount;
+    result->simNs = FlexCAN_Model_GetTimeNs() - simStart;
+    result->regReads = stats.regReads;
+    result->regWrites = stats.regWrites;
+    result->busBusyNs = stats.busBusyNs;
+    result->irqEntries = stats.irqEntries;
+    result->lost = (uint64_t)frames - s_rxCount;
+    result->payloadBytes = (uint64_t)s_rxCount * frame.length;
+}
+
+/* Returns 1 when a frame was lost */
+static uint32_t Bench_Print(const Bench_Result_t *result)
+{
+    uint32_t frames = (result->frames != 0U) ? result->frames : 1U;
+    uint64_t simNs = (result->simNs != 0U) ? result->simNs : 1U;
+
+    printf("%-16s frames=%-6u lost=%-6llu frames/s=%-8llu payload=%-7llu B/s bus=%5.1f%% "
+           "reads/frame=%6.1f writes/frame=%6.1f irq/frame=%4.2f "
+           "lat avg=%llu ns max=%llu ns host=%llu ns/frame %s\n",
+           result->name, result->frames, (unsigned long long)result->lost,
+           (unsigned long long)((uint64_t)result->frames * 1000000000ULL / simNs),
+           (unsigned long long)(result->payloadBytes * 1000000000ULL / simNs),
+           100.0 * (double)result->busBusyNs / (double)simNs,
+           (double)result->regReads / frames, (double)result->regWrites / frames,
+           (double)result->irqEntries / frames,
+           (unsigned long long)(result->latencySumNs / frames),
+           (unsigned long long)result->latencyMaxNs,
+           (unsigned long long)(result->hostNs / frames), (result->lost == 0U) ? "ok" : "FAIL");
+
+    return (result->lost == 0U) ? 0U : 1U;
+}
+
+/* Byte-wise payload write as it was before the word-wise copy engine */
+static void Bench_LegacyConfigTx(CAN_Type *base, uint8_t indexOfMB, FlexCAN_TX_MessageBuffer_t *DataOfMB)
+{
+    uint32_t *mbData = (uint32_t *)(void *)DataOfMB;
+    uint8_t indexOfData;
+    uint8_t IndexOfRAM;
+
+    for (indexOfData = 0; indexOfData < DataOfMB->cfControl.dlc; indexOfData++)
+    {
+        IndexOfRAM = indexOfMB * BENCH_WORD_SIZE + 2U + indexOfData / 4U;
+        base->RAMn[IndexOfRAM] = base->RAMn[IndexOfRAM] << 8U;
+        base->RAMn[IndexOfRAM] |= DataOfMB->dataByte[indexOfData];
+    }
+    base->RAMn[indexOfMB * BENCH_WORD_SIZE] = 0U;
+    base->RAMn[indexOfMB * BENCH_WORD_SIZE] = *mbData;
+    base->RAMn[indexOfMB * BENCH_WORD_SIZE + 1U] = 0U;
+    base->RAMn[indexOfMB * BENCH_WORD_SIZE + 1U] = *(mbData + 1);
+    base->RAMn[indexOfMB * BENCH_WORD_SIZE] &= ~(LEGACY_CODE_MASK);
+    base->RAMn[indexOfMB * BENCH_WORD_SIZE] |= (LEGACY_CODE_SEND << LEGACY_CODE_SHIFT);
+}
+
+/* Byte-wise payload read as it was before the word-wise copy engine */
+static void Bench_LegacyReceive(CAN_Type *base, uint8_t IndexOfMb, FlexCAN_TX_MessageBuffer_t *mbData)
+{
+    uint8_t indexData;
+
+    while ((base->RAMn[IndexOfMb * BENCH_WORD_SIZE] >> LEGACY_CODE_SHIFT) & 1U)
+    {
+    }
+    mbData->cfID.id = (base->RAMn[IndexOfMb * BENCH_WORD_SIZE + 1U] & LEGACY_ID_MASK);
+    mbData->cfControl.dlc = (base->RAMn[IndexOfMb * BENCH_WORD_SIZE] & LEGACY_DLC_MASK) >> LEGACY_DLC_SHIFT;
+    for (indexData = 0U; indexData < (uint8_t)mbData->cfControl.dlc; indexData++)
+    {
+        mbData->dataByte[indexData] = (uint8_t)(base->RAMn[IndexOfMb * BENCH_WORD_SIZE + 2U + (indexData / 4U)] >> (24U - 8U * (indexData % 4U)));
+    }
+    (void)base->TIMER;
+}
+
+/* Mailbox write/read cost, legacy byte-wise against the driver. The module is
+ * frozen so nothing leaves the mailbox while it is rewritten. Modelled time is
+ * register accesses times the model access cost; host time is dominated by the
+ * access traps and only meaningful relative to the other row */
+static void Bench_CopyCompare(uint32_t iterations)
+{
+    FlexCAN_TX_MessageBuffer_t msg;
+    FlexCAN_Model_Stats_t before;
+    FlexCAN_Model_Stats_t after;
+    uint64_t hostStart;
+    uint64_t simStart;
+    uint32_t index;
+    uint32_t variant;
+    const char *names[4] = { "write legacy", "write words", "read legacy", "read words" };
+
+    memset(&msg, 0, sizeof(msg));
+    msg.cfControl.ide = 1U;
+    msg.cfControl.dlc = 8U;
+    msg.cfID.id = 0x123U << BENCH_ID_SHIFT;
+    for (index = 0U; index < 8U; index++)
+    {
+        msg.dataByte[index] = (uint8_t)(0xA0U + index);
+    }
+    CAN0->MCR |= CAN_MCR_FRZ_MASK | CAN_MCR_HALT_MASK;
+    for (variant = 0U; variant < 4U; variant++)
+    {
+        FlexCAN_Model_GetStats(BENCH_INSTANCE, &before);
+        simStart = FlexCAN_Model_GetTimeNs();
+        hostStart = Bench_HostNs();
+        for (index = 0U; index < iterations; index++)
+        {
+            switch (variant)
+            {
+            case 0U:
+                Bench_LegacyConfigTx(CAN0, BENCH_COPY_MB, &msg);
+                break;
+            case 1U:
+                FlexCAN_Config_Tx_MessageBuffer(BENCH_INSTANCE, BENCH_COPY_MB, &msg);
+                break;
+            case 2U:
+                Bench_LegacyReceive(CAN0, BENCH_COPY_MB, &s_rxBuffer);
+                break;
+            default:
+                FlexCAN_Receive(BENCH_INSTANCE, BENCH_COPY_MB, &s_rxBuffer);
+                break;
+            }
+        }
+        hostStart = Bench_HostNs() - hostStart;
+        FlexCAN_Model_GetStats(BENCH_INSTANCE, &after);
+        printf("%-16s reads/frame=%5.1f writes/frame=%5.1f model=%6llu ns/frame host=%7llu ns/frame\n",
+               names[variant],
+               (double)(after.regReads - before.regReads) / iterations,
+               (double)(after.regWrites - before.regWrites) / iterations,
+               (unsigned long long)((FlexCAN_Model_GetTimeNs() - simStart) / iterations),
+               (unsigned long long)(hostStart / iterations));
+    }
+    CAN0->MCR &= ~(CAN_MCR_FRZ_MASK | CAN_MCR_HALT_MASK);
+    (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+}
+
+/* Frames the middleware sends: flow controls and consecutive frames, whose
+ * sequence numbers have to run 1 to 15 and wrap to 0 */
+static void Bench_TpListener(uint32_t instance, const FlexCAN_Model_Frame_t *frame)
+{
+    uint8_t type = frame->data[0] >> 4U;
+
+    (void)instance;
+    s_tpLastFrameNs = FlexCAN_Model_GetTimeNs();
+    if (type == 3U)
+    {
+        s_tpFlowControls++;
+    }
+    else if (type == 2U)
+    {
+        s_tpConsecutive++;
+        if ((frame->data[0] & 0x0FU) != (s_tpConsecutive & 0x0FU))
+        {
+            s_tpSequenceErrors++;
+        }
+    }
+}
+
+static void Bench_TpTxDone(bool success, uint16_t length)
+{
+    s_tpTxDone = success ? 1 : 0;
+    s_tpTxLength = length;
+    s_tpTxDoneNs = FlexCAN_Model_GetTimeNs();
+}
+
+static void Bench_TpRxDone(bool success, uint16_t length)
+{
+    s_tpRxDone = success ? 1 : 0;
+    s_tpRxLength = length;
+}
+
+/* A frame of the peer with length bytes, taken before the next one comes */
+static void Bench_TpInject(const uint8_t *data, uint8_t length)
+{
+    FlexCAN_Model_Frame_t frame;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.ide = 1U;
+    frame.id = BENCH_TP_RX_ID;
+    frame.length = length;
+    memcpy(frame.data, data, length);
+    (void)FlexCAN_Model_InjectFrame(BENCH_INSTANCE, &frame);
+    (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+}
+
+/* Middleware on CAN0 with the transport set to blockSize, no separation time */
+static void Bench_TpSetup(uint8_t blockSize)
+{
+    static CAN_Middleware_TpConfig_t tpConfig;
+    CAN_MiddlewareConfig_t config;
+    uint32_t index;
+
+    memset(&config, 0, sizeof(config));
+    config.nodeConfigPtr = &s_tpNode;
+    memset(&tpConfig, 0, sizeof(tpConfig));
+    tpConfig.txId = BENCH_TP_TX_ID;
+    tpConfig.rxId = BENCH_TP_RX_ID;
+    tpConfig.blockSize = blockSize;
+    tpConfig.bitTimesPerMs = BENCH_TP_BIT_TIMES_PER_MS;
+    tpConfig.txDone = Bench_TpTxDone;
+    tpConfig.rxDone = Bench_TpRxDone;
+    for (index = 0U; index < BENCH_TP_LENGTH; index++)
+    {
+        s_tpData[index] = (uint8_t)((index * 13U) + 5U);
+    }
+    memset(s_tpBuffer, 0, sizeof(s_tpBuffer));
+    s_tpTxDone = BENCH_TP_NOT_DONE;
+    s_tpRxDone = BENCH_TP_NOT_DONE;
+    s_tpFlowControls = 0U;
+    s_tpConsecutive = 0U;
+    s_tpSequenceErrors = 0U;
+    Bench_MiddlewareSetup(&config);
+    FlexCAN_Model_SetTxListener(BENCH_INSTANCE, Bench_TpListener);
+    (void)CANMiddlewareTp_Config(&tpConfig);
+}
+
+/* Receive with block size 0: the first frame gets the only flow control, all
+ * consecutive frames follow without another one. Returns 1 on a failure */
+static uint32_t Bench_TpReceive(void)
+{
+    uint8_t frame[8];
+    uint32_t offset = 6U;
+    uint32_t length;
+    uint32_t frames = 0U;
+    bool ok;
+
+    Bench_TpSetup(0U);
+    (void)CANMiddlewareTp_Receive(s_tpBuffer, sizeof(s_tpBuffer));
+    frame[0] = (uint8_t)(0x10U | (BENCH_TP_LENGTH >> 8U));
+    frame[1] = (uint8_t)BENCH_TP_LENGTH;
+    memcpy(&frame[2], s_tpData, 6U);
+    Bench_TpInject(frame, 8U);
+    while (offset < BENCH_TP_LENGTH)
+    {
+        frames++;
+        length = ((BENCH_TP_LENGTH - offset) < 7U) ? (BENCH_TP_LENGTH - offset) : 7U;
+        frame[0] = (uint8_t)(0x20U | (frames & 0x0FU));
+        memset(&frame[1], 0xCC, 7U);
+        memcpy(&frame[1], &s_tpData[offset], length);
+        Bench_TpInject(frame, 8U);
+        offset += length;
+    }
+    ok = (s_tpRxDone == 1) && (s_tpRxLength == BENCH_TP_LENGTH) && (s_tpFlowControls == 1U) &&
+         (memcmp(s_tpBuffer, s_tpData, BENCH_TP_LENGTH) == 0);
+    printf("%-16s length=%-5u cf=%-4u fc=%-2u done=%d %s\n", "tp rx bs=0", (unsigned)s_tpRxLength, frames,
+           s_tpFlowControls, (int)s_tpRxDone, ok ? "ok" : "FAIL");
+    FlexCAN_Model_Deinit();
+
+    return ok ? 0U : 1U;
+}
+
+/* Send with a peer granting block size 0: consecutive frames in sequence, and
+ * txDone only once the last one is on the bus. Returns 1 on a failure */
+static uint32_t Bench_TpSend(void)
+{
+    const uint8_t flowControl[3] = { 0x30U, 0U, 0U };
+    uint32_t step;
+    bool ok;
+
+    Bench_TpSetup(0U);
+    (void)CANMiddlewareTp_Send(s_tpData, BENCH_TP_LENGTH);
+    (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+    Bench_TpInject(flowControl, sizeof(flowControl));
+    for (step = 0U; (step < BENCH_TP_STEPS) && (s_tpTxDone == BENCH_TP_NOT_DONE); step++)
+    {
+        FlexCAN_Model_Advance(BENCH_TP_STEP_NS);
+        (void)CANMiddlewareTp_Run();
+    }
+    (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+    ok = (s_tpTxDone == 1) && (s_tpTxLength == BENCH_TP_LENGTH) && (s_tpConsecutive == 314U) &&
+         (s_tpSequenceErrors == 0U) && (s_tpTxDoneNs >= s_tpLastFrameNs);
+    printf("%-16s length=%-5u cf=%-4u seqerr=%-2u done=%d %s\n", "tp tx bs=0", (unsigned)s_tpTxLength,
+           s_tpConsecutive, s_tpSequenceErrors, (int)s_tpTxDone, ok ? "ok" : "FAIL");
+    FlexCAN_Model_Deinit();
+
+    return ok ? 0U : 1U;
+}
+
+/* A skipped sequence number ends the reception with the bytes received so far,
+ * a consecutive frame too short for its data as well. Returns 1 on a failure */
+static uint32_t Bench_TpSequenceError(void)
+{
+    uint8_t frame[8] = { 0x10U, 100U, 1U, 2U, 3U, 4U, 5U, 6U };
+    uint8_t consecutive[8] = { 0x21U, 7U, 8U, 9U, 10U, 11U, 12U, 13U };
+    bool ok;
+    bool shortOk;
+
+    Bench_TpSetup(8U);
+    (void)CANMiddlewareTp_Receive(s_tpBuffer, sizeof(s_tpBuffer));
+    Bench_TpInject(frame, 8U);
+    Bench_TpInject(consecutive, 8U);
+    consecutive[0] = 0x23U;
+    Bench_TpInject(consecutive, 8U);
+    ok = (s_tpRxDone == 0) && (s_tpRxLength == 13U);
+    printf("%-16s length=%-5u done=%d %s\n", "tp rx seq error", (unsigned)s_tpRxLength, (int)s_tpRxDone,
+           ok ? "ok" : "FAIL");
+    s_tpRxDone = BENCH_TP_NOT_DONE;
+    (void)CANMiddlewareTp_Receive(s_tpBuffer, sizeof(s_tpBuffer));
+    Bench_TpInject(frame, 8U);
+    consecutive[0] = 0x21U;
+    Bench_TpInject(consecutive, 3U);
+    shortOk = (s_tpRxDone == 0) && (s_tpRxLength == 6U);
+    printf("%-16s length=%-5u done=%d %s\n", "tp rx short cf", (unsigned)s_tpRxLength, (int)s_tpRxDone,
+           shortOk ? "ok" : "FAIL");
+    FlexCAN_Model_Deinit();
+
+    return ((ok) && (shortOk)) ? 0U : 1U;
+}
+
+/* Middleware on CAN0 of a fresh model, left idle with cleared counters */
+static void Bench_MiddlewareSetup(CAN_MiddlewareConfig_t *config)
+{
+    FlexCAN_Model_Init();
+    (void)CANMiddleware_Init(config);
+    (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+    FlexCAN_Model_ResetStats();
+    CANMiddleware_ResetStats();
+}
+
+/* A CHECK_CONNECTION response of a node, sent to its forwarder ID */
+static void Bench_NodeInject(uint8_t nodeType, uint16_t nodeID)
+{
+    FlexCAN_Model_Frame_t frame;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.ide = 1U;
+    frame.id = (nodeType == NODE_TYPE_DISTANCE) ? 0U : (1U << BENCH_ID_SHIFT);
+    frame.length = 8U;
+    frame.data[0] = nodeType;
+    frame.data[1] = BENCH_NODE_FRAME_TYPE;
+    frame.data[2] = (uint8_t)nodeID;
+    frame.data[3] = (uint8_t)(nodeID >> 8U);
+    (void)FlexCAN_Model_InjectFrame(BENCH_INSTANCE, &frame);
+    (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+}
+
+/* The default receive filter of a forwarder takes both node classes, whatever
+ * its own node ID. Returns 1 on a failure */
+static uint32_t Bench_ForwarderFilter(void)
+{
+    CAN_MiddlewareConfig_t config;
+    CAN_Middleware_Node_t nodes[4];
+    FlexCAN_Model_Stats_t stats;
+    uint32_t count;
+    bool ok;
+
+    memset(&config, 0, sizeof(config));
+    config.nodeConfigPtr = &s_fwdNode;
+    Bench_MiddlewareSetup(&config);
+    Bench_NodeInject(NODE_TYPE_DISTANCE, BENCH_NODE_ID);
+    Bench_NodeInject(NODE_TYPE_ANGLE, BENCH_NODE_ID);
+    FlexCAN_Model_GetStats(BENCH_INSTANCE, &stats);
+    count = CANMiddlewareFwd_ListNodes(nodes, 4U);
+    ok = (count == 2U) && (stats.rxDropped == 0U);
+    printf("%-16s nodes=%-2u dropped=%-2llu %s\n", "fwd filter", count, (unsigned long long)stats.rxDropped,
+           ok ? "ok" : "FAIL");
+    FlexCAN_Model_Deinit();
+
+    return ok ? 0U : 1U;
+}
+
+/* Frames numbered on from s_rxSequence, the model run every few of them when
+ * run is set and once at the end */
+static void Bench_RxInject(uint32_t frames, bool run)
+{
+    FlexCAN_Model_Frame_t frame;
+    uint32_t index;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.ide = 1U;
+    frame.id = BENCH_RX_ID;
+    frame.length = 8U;
+    for (index = 0U; index < frames; index++)
+    {
+        frame.data[4] = s_rxSequence;
+        s_rxSequence++;
+        (void)FlexCAN_Model_InjectFrame(BENCH_INSTANCE, &frame);
+        if ((run) && ((index % BENCH_RX_RUN_EVERY) == (BENCH_RX_RUN_EVERY - 1U)))
+        {
+            (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+        }
+    }
+    (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+}
+
+/* Read what the middleware received, as the forwarder does, and count frames
+ * out of sequence. Returns the number of frames read */
+static uint32_t Bench_RxDrain(void)
+{
+    uint8_t *data;
+    uint32_t count = 0U;
+
+    do
+    {
+        data = NULL;
+        CANMiddleWare_ConvertDataCanToUart(&data);
+        if (data != NULL)
+        {
+            if (data[BENCH_UART_SEQUENCE] != s_rxExpected)
+            {
+                s_rxOrderErrors++;
+            }
+            s_rxExpected = (uint8_t)(data[BENCH_UART_SEQUENCE] + 1U);
+            count++;
+        }
+    } while (data != NULL);
+
+    return count;
+}
+
+/* Rx FIFO emptied by the DMA into a 16 frame ring: 3 frames, then 20 read 4 at
+ * a time, none of it a multiple of the 8 frame half, all reach the reader.
+ * Returns 1 on a failure */
+static uint32_t Bench_RxDmaPartial(void)
+{
+    CAN_MiddlewareConfig_t config;
+    FlexCAN_Model_Stats_t stats;
+    uint32_t first;
+    uint32_t received;
+    uint32_t round;
+    bool ok;
+
+    memset(&config, 0, sizeof(config));
+    config.nodeConfigPtr = &s_fwdNode;
+    config.rxFifoFilter = s_rxFifoFilter;
+    config.rxFifoFilterCount = 1U;
+    config.rxDmaRing = s_rxDmaRing;
+    config.rxDmaRingSize = BENCH_RX_DMA_RING;
+    Bench_MiddlewareSetup(&config);
+    s_rxSequence = 0U;
+    s_rxExpected = 0U;
+    s_rxOrderErrors = 0U;
+    Bench_RxInject(3U, true);
+    first = Bench_RxDrain();
+    received = first;
+    for (round = 0U; round < 5U; round++)
+    {
+        Bench_RxInject(4U, true);
+        received += Bench_RxDrain();
+    }
+    FlexCAN_Model_GetStats(BENCH_INSTANCE, &stats);
+    ok = (first == 3U) && (received == 23U) && (s_rxOrderErrors == 0U) && (stats.dmaFrames == 23U);
+    printf("%-16s frames=%-3u first=%-2u got=%-3u order=%-2u %s\n", "rx dma partial", (unsigned)stats.dmaFrames,
+           first, received, s_rxOrderErrors, ok ? "ok" : "FAIL");
+    FlexCAN_Model_Deinit();
+
+    return ok ? 0U : 1U;
+}
+
+/* Rx FIFO read by interrupt: 8 frames arrive while CAN0 is masked, the FIFO
+ * keeps the first 6 and flags the overflow, and takes frames again once read.
+ * Returns 1 on a failure */
+static uint32_t Bench_RxFifoBurst(void)
+{
+    CAN_MiddlewareConfig_t config;
+    FlexCAN_Model_Stats_t stats;
+    FlexCAN_Stats_t driverStats;
+    uint32_t received;
+    uint32_t after;
+    bool ok;
+
+    memset(&config, 0, sizeof(config));
+    config.nodeConfigPtr = &s_fwdNode;
+    config.rxFifoFilter = s_rxFifoFilter;
+    config.rxFifoFilterCount = 1U;
+    Bench_MiddlewareSetup(&config);
+    (void)FlexCAN_ResetStats(BENCH_INSTANCE);
+    s_rxSequence = 0U;
+    s_rxExpected = 0U;
+    s_rxOrderErrors = 0U;
+    (void)FlexCAN_DisableIRQ(BENCH_INSTANCE);
+    Bench_RxInject(BENCH_RX_FIFO_BURST, false);
+    (void)FlexCAN_EnableIRQ(BENCH_INSTANCE);
+    (void)FlexCAN_Model_RunUntilIdle(BENCH_RUN_LIMIT_NS);
+    received = Bench_RxDrain();
+    s_rxExpected = s_rxSequence;
+    Bench_RxInject(BENCH_RX_RUN_EVERY, true);
+    after = Bench_RxDrain();
+    FlexCAN_Model_GetStats(BENCH_INSTANCE, &stats);
+    (void)FlexCAN_GetStats(BENCH_INSTANCE, &driverStats);
+    ok = (received == BENCH_RX_FIFO_DEPTH) && (after == BENCH_RX_RUN_EVERY) && (s_rxOrderErrors == 0U) &&
+         (stats.rxOverrun == (BENCH_RX_FIFO_BURST - BENCH_RX_FIFO_DEPTH)) && (driverStats.rxOverruns != 0U);
+    printf("%-16s frames=%-3u got=%-3u after=%-2u overrun=%-2llu order=%-2u %s\n", "rx fifo burst",
+           BENCH_RX_FIFO_BURST, received, after, (unsigned long long)stats.rxOverrun, s_rxOrderErrors,
+           ok ? "ok" : "FAIL");
+    FlexCAN_Model_Deinit();
+
+    return ok ? 0U : 1U;
+}
+
+/* Rx FIFO emptied by the DMA: 64 frames wrap the 16 frame ring four times, each
+ * is copied by the DMA and read in order. Returns 1 on a failure */
+static uint32_t Bench_RxDmaBurst(void)
+{
+    CAN_MiddlewareConfig_t config;
+    FlexCAN_Model_Stats_t stats;
+    FlexCAN_Stats_t driverStats;
+    uint32_t received = 0U;
+    uint32_t round;
+    bool ok;
+
+    memset(&config, 0, sizeof(config));
+    config.nodeConfigPtr = &s_fwdNode;
+    config.rxFifoFilter = s_rxFifoFilter;
+    config.rxFifoFilterCount = 1U;
+    config.rxDmaRing = s_rxDmaRing;
+    config.rxDmaRingSize = BENCH_RX_DMA_RING;
+    Bench_MiddlewareSetup(&config);
+    (void)FlexCAN_ResetStats(BENCH_INSTANCE);
+    s_rxSequence = 0U;
+    s_rxExpected = 0U;
+    s_rxOrderErrors = 0U;
+    for (round = 0U; round < (BENCH_RX_DMA_BURST / (BENCH_RX_DMA_RING / 2U)); round++)
+    {
+        Bench_RxInject(BENCH_RX_DMA_RING / 2U, true);
+        received += Bench_RxDrain();
+    }
+    FlexCAN_Model_GetStats(BENCH_INSTANCE, &stats);
+    (void)FlexCAN_GetStats(BENCH_INSTANCE, &driverStats);
+    ok = (received == BENCH_RX_DMA_BURST) && (s_rxOrderErrors == 0U) && (stats.dmaFrames == BENCH_RX_DMA_BURST) &&
+         (driverStats.rxFrames == BENCH_RX_DMA_BURST);
+    printf("%-16s frames=%-3llu got=%-3u driver=%-3u order=%-2u %s\n", "rx dma burst",
+           (unsigned long long)stats.dmaFrames, received, driverStats.rxFrames, s_rxOrderErrors, ok ? "ok" : "FAIL");
+    FlexCAN_Model_Deinit();
+
+    return ok ? 0U : 1U;
+}
+
+int main(int argc, char **argv)
+{
+    Bench_Result_t result;
+    FlexCAN_TX_MessageBuffer_t message;
+    uint32_t frames = BENCH_DEFAULT_FRAMES;
+    uint32_t failures = 0U;
+
+    if (argc > 1)
+    {
+        frames = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+    memset(&message, 0, sizeof(message));
+    message.cfControl.ide = 1U;
+    message.cfControl.srr = 1U;
+    message.cfControl.dlc = 8U;
+    Bench_Setup(BENCH_WORD_SIZE, NULL);
+    Bench_Transmit("tx classic 8B", &message, frames, &result);
+    failures += Bench_Print(&result);
+    FlexCAN_Model_ResetStats();
+    Bench_ReceiveBurst(frames, &result);
+    failures += Bench_Print(&result);
+    Bench_CopyCompare(BENCH_COPY_ITERATIONS);
+    FlexCAN_Model_Deinit();
+
+    /* Same link reconfigured for 64 byte FD frames, which a build with a
+     * smaller FLEXCAN_MAX_PAYLOAD cannot hold */
+    if (FLEXCAN_MAX_PAYLOAD >= 64U)
+    {
+        message.cfControl.edl = 1U;
+        message.cfControl.brs = 1U;
+        message.cfControl.dlc = FlexCAN_LengthToDlc(64U);
+        Bench_Setup(BENCH_FD_WORD_SIZE, &s_fdBitTiming);
+        Bench_Transmit("tx fd 64B brs", &message, frames, &result);
+        failures += Bench_Print(&result);
+        FlexCAN_Model_Deinit();
+    }
+    else
+    {
+        printf("%-16s skipped, FLEXCAN_MAX_PAYLOAD=%u\n", "tx fd 64B brs", (unsigned)FLEXCAN_MAX_PAYLOAD);
+    }
+
+    failures += Bench_TpReceive();
+    failures += Bench_TpSend();
+    failures += Bench_TpSequenceError();
+    failures += Bench_ForwarderFilter();
+    failures += Bench_RxDmaPartial();
+    failures += Bench_RxFifoBurst();
+    failures += Bench_RxDmaBurst();
+
+    return (failures == 0U) ? 0 : 1;
+}
+/*******************************************************************************
+ * End of file
+ ******************************************************************************/
@@ -0,0 +1,1491 @@
+/*******************************************************************************
+ * Include
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include "flexcan_model.h"
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "The FlexCAN host model relies on x86-64 Linux page protection and single-step traps"
+#endif
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define FLEXCAN_MODEL_NVIC_PAGE (CAN_INSTANCE_COUNT)
+#define FLEXCAN_MODEL_DMA_PAGE (CAN_INSTANCE_COUNT + 1U)
+#define FLEXCAN_MODEL_PAGE_COUNT (CAN_INSTANCE_COUNT + 2U)
+
+/* DMAMUX request source of the FlexCAN0 Rx FIFO, CAN1 and CAN2 follow */
+#define FLEXCAN_MODEL_DMA_SOURCE_CAN0 (54U)
+
+#define FLEXCAN_MODEL_RX_QUEUE_SIZE (256U)
+#define FLEXCAN_MODEL_FIFO_DEPTH (6U)
+#define FLEXCAN_MODEL_FIFO_WARNING (5U)
+#define FLEXCAN_MODEL_MAX_MB (32U)
+#define FLEXCAN_MODEL_IRQ_GUARD (64U)
+#define FLEXCAN_MODEL_DEFAULT_PE_CLOCK (8000000U)
+#define FLEXCAN_MODEL_DEFAULT_ACCESS_COST (25U)
+#define FLEXCAN_MODEL_NS_PER_SECOND (1000000000ULL)
+
+#define X86_EFLAGS_TF (0x100U)
+#define X86_PF_WRITE (0x2U)
+
+#define MB_CODE_RX_INACTIVE (0x0U)
+#define MB_CODE_RX_FULL (0x2U)
+#define MB_CODE_RX_EMPTY (0x4U)
+#define MB_CODE_RX_OVERRUN (0x6U)
+#define MB_CODE_TX_INACTIVE (0x8U)
+#define MB_CODE_TX_ABORT (0x9U)
+#define MB_CODE_TX_DATA (0xCU)
+
+#define MB_CS_CODE_SHIFT (24U)
+#define MB_CS_CODE_MASK (0x0F000000U)
+#define MB_CS_EDL_SHIFT (31U)
+#define MB_CS_BRS_SHIFT (30U)
+#define MB_CS_ESI_SHIFT (29U)
+#define MB_CS_SRR_SHIFT (22U)
+#define MB_CS_IDE_SHIFT (21U)
+#define MB_CS_RTR_SHIFT (20U)
+#define MB_CS_DLC_SHIFT (16U)
+#define MB_CS_DLC_MASK (0x000F0000U)
+#define MB_CS_TIMESTAMP_MASK (0x0000FFFFU)
+#define MB_ID_MASK (0x1FFFFFFFU)
+
+/* Rx FIFO: output in MB0, filter table from MB6, flags in IFLAG1 bits 5-7 */
+#define FIFO_FILTER_TABLE_WORD (24U)
+#define FIFO_FLAG_AVAILABLE (0x20U)
+#define FIFO_FLAG_WARNING (0x40U)
+#define FIFO_FLAG_OVERFLOW (0x80U)
+#define FIFO_FILTER_RTR_SHIFT (31U)
+#define FIFO_FILTER_IDE_SHIFT (30U)
+#define FIFO_FILTER_EXT_SHIFT (1U)
+#define FIFO_FILTER_STD_SHIFT (19U)
+#define MB_STD_ID_SHIFT (18U)
+
+#define CAN_MCR_RESET_VALUE (0xD890000FU)
+#define CAN_CTRL2_RESET_VALUE (0x00B00000U)
+#define CAN_FDCTRL_RESET_VALUE (0x80000100U)
+#define CAN_MCR_STATUS_BITS (CAN_MCR_FRZACK_MASK | CAN_MCR_NOTRDY_MASK | CAN_MCR_LPMACK_MASK | CAN_MCR_SOFTRST_MASK)
+#define CAN_ESR1_W1C_BITS (CAN_ESR1_ERRINT_MASK | CAN_ESR1_BOFFINT_MASK | CAN_ESR1_RWRNINT_MASK | \
+                           CAN_ESR1_TWRNINT_MASK | CAN_ESR1_BOFFDONEINT_MASK | CAN_ESR1_ERRINT_FAST_MASK | \
+                           CAN_ESR1_ERROVR_MASK)
+
+#define CAN_REG_OFFSET(reg) ((uint32_t)offsetof(CAN_Type, reg))
+
+/*******************************************************************************
+ * Datatype Definiton
+ ******************************************************************************/
+typedef struct
+{
+    bool busy;
+    bool busIsTx;
+    bool txAbandoned;
+    uint8_t txMb;
+    uint64_t busEndNs;
+    uint64_t busIdleNs;
+    FlexCAN_Model_Frame_t busFrame;
+    FlexCAN_Model_Frame_t rxQueue[FLEXCAN_MODEL_RX_QUEUE_SIZE];
+    uint32_t rxHead;
+    uint32_t rxCount;
+    FlexCAN_Model_Frame_t fifo[FLEXCAN_MODEL_FIFO_DEPTH];
+    uint16_t fifoHit[FLEXCAN_MODEL_FIFO_DEPTH];
+    uint16_t fifoStamp[FLEXCAN_MODEL_FIFO_DEPTH];
+    uint32_t fifoHead;
+    uint32_t fifoCount;
+    uint64_t txReadyNs[FLEXCAN_MODEL_MAX_MB];
+    uint32_t timerOffset;
+    FlexCAN_Model_TxListener listener;
+    FlexCAN_Model_Stats_t stats;
+} FlexCAN_Model_Instance_t;
+
+typedef struct
+{
+    bool active;
+    bool isWrite;
+    uint32_t page;
+    uint32_t offset;
+    uint32_t before;
+} FlexCAN_Model_Trap_t;
+
+/*******************************************************************************
+ * Variables Definition
+ ******************************************************************************/
+FlexCAN_Model_CanPage_t g_flexcanModelCanPage[CAN_INSTANCE_COUNT];
+FlexCAN_Model_NvicPage_t g_flexcanModelNvicPage;
+FlexCAN_Model_DmaPage_t g_flexcanModelDmaPage;
+DMAMUX_Type g_flexcanModelDmamux;
+PCC_Type g_flexcanModelPcc;
+PORT_Type g_flexcanModelPort[5];
+
+static FlexCAN_Model_Instance_t s_modelIns[CAN_INSTANCE_COUNT];
+/* CAN0 has 32 mailboxes of 16 bytes, CAN1 and CAN2 have 16 */
+static const uint32_t s_modelRamBytes[CAN_INSTANCE_COUNT] = { 512U, 256U, 256U };
+static FlexCAN_Model_Trap_t s_trap;
+static uint32_t s_nvicEnabled[8];
+static uint64_t s_nowNs;
+static uint32_t s_peClockHz = FLEXCAN_MODEL_DEFAULT_PE_CLOCK;
+static uint32_t s_accessCostNs = FLEXCAN_MODEL_DEFAULT_ACCESS_COST;
+static bool s_inIrq;
+static bool s_installed;
+static struct sigaction s_oldSegvAction;
+static struct sigaction s_oldTrapAction;
+
+static const uint8_t s_dlcToLength[16] = { 0U, 1U, 2U, 3U, 4U, 5U, 6U, 7U, 8U, 12U, 16U, 20U, 24U, 32U, 48U, 64U };
+
+/* Interrupt handlers are provided by the driver; weak references keep the model
+ * linkable when a handler is not implemented */
+extern void CAN0_ORed_0_15_MB_IRQHandler(void) __attribute__((weak));
+extern void CAN1_ORed_0_15_MB_IRQHandler(void) __attribute__((weak));
+extern void CAN2_ORed_0_15_MB_IRQHandler(void) __attribute__((weak));
+extern void CAN0_ORed_16_31_MB_IRQHandler(void) __attribute__((weak));
+extern void CAN1_ORed_16_31_MB_IRQHandler(void) __attribute__((weak));
+extern void CAN2_ORed_16_31_MB_IRQHandler(void) __attribute__((weak));
+
+static void (*const s_mbLowIrqHandler[CAN_INSTANCE_COUNT])(void) =
+{
+    CAN0_ORed_0_15_MB_IRQHandler, CAN1_ORed_0_15_MB_IRQHandler, CAN2_ORed_0_15_MB_IRQHandler
+};
+static void (*const s_mbHighIrqHandler[CAN_INSTANCE_COUNT])(void) =
+{
+    CAN0_ORed_16_31_MB_IRQHandler, CAN1_ORed_16_31_MB_IRQHandler, CAN2_ORed_16_31_MB_IRQHandler
+};
+static const IRQn_Type s_mbLowIrqNumber[CAN_INSTANCE_COUNT] =
+{
+    CAN0_ORed_0_15_MB_IRQn, CAN1_ORed_0_15_MB_IRQn, CAN2_ORed_0_15_MB_IRQn
+};
+static const IRQn_Type s_mbHighIrqNumber[CAN_INSTANCE_COUNT] =
+{
+    CAN0_ORed_16_31_MB_IRQn, CAN1_ORed_16_31_MB_IRQn, CAN2_ORed_16_31_MB_IRQn
+};
+
+extern void DMA0_IRQHandler(void) __attribute__((weak));
+extern void DMA1_IRQHandler(void) __attribute__((weak));
+extern void DMA2_IRQHandler(void) __attribute__((weak));
+extern void DMA3_IRQHandler(void) __attribute__((weak));
+extern void DMA4_IRQHandler(void) __attribute__((weak));
+extern void DMA5_IRQHandler(void) __attribute__((weak));
+extern void DMA6_IRQHandler(void) __attribute__((weak));
+extern void DMA7_IRQHandler(void) __attribute__((weak));
+extern void DMA8_IRQHandler(void) __attribute__((weak));
+extern void DMA9_IRQHandler(void) __attribute__((weak));
+extern void DMA10_IRQHandler(void) __attribute__((weak));
+extern void DMA11_IRQHandler(void) __attribute__((weak));
+extern void DMA12_IRQHandler(void) __attribute__((weak));
+extern void DMA13_IRQHandler(void) __attribute__((weak));
+extern void DMA14_IRQHandler(void) __attribute__((weak));
+extern void DMA15_IRQHandler(void) __attribute__((weak));
+
+/* DMA channel n raises IRQ n */
+static void (*const s_dmaIrqHandler[DMA_CHANNEL_COUNT])(void) =
+{
+    DMA0_IRQHandler, DMA1_IRQHandler, DMA2_IRQHandler, DMA3_IRQHandler,
+    DMA4_IRQHandler, DMA5_IRQHandler, DMA6_IRQHandler, DMA7_IRQHandler,
+    DMA8_IRQHandler, DMA9_IRQHandler, DMA10_IRQHandler, DMA11_IRQHandler,
+    DMA12_IRQHandler, DMA13_IRQHandler, DMA14_IRQHandler, DMA15_IRQHandler
+};
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+static void *FlexCAN_Model_PageBase(uint32_t page);
+static void FlexCAN_Model_Protect(void);
+static void FlexCAN_Model_Unprotect(void);
+static void FlexCAN_Model_ResetInstance(uint32_t instance);
+static bool FlexCAN_Model_IsActive(const CAN_Type *base);
+static bool FlexCAN_Model_IsConfigurable(const CAN_Type *base);
+static uint32_t FlexCAN_Model_MbBytes(const CAN_Type *base);
+static uint32_t FlexCAN_Model_MbCount(const CAN_Type *base);
+static uint32_t FlexCAN_Model_FirstMb(const CAN_Type *base);
+static bool FlexCAN_Model_FifoMatch(const CAN_Type *base, const FlexCAN_Model_Frame_t *frame, uint16_t *idHit);
+static void FlexCAN_Model_FifoLoadOutput(uint32_t instance);
+static void FlexCAN_Model_FifoPop(uint32_t instance);
+static void FlexCAN_Model_RunDma(uint32_t instance);
+static void FlexCAN_Model_DmaWrite(uint32_t offset, uint32_t before, uint32_t after);
+static uint32_t FlexCAN_Model_NominalBitTicks(const CAN_Type *base);
+static uint32_t FlexCAN_Model_DataBitTicks(const CAN_Type *base);
+static uint64_t FlexCAN_Model_FrameNs(const CAN_Type *base, const FlexCAN_Model_Frame_t *frame);
+static uint16_t FlexCAN_Model_TimerValue(uint32_t instance);
+static uint8_t FlexCAN_Model_LengthToDlc(uint8_t length);
+static void FlexCAN_Model_ReadMailbox(const CAN_Type *base, uint32_t mb, FlexCAN_Model_Frame_t *frame);
+static void FlexCAN_Model_MoveIn(uint32_t instance, const FlexCAN_Model_Frame_t *frame);
+static void FlexCAN_Model_FinishFrame(uint32_t instance);
+static void FlexCAN_Model_RunInstance(uint32_t instance);
+static void FlexCAN_Model_RunAll(void);
+static uint64_t FlexCAN_Model_NextEventNs(void);
+static void FlexCAN_Model_DispatchIrqs(void);
+static void FlexCAN_Model_CanRead(uint32_t instance, uint32_t offset);
+static void FlexCAN_Model_CanWrite(uint32_t instance, uint32_t offset, uint32_t before, uint32_t after);
+static void FlexCAN_Model_RamWrite(uint32_t instance, uint32_t word, uint32_t before, uint32_t after);
+static void FlexCAN_Model_NvicWrite(uint32_t offset, uint32_t after);
+static void FlexCAN_Model_SegvHandler(int sig, siginfo_t *info, void *context);
+static void FlexCAN_Model_TrapHandler(int sig, siginfo_t *info, void *context);
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+static void *FlexCAN_Model_PageBase(uint32_t page)
+{
+    void *base;
+
+    if (page == FLEXCAN_MODEL_NVIC_PAGE)
+    {
+        base = (void *)&g_flexcanModelNvicPage;
+    }
+    else if (page == FLEXCAN_MODEL_DMA_PAGE)
+    {
+        base = (void *)&g_flexcanModelDmaPage;
+    }
+    else
+    {
+        base = (void *)&g_flexcanModelCanPage[page];
+    }
+
+    return base;
+}
+
+static void FlexCAN_Model_Protect(void)
+{
+    uint32_t page;
+
+    if (s_installed)
+    {
+        for (page = 0U; page < FLEXCAN_MODEL_PAGE_COUNT; page++)
+        {
+            (void)mprotect(FlexCAN_Model_PageBase(page), FLEXCAN_MODEL_PAGE_SIZE, PROT_NONE);
+        }
+    }
+}
+
+static void FlexCAN_Model_Unprotect(void)
+{
+    uint32_t page;
+
+    for (page = 0U; page < FLEXCAN_MODEL_PAGE_COUNT; page++)
+    {
+        (void)mprotect(FlexCAN_Model_PageBase(page), FLEXCAN_MODEL_PAGE_SIZE, PROT_READ | PROT_WRITE);
+    }
+}
+
+static void FlexCAN_Model_ResetInstance(uint32_t instance)
+{
+    CAN_Type *base = &g_flexcanModelCanPage[instance].regs;
+    FlexCAN_Model_TxListener listener = s_modelIns[instance].listener;
+
+    memset((void *)base, 0, sizeof(CAN_Type));
+    base->MCR = CAN_MCR_RESET_VALUE;
+    base->RXMGMASK = 0xFFFFFFFFU;
+    base->RX14MASK = 0xFFFFFFFFU;
+    base->RX15MASK = 0xFFFFFFFFU;
+    base->RXFGMASK = 0xFFFFFFFFU;
+    base->CTRL2 = CAN_CTRL2_RESET_VALUE;
+    base->FDCTRL = CAN_FDCTRL_RESET_VALUE;
+    memset(&s_modelIns[instance], 0, sizeof(FlexCAN_Model_Instance_t));
+    s_modelIns[instance].listener = listener;
+}
+
+static bool FlexCAN_Model_IsActive(const CAN_Type *base)
+{
+    return (base->MCR & CAN_MCR_NOTRDY_MASK) == 0U;
+}
+
+static bool FlexCAN_Model_IsConfigurable(const CAN_Type *base)
+{
+    return (base->MCR & (CAN_MCR_FRZACK_MASK | CAN_MCR_MDIS_MASK)) != 0U;
+}
+
+static uint32_t FlexCAN_Model_MbBytes(const CAN_Type *base)
+{
+    uint32_t bytes = 16U;
+
+    if ((base->MCR & CAN_MCR_FDEN_MASK) != 0U)
+    {
+        bytes = 8U + (8U << ((base->FDCTRL & CAN_FDCTRL_MBDSR0_MASK) >> CAN_FDCTRL_MBDSR0_SHIFT));
+    }
+
+    return bytes;
+}
+
+static uint32_t FlexCAN_Model_MbCount(const CAN_Type *base)
+{
+    uint32_t instance = (uint32_t)((const FlexCAN_Model_CanPage_t *)(const void *)base - g_flexcanModelCanPage);
+    uint32_t count = s_modelRamBytes[instance] / FlexCAN_Model_MbBytes(base);
+    uint32_t maxMb = ((base->MCR & CAN_MCR_MAXMB_MASK) >> CAN_MCR_MAXMB_SHIFT) + 1U;
+
+    return (maxMb < count) ? maxMb : count;
+}
+
+/* With the Rx FIFO on, MB0-5 hold the FIFO and 2 mailboxes per 8 filter
+ * elements hold the ID table; only the mailboxes after them are regular */
+static uint32_t FlexCAN_Model_FirstMb(const CAN_Type *base)
+{
+    uint32_t first = 0U;
+
+    if (((base->MCR & CAN_MCR_RFEN_MASK) != 0U) && ((base->MCR & CAN_MCR_FDEN_MASK) == 0U))
+    {
+        first = 8U + 2U * ((base->CTRL2 & CAN_CTRL2_RFFN_MASK) >> CAN_CTRL2_RFFN_SHIFT);
+    }
+
+    return first;
+}
+
+/* Format A filter elements (IDAM = 0): RTR bit 31, IDE bit 30, extended ID in
+ * bits 29-1 or standard ID in bits 29-19. The first 8 + 2 * RFFN elements use
+ * RXIMR when IRMQ is set, the rest RXFGMASK */
+static bool FlexCAN_Model_FifoMatch(const CAN_Type *base, const FlexCAN_Model_Frame_t *frame, uint16_t *idHit)
+{
+    uint32_t rffn = (base->CTRL2 & CAN_CTRL2_RFFN_MASK) >> CAN_CTRL2_RFFN_SHIFT;
+    uint32_t elements = 8U * (rffn + 1U);
+    uint32_t individual = ((base->MCR & CAN_MCR_IRMQ_MASK) != 0U) ? (8U + 2U * rffn) : 0U;
+    uint32_t key;
+    uint32_t mask;
+    uint32_t index;
+    bool matched = false;
+
+    key = ((uint32_t)frame->rtr << FIFO_FILTER_RTR_SHIFT) | ((uint32_t)frame->ide << FIFO_FILTER_IDE_SHIFT);
+    if (frame->ide != 0U)
+    {
+        key |= (frame->id & MB_ID_MASK) << FIFO_FILTER_EXT_SHIFT;
+    }
+    else
+    {
+        key |= ((frame->id & MB_ID_MASK) >> MB_STD_ID_SHIFT) << FIFO_FILTER_STD_SHIFT;
+    }
+    for (index = 0U; (index < elements) && !matched; index++)
+    {
+        mask = (index < individual) ? base->RXIMR[index] : base->RXFGMASK;
+        if (((base->RAMn[FIFO_FILTER_TABLE_WORD + index] ^ key) & mask) == 0U)
+        {
+            *idHit = (uint16_t)index;
+            matched = true;
+        }
+    }
+
+    return matched;
+}
+
+/* Present the oldest FIFO entry in MB0 and raise "frames available" */
+static void FlexCAN_Model_FifoLoadOutput(uint32_t instance)
+{
+    CAN_Type *base = &g_flexcanModelCanPage[instance].regs;
+    FlexCAN_Model_Instance_t *ctx = &s_modelIns[instance];
+    const FlexCAN_Model_Frame_t *frame = &ctx->fifo[ctx->fifoHead];
+    uint32_t index;
+
+    base->RAMn[2U] = 0U;
+    base->RAMn[3U] = 0U;
+    for (index = 0U; (index < frame->length) && (index < 8U); index++)
+    {
+        base->RAMn[2U + index / 4U] |= (uint32_t)frame->data[index] << (24U - 8U * (index % 4U));
+    }
+    base->RAMn[1U] = frame->id & MB_ID_MASK;
+    base->RAMn[0U] = ((uint32_t)frame->ide << MB_CS_SRR_SHIFT) |
+                     ((uint32_t)frame->ide << MB_CS_IDE_SHIFT) |
+                     ((uint32_t)frame->rtr << MB_CS_RTR_SHIFT) |
+                     ((uint32_t)FlexCAN_Model_LengthToDlc(frame->length) << MB_CS_DLC_SHIFT) |
+                     ctx->fifoStamp[ctx->fifoHead];
+    *(volatile uint32_t *)&base->RXFIR = ctx->fifoHit[ctx->fifoHead];
+    base->IFLAG1 |= FIFO_FLAG_AVAILABLE;
+}
+
+/* The output has been read: the next entry moves to MB0 */
+static void FlexCAN_Model_FifoPop(uint32_t instance)
+{
+    CAN_Type *base = &g_flexcanModelCanPage[instance].regs;
+    FlexCAN_Model_Instance_t *ctx = &s_modelIns[instance];
+
+    base->IFLAG1 &= ~FIFO_FLAG_AVAILABLE;
+    if (ctx->fifoCount != 0U)
+    {
+        ctx->fifoHead = (ctx->fifoHead + 1U) % FLEXCAN_MODEL_FIFO_DEPTH;
+        ctx->fifoCount--;
+        if (ctx->fifoCount != 0U)
+        {
+            FlexCAN_Model_FifoLoadOutput(instance);
+        }
+    }
+}
+
+/* eDMA stand-in: with MCR[DMA] set, "frames available" is a DMA request served
+ * at once by the channel the DMAMUX routes it to. Each request runs one minor
+ * loop (NBYTES with SOFF/DOFF, then the minor loop offset when enabled) and
+ * pops the FIFO; the major loop handles CITER, SLAST/DLASTSGA, INTHALF,
+ * INTMAJOR and DREQ. Only 32-bit transfers are modelled */
+static void FlexCAN_Model_RunDma(uint32_t instance)
+{
+    CAN_Type *base = &g_flexcanModelCanPage[instance].regs;
+    DMA_Type *dma = &g_flexcanModelDmaPage.regs;
+    FlexCAN_Model_Instance_t *ctx = &s_modelIns[instance];
+    uint32_t channel;
+    uint32_t nbytes;
+    uint32_t index;
+    int32_t mloff;
+    uintptr_t src;
+    uintptr_t dst;
+    uint16_t citer;
+    uint16_t biter;
+
+    if (((base->MCR & CAN_MCR_DMA_MASK) == 0U) || (FlexCAN_Model_FirstMb(base) == 0U))
+    {
+        return;
+    }
+    for (channel = 0U; channel < DMA_CHANNEL_COUNT; channel++)
+    {
+        if (g_flexcanModelDmamux.CHCFG[channel] ==
+            (DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(FLEXCAN_MODEL_DMA_SOURCE_CAN0 + instance)))
+        {
+            break;
+        }
+    }
+    while ((channel < DMA_CHANNEL_COUNT) && (ctx->fifoCount != 0U) && (((dma->ERQ >> channel) & 1U) != 0U))
+    {
+        nbytes = dma->TCD[channel].NBYTES.MLNO;
+        mloff = 0;
+        if (((dma->CR & DMA_CR_EMLM_MASK) != 0U) &&
+            ((nbytes & (DMA_TCD_NBYTES_MLOFFYES_SMLOE_MASK | DMA_TCD_NBYTES_MLOFFYES_DMLOE_MASK)) != 0U))
+        {
+            /* 20-bit signed offset in bits 29-10 */
+            mloff = (int32_t)((nbytes & DMA_TCD_NBYTES_MLOFFYES_MLOFF_MASK) << 2U) >> 12;
+            nbytes &= DMA_TCD_NBYTES_MLOFFYES_NBYTES_MASK;
+        }
+        else
+        {
+            mloff = 0;
+            nbytes &= DMA_TCD_NBYTES_MLOFFYES_NBYTES_MASK;
+        }
+        src = dma->TCD[channel].SADDR;
+        dst = dma->TCD[channel].DADDR;
+        for (index = 0U; index < nbytes; index += 4U)
+        {
+            *(volatile uint32_t *)dst = *(volatile uint32_t *)src;
+            src += (intptr_t)dma->TCD[channel].SOFF;
+            dst += (intptr_t)dma->TCD[channel].DOFF;
+        }
+        if ((dma->TCD[channel].NBYTES.MLNO & DMA_TCD_NBYTES_MLOFFYES_SMLOE_MASK) != 0U)
+        {
+            src += (intptr_t)mloff;
+        }
+        if ((dma->TCD[channel].NBYTES.MLNO & DMA_TCD_NBYTES_MLOFFYES_DMLOE_MASK) != 0U)
+        {
+            dst += (intptr_t)mloff;
+        }
+        FlexCAN_Model_FifoPop(instance);
+        ctx->stats.dmaFrames++;
+        citer = (uint16_t)(dma->TCD[channel].CITER.ELINKNO - 1U);
+        biter = dma->TCD[channel].BITER.ELINKNO;
+        if ((citer == (biter / 2U)) && ((dma->TCD[channel].CSR & DMA_TCD_CSR_INTHALF_MASK) != 0U))
+        {
+            dma->INT |= (1UL << channel);
+        }
+        if (citer == 0U)
+        {
+            src += (intptr_t)dma->TCD[channel].SLAST;
+            dst += (intptr_t)dma->TCD[channel].DLASTSGA;
+            citer = biter;
+            dma->TCD[channel].CSR |= DMA_TCD_CSR_DONE_MASK;
+            if ((dma->TCD[channel].CSR & DMA_TCD_CSR_INTMAJOR_MASK) != 0U)
+            {
+                dma->INT |= (1UL << channel);
+            }
+            if ((dma->TCD[channel].CSR & DMA_TCD_CSR_DREQ_MASK) != 0U)
+            {
+                dma->ERQ &= ~(1UL << channel);
+            }
+        }
+        dma->TCD[channel].SADDR = src;
+        dma->TCD[channel].DADDR = dst;
+        dma->TCD[channel].CITER.ELINKNO = citer;
+    }
+}
+
+static uint32_t FlexCAN_Model_NominalBitTicks(const CAN_Type *base)
+{
+    uint32_t ticks;
+    uint32_t cbt = base->CBT;
+    uint32_t ctrl1 = base->CTRL1;
+
+    if ((cbt & CAN_CBT_BTF_MASK) != 0U)
+    {
+        ticks = (((cbt & CAN_CBT_EPRESDIV_MASK) >> CAN_CBT_EPRESDIV_SHIFT) + 1U) *
+                (1U + ((cbt & CAN_CBT_EPROPSEG_MASK) >> CAN_CBT_EPROPSEG_SHIFT) + 1U +
+                 ((cbt & CAN_CBT_EPSEG1_MASK) >> CAN_CBT_EPSEG1_SHIFT) + 1U +
+                 ((cbt & CAN_CBT_EPSEG2_MASK) >> CAN_CBT_EPSEG2_SHIFT) + 1U);
+    }
+    else
+    {
+        ticks = (((ctrl1 & CAN_CTRL1_PRESDIV_MASK) >> CAN_CTRL1_PRESDIV_SHIFT) + 1U) *
+                (1U + ((ctrl1 & CAN_CTRL1_PROPSEG_MASK) >> CAN_CTRL1_PROPSEG_SHIFT) + 1U +
+                 ((ctrl1 & CAN_CTRL1_PSEG1_MASK) >> CAN_CTRL1_PSEG1_SHIFT) + 1U +
+                 ((ctrl1 & CAN_CTRL1_PSEG2_MASK) >> CAN_CTRL1_PSEG2_SHIFT) + 1U);
+    }
+
+    return ticks;
+}
+
+static uint32_t FlexCAN_Model_DataBitTicks(const CAN_Type *base)
+{
+    uint32_t fdcbt = base->FDCBT;
+
+    return (((fdcbt & CAN_FDCBT_FPRESDIV_MASK) >> CAN_FDCBT_FPRESDIV_SHIFT) + 1U) *
+           (1U + ((fdcbt & CAN_FDCBT_FPROPSEG_MASK) >> CAN_FDCBT_FPROPSEG_SHIFT) +
+            ((fdcbt & CAN_FDCBT_FPSEG1_MASK) >> CAN_FDCBT_FPSEG1_SHIFT) + 1U +
+            ((fdcbt & CAN_FDCBT_FPSEG2_MASK) >> CAN_FDCBT_FPSEG2_SHIFT) + 1U);
+}
+
+/* Nominal frame length without stuff bits */
+static uint64_t FlexCAN_Model_FrameNs(const CAN_Type *base, const FlexCAN_Model_Frame_t *frame)
+{
+    uint64_t nominalBits;
+    uint64_t dataBits = 0U;
+    uint64_t ticks;
+    uint32_t payload = (frame->rtr != 0U) ? 0U : frame->length;
+
+    if (frame->edl != 0U)
+    {
+        /* Arbitration field up to BRS, then ESI, DLC, data, stuff count and CRC, then tail */
+        nominalBits = ((frame->ide != 0U) ? 36U : 17U) + 13U;
+        dataBits = 1U + 4U + 8U * payload + 4U + ((payload <= 16U) ? 17U : 21U);
+        if (frame->brs == 0U)
+        {
+            nominalBits += dataBits;
+            dataBits = 0U;
+        }
+    }
+    else
+    {
+        nominalBits = ((frame->ide != 0U) ? 67U : 47U) + 8U * payload;
+    }
+    ticks = nominalBits * FlexCAN_Model_NominalBitTicks(base) + dataBits * FlexCAN_Model_DataBitTicks(base);
+
+    return (ticks * FLEXCAN_MODEL_NS_PER_SECOND + s_peClockHz - 1U) / s_peClockHz;
+}
+
+/* TIMER increments once per nominal bit time */
+static uint16_t FlexCAN_Model_TimerValue(uint32_t instance)
+{
+    const CAN_Type *base = &g_flexcanModelCanPage[instance].regs;
+    unsigned __int128 bits;
+
+    bits = ((unsigned __int128)s_nowNs * s_peClockHz) /
+           ((unsigned __int128)FLEXCAN_MODEL_NS_PER_SECOND * FlexCAN_Model_NominalBitTicks(base));
+
+    return (uint16_t)((uint32_t)bits + s_modelIns[instance].timerOffset);
+}
+
+static uint8_t FlexCAN_Model_LengthToDlc(uint8_t length)
+{
+    uint8_t dlc = 0U;
+
+    while ((dlc < 15U) && (s_dlcToLength[dlc] < length))
+    {
+        dlc++;
+    }
+
+    return dlc;
+}
+
+static void FlexCAN_Model_ReadMailbox(const CAN_Type *base, uint32_t mb, FlexCAN_Model_Frame_t *frame)
+{
+    uint32_t word = mb * (FlexCAN_Model_MbBytes(base) / 4U);
+    uint32_t cs = base->RAMn[word];
+    uint32_t index;
+
+    frame->id = base->RAMn[word + 1U] & MB_ID_MASK;
+    frame->ide = (uint8_t)((cs >> MB_CS_IDE_SHIFT) & 1U);
+    frame->rtr = (uint8_t)((cs >> MB_CS_RTR_SHIFT) & 1U);
+    frame->edl = (uint8_t)((cs >> MB_CS_EDL_SHIFT) & 1U);
+    frame->brs = (uint8_t)((cs >> MB_CS_BRS_SHIFT) & 1U);
+    frame->esi = (uint8_t)((cs >> MB_CS_ESI_SHIFT) & 1U);
+    frame->length = s_dlcToLength[(cs & MB_CS_DLC_MASK) >> MB_CS_DLC_SHIFT];
+    if ((frame->edl == 0U) && (frame->length > 8U))
+    {
+        frame->length = 8U;
+    }
+    if (frame->length > (FlexCAN_Model_MbBytes(base) - 8U))
+    {
+        frame->length = (uint8_t)(FlexCAN_Model_MbBytes(base) - 8U);
+    }
+    for (index = 0U; index < frame->length; index++)
+    {
+        frame->data[index] = (uint8_t)(base->RAMn[word + 2U + index / 4U] >> (24U - 8U * (index % 4U)));
+    }
+    frame->timeNs = s_nowNs;
+}
+
+static void FlexCAN_Model_MoveIn(uint32_t instance, const FlexCAN_Model_Frame_t *frame)
+{
+    CAN_Type *base = &g_flexcanModelCanPage[instance].regs;
+    FlexCAN_Model_Instance_t *ctx = &s_modelIns[instance];
+    uint32_t wordsPerMb = FlexCAN_Model_MbBytes(base) / 4U;
+    uint32_t count = FlexCAN_Model_MbCount(base);
+    uint32_t irmq = base->MCR & CAN_MCR_IRMQ_MASK;
+    int32_t freeMb = -1;
+    int32_t lastMatch = -1;
+    int32_t target;
+    uint32_t mb;
+    uint32_t cs;
+    uint32_t code;
+    uint32_t mask;
+    uint32_t index;
+    uint32_t word;
+    uint32_t payloadWords;
+    uint32_t slot;
+    uint16_t idHit = 0U;
+
+    if ((frame->edl != 0U) && ((base->MCR & CAN_MCR_FDEN_MASK) == 0U))
+    {
+        /* FD frame seen by a classic controller -> protocol error, nothing stored */
+        ctx->stats.rxDropped++;
+        return;
+    }
+    /* MRP = 0: the Rx FIFO is matched before the mailboxes */
+    if ((FlexCAN_Model_FirstMb(base) != 0U) && FlexCAN_Model_FifoMatch(base, frame, &idHit))
+    {
+        if (ctx->fifoCount == FLEXCAN_MODEL_FIFO_DEPTH)
+        {
+            base->IFLAG1 |= FIFO_FLAG_OVERFLOW;
+            ctx->stats.rxOverrun++;
+            return;
+        }
+        slot = (ctx->fifoHead + ctx->fifoCount) % FLEXCAN_MODEL_FIFO_DEPTH;
+        ctx->fifo[slot] = *frame;
+        ctx->fifoHit[slot] = idHit;
+        ctx->fifoStamp[slot] = FlexCAN_Model_TimerValue(instance);
+        ctx->fifoCount++;
+        if (ctx->fifoCount == FLEXCAN_MODEL_FIFO_WARNING)
+        {
+            base->IFLAG1 |= FIFO_FLAG_WARNING;
+        }
+        if (ctx->fifoCount == 1U)
+        {
+            FlexCAN_Model_FifoLoadOutput(instance);
+        }
+        ctx->stats.rxFrames++;
+        return;
+    }
+    for (mb = FlexCAN_Model_FirstMb(base); mb < count; mb++)
+    {
+        cs = base->RAMn[mb * wordsPerMb];
+        code = (cs & MB_CS_CODE_MASK) >> MB_CS_CODE_SHIFT;
+        if ((code != MB_CODE_RX_EMPTY) && (code != MB_CODE_RX_FULL) && (code != MB_CODE_RX_OVERRUN))
+        {
+            continue;
+        }
+        if (((cs >> MB_CS_IDE_SHIFT) & 1U) != frame->ide)
+        {
+            continue;
+        }
+        if (irmq != 0U)
+        {
+            mask = base->RXIMR[mb];
+        }
+        else if (mb == 14U)
+        {
+            mask = base->RX14MASK;
+        }
+        else if (mb == 15U)
+        {
+            mask = base->RX15MASK;
+        }
+        else
+        {
+            mask = base->RXMGMASK;
+        }
+        if (((base->RAMn[mb * wordsPerMb + 1U] ^ frame->id) & mask & MB_ID_MASK) != 0U)
+        {
+            continue;
+        }
+        if (code == MB_CODE_RX_EMPTY)
+        {
+            freeMb = (int32_t)mb;
+            break;
+        }
+        lastMatch = (int32_t)mb;
+    }
+    target = (freeMb >= 0) ? freeMb : lastMatch;
+    if (target < 0)
+    {
+        ctx->stats.rxDropped++;
+        return;
+    }
+    code = (freeMb >= 0) ? MB_CODE_RX_FULL : MB_CODE_RX_OVERRUN;
+    if (code == MB_CODE_RX_OVERRUN)
+    {
+        ctx->stats.rxOverrun++;
+    }
+    word = (uint32_t)target * wordsPerMb;
+    payloadWords = wordsPerMb - 2U;
+    for (index = 0U; index < payloadWords; index++)
+    {
+        base->RAMn[word + 2U + index] = 0U;
+    }
+    for (index = 0U; (index < frame->length) && (index < payloadWords * 4U); index++)
+    {
+        base->RAMn[word + 2U + index / 4U] |= (uint32_t)frame->data[index] << (24U - 8U * (index % 4U));
+    }
+    base->RAMn[word + 1U] = frame->id & MB_ID_MASK;
+    base->RAMn[word] = (code << MB_CS_CODE_SHIFT) |
+                       ((uint32_t)frame->edl << MB_CS_EDL_SHIFT) |
+                       ((uint32_t)frame->brs << MB_CS_BRS_SHIFT) |
+                       ((uint32_t)frame->esi << MB_CS_ESI_SHIFT) |
+                       ((uint32_t)frame->ide << MB_CS_SRR_SHIFT) |
+                       ((uint32_t)frame->ide << MB_CS_IDE_SHIFT) |
+                       ((uint32_t)frame->rtr << MB_CS_RTR_SHIFT) |
+                       ((uint32_t)FlexCAN_Model_LengthToDlc(frame->length) << MB_CS_DLC_SHIFT) |
+                       FlexCAN_Model_TimerValue(instance);
+    base->IFLAG1 |= (1UL << (uint32_t)target);
+    ctx->stats.rxFrames++;
+}
+
+static void FlexCAN_Model_FinishFrame(uint32_t instance)
+{
+    CAN_Type *base = &g_flexcanModelCanPage[instance].regs;
+    FlexCAN_Model_Instance_t *ctx = &s_modelIns[instance];
+    uint32_t word;
+
+    ctx->busy = false;
+    ctx->busIdleNs = ctx->busEndNs;
+    if (ctx->busIsTx)
+    {
+        ctx->busFrame.timeNs = ctx->busEndNs;
+        if (!ctx->txAbandoned)
+        {
+            word = ctx->txMb * (FlexCAN_Model_MbBytes(base) / 4U);
+            base->RAMn[word] = (base->RAMn[word] & ~(MB_CS_CODE_MASK | MB_CS_TIMESTAMP_MASK)) |
+                               (MB_CODE_TX_INACTIVE << MB_CS_CODE_SHIFT) |
+                               FlexCAN_Model_TimerValue(instance);
+            base->IFLAG1 |= (1UL << ctx->txMb);
+        }
+        ctx->stats.txFrames++;
+        if (ctx->listener != NULL)
+        {
+            ctx->listener(instance, &ctx->busFrame);
+        }
+        if ((base->MCR & CAN_MCR_SRXDIS_MASK) == 0U)
+        {
+            FlexCAN_Model_MoveIn(instance, &ctx->busFrame);
+        }
+    }
+    else
+    {
+        FlexCAN_Model_MoveIn(instance, &ctx->busFrame);
+    }
+}
+
+/* Completes frames whose end time has passed and arbitrates the next one:
+ * local mailboxes by lowest ID (or lowest buffer with CTRL1[LBUF]) against the
+ * next injected frame, lower ID wins */
+static void FlexCAN_Model_RunInstance(uint32_t instance)
+{
+    CAN_Type *base = &g_flexcanModelCanPage[instance].regs;
+    FlexCAN_Model_Instance_t *ctx = &s_modelIns[instance];
+    uint32_t wordsPerMb;
+    uint32_t count;
+    uint32_t mb;
+    uint32_t cs;
+    int32_t localMb;
+    uint64_t readyNs;
+    uint64_t startNs;
+    uint32_t localId = 0U;
+    const FlexCAN_Model_Frame_t *remote;
+
+    while (true)
+    {
+        if (ctx->busy)
+        {
+            if (ctx->busEndNs > s_nowNs)
+            {
+                break;
+            }
+            FlexCAN_Model_FinishFrame(instance);
+        }
+        if (!FlexCAN_Model_IsActive(base))
+        {
+            break;
+        }
+        wordsPerMb = FlexCAN_Model_MbBytes(base) / 4U;
+        count = FlexCAN_Model_MbCount(base);
+        remote = (ctx->rxCount != 0U) ? &ctx->rxQueue[ctx->rxHead] : NULL;
+        /* Earliest moment something is ready to go */
+        readyNs = UINT64_MAX;
+        for (mb = FlexCAN_Model_FirstMb(base); mb < count; mb++)
+        {
+            cs = base->RAMn[mb * wordsPerMb];
+            if ((((cs & MB_CS_CODE_MASK) >> MB_CS_CODE_SHIFT) == MB_CODE_TX_DATA) && (ctx->txReadyNs[mb] < readyNs))
+            {
+                readyNs = ctx->txReadyNs[mb];
+            }
+        }
+        if ((remote != NULL) && (remote->timeNs < readyNs))
+        {
+            readyNs = remote->timeNs;
+        }
+        if (readyNs == UINT64_MAX)
+        {
+            break;
+        }
+        startNs = (ctx->busIdleNs > readyNs) ? ctx->busIdleNs : readyNs;
+        if (startNs > s_nowNs)
+        {
+            break;
+        }
+        /* Arbitration among everything ready at startNs */
+        localMb = -1;
+        for (mb = FlexCAN_Model_FirstMb(base); mb < count; mb++)
+        {
+            cs = base->RAMn[mb * wordsPerMb];
+            if ((((cs & MB_CS_CODE_MASK) >> MB_CS_CODE_SHIFT) != MB_CODE_TX_DATA) || (ctx->txReadyNs[mb] > startNs))
+            {
+                continue;
+            }
+            if (localMb < 0)
+            {
+                localMb = (int32_t)mb;
+                localId = base->RAMn[mb * wordsPerMb + 1U] & MB_ID_MASK;
+                if ((base->CTRL1 & CAN_CTRL1_LBUF_MASK) != 0U)
+                {
+                    break;
+                }
+            }
+            else if ((base->RAMn[mb * wordsPerMb + 1U] & MB_ID_MASK) < localId)
+            {
+                localMb = (int32_t)mb;
+                localId = base->RAMn[mb * wordsPerMb + 1U] & MB_ID_MASK;
+            }
+        }
+        if ((remote != NULL) && (remote->timeNs <= startNs) && ((localMb < 0) || (remote->id < localId)))
+        {
+            ctx->busIsTx = false;
+            ctx->busFrame = *remote;
+            ctx->rxHead = (ctx->rxHead + 1U) % FLEXCAN_MODEL_RX_QUEUE_SIZE;
+            ctx->rxCount--;
+        }
+        else
+        {
+            ctx->busIsTx = true;
+            ctx->txAbandoned = false;
+            ctx->txMb = (uint8_t)localMb;
+            FlexCAN_Model_ReadMailbox(base, (uint32_t)localMb, &ctx->busFrame);
+        }
+        ctx->busy = true;
+        ctx->busEndNs = startNs + FlexCAN_Model_FrameNs(base, &ctx->busFrame);
+        ctx->stats.busBusyNs += ctx->busEndNs - startNs;
+    }
+}
+
+static void FlexCAN_Model_RunAll(void)
+{
+    uint32_t instance;
+
+    for (instance = 0U; instance < CAN_INSTANCE_COUNT; instance++)
+    {
+        FlexCAN_Model_RunInstance(instance);
+        FlexCAN_Model_RunDma(instance);
+    }
+}
+
+static uint64_t FlexCAN_Model_NextEventNs(void)
+{
+    const CAN_Type *base;
+    const FlexCAN_Model_Instance_t *ctx;
+    uint64_t nextNs = UINT64_MAX;
+    uint64_t readyNs;
+    uint32_t instance;
+    uint32_t wordsPerMb;
+    uint32_t count;
+    uint32_t mb;
+
+    for (instance = 0U; instance < CAN_INSTANCE_COUNT; instance++)
+    {
+        base = &g_flexcanModelCanPage[instance].regs;
+        ctx = &s_modelIns[instance];
+        if (ctx->busy)
+        {
+            readyNs = ctx->busEndNs;
+        }
+        else if (FlexCAN_Model_IsActive(base))
+        {
+            readyNs = (ctx->rxCount != 0U) ? ctx->rxQueue[ctx->rxHead].timeNs : UINT64_MAX;
+            wordsPerMb = FlexCAN_Model_MbBytes(base) / 4U;
+            count = FlexCAN_Model_MbCount(base);
+            for (mb = FlexCAN_Model_FirstMb(base); mb < count; mb++)
+            {
+                if ((((base->RAMn[mb * wordsPerMb] & MB_CS_CODE_MASK) >> MB_CS_CODE_SHIFT) == MB_CODE_TX_DATA) &&
+                    (ctx->txReadyNs[mb] < readyNs))
+                {
+                    readyNs = ctx->txReadyNs[mb];
+                }
+            }
+            if ((readyNs != UINT64_MAX) && (ctx->busIdleNs > readyNs))
+            {
+                readyNs = ctx->busIdleNs;
+            }
+        }
+        else
+        {
+            readyNs = UINT64_MAX;
+        }
+        if (readyNs < nextNs)
+        {
+            nextNs = readyNs;
+        }
+    }
+
+    return nextNs;
+}
+
+/* Interrupts are taken from the harness context (Advance/RunUntilIdle), never
+ * from inside a trapped register access */
+static void FlexCAN_Model_DispatchIrqs(void)
+{
+    CAN_Type *base;
+    uint32_t instance;
+    uint32_t guard;
+    uint32_t pending;
+    uint32_t irq;
+    uint32_t channel;
+    uint32_t source;
+    bool serviced = true;
+
+    if (s_inIrq)
+    {
+        return;
+    }
+    for (guard = 0U; (guard < FLEXCAN_MODEL_IRQ_GUARD) && serviced; guard++)
+    {
+        serviced = false;
+        for (instance = 0U; instance < CAN_INSTANCE_COUNT; instance++)
+        {
+            base = &g_flexcanModelCanPage[instance].regs;
+            pending = base->IFLAG1 & base->IMASK1;
+            irq = (uint32_t)s_mbLowIrqNumber[instance];
+            if (((pending & 0x0000FFFFU) != 0U) && (s_mbLowIrqHandler[instance] != NULL) &&
+                ((s_nvicEnabled[irq / 32U] >> (irq % 32U)) & 1U))
+            {
+                s_inIrq = true;
+                s_modelIns[instance].stats.irqEntries++;
+                FlexCAN_Model_Protect();
+                s_mbLowIrqHandler[instance]();
+                FlexCAN_Model_Unprotect();
+                s_inIrq = false;
+                serviced = true;
+            }
+            pending = base->IFLAG1 & base->IMASK1;
+            irq = (uint32_t)s_mbHighIrqNumber[instance];
+            if (((pending & 0xFFFF0000U) != 0U) && (s_mbHighIrqHandler[instance] != NULL) &&
+                ((s_nvicEnabled[irq / 32U] >> (irq % 32U)) & 1U))
+            {
+                s_inIrq = true;
+                s_modelIns[instance].stats.irqEntries++;
+                FlexCAN_Model_Protect();
+                s_mbHighIrqHandler[instance]();
+                FlexCAN_Model_Unprotect();
+                s_inIrq = false;
+                serviced = true;
+            }
+        }
+        for (channel = 0U; channel < DMA_CHANNEL_COUNT; channel++)
+        {
+            if ((((g_flexcanModelDmaPage.regs.INT >> channel) & 1U) != 0U) && (s_dmaIrqHandler[channel] != NULL) &&
+                ((s_nvicEnabled[channel / 32U] >> (channel % 32U)) & 1U))
+            {
+                /* Counted against the FlexCAN instance the channel serves */
+                source = (uint32_t)(g_flexcanModelDmamux.CHCFG[channel] & DMAMUX_CHCFG_SOURCE_MASK);
+                if ((source >= FLEXCAN_MODEL_DMA_SOURCE_CAN0) && (source < FLEXCAN_MODEL_DMA_SOURCE_CAN0 + CAN_INSTANCE_COUNT))
+                {
+                    s_modelIns[source - FLEXCAN_MODEL_DMA_SOURCE_CAN0].stats.irqEntries++;
+                }
+                s_inIrq = true;
+                FlexCAN_Model_Protect();
+                s_dmaIrqHandler[channel]();
+                FlexCAN_Model_Unprotect();
+                s_inIrq = false;
+                serviced = true;
+            }
+        }
+    }
+}
+
+static void FlexCAN_Model_CanRead(uint32_t instance, uint32_t offset)
+{
+    CAN_Type *base = &g_flexcanModelCanPage[instance].regs;
+    const FlexCAN_Model_Instance_t *ctx = &s_modelIns[instance];
+    uint32_t status;
+
+    if (offset == CAN_REG_OFFSET(TIMER))
+    {
+        base->TIMER = FlexCAN_Model_TimerValue(instance);
+    }
+    else if (offset == CAN_REG_OFFSET(ESR1))
+    {
+        status = 0U;
+        if (FlexCAN_Model_IsActive(base))
+        {
+            status |= CAN_ESR1_SYNCH_MASK;
+            status |= ctx->busy ? (ctx->busIsTx ? CAN_ESR1_TX_MASK : CAN_ESR1_RX_MASK) : CAN_ESR1_IDLE_MASK;
+        }
+        base->ESR1 = (base->ESR1 & ~(CAN_ESR1_SYNCH_MASK | CAN_ESR1_TX_MASK | CAN_ESR1_RX_MASK | CAN_ESR1_IDLE_MASK)) | status;
+    }
+}
+
+static void FlexCAN_Model_CanWrite(uint32_t instance, uint32_t offset, uint32_t before, uint32_t after)
+{
+    CAN_Type *base = &g_flexcanModelCanPage[instance].regs;
+    FlexCAN_Model_Instance_t *ctx = &s_modelIns[instance];
+    bool wasActive;
+    uint32_t mcr;
+
+    if (offset == CAN_REG_OFFSET(MCR))
+    {
+        wasActive = (before & CAN_MCR_NOTRDY_MASK) == 0U;
+        if ((after & CAN_MCR_SOFTRST_MASK) != 0U)
+        {
+            FlexCAN_Model_ResetInstance(instance);
+            after = base->MCR;
+        }
+        mcr = after & ~CAN_MCR_STATUS_BITS;
+        if ((mcr & CAN_MCR_MDIS_MASK) != 0U)
+        {
+            mcr |= CAN_MCR_LPMACK_MASK | CAN_MCR_NOTRDY_MASK;
+        }
+        else if (((mcr & CAN_MCR_FRZ_MASK) != 0U) && ((mcr & CAN_MCR_HALT_MASK) != 0U))
+        {
+            mcr |= CAN_MCR_FRZACK_MASK | CAN_MCR_NOTRDY_MASK;
+        }
+        base->MCR = mcr;
+        if (!wasActive && FlexCAN_Model_IsActive(base) && (ctx->busIdleNs < s_nowNs))
+        {
+            ctx->busIdleNs = s_nowNs;
+        }
+    }
+    else if (offset == CAN_REG_OFFSET(IFLAG1))
+    {
+        base->IFLAG1 = before & ~after;
+        /* Acknowledging "frames available" pops the FIFO output */
+        if ((FlexCAN_Model_FirstMb(base) != 0U) && ((before & after & FIFO_FLAG_AVAILABLE) != 0U))
+        {
+            FlexCAN_Model_FifoPop(instance);
+        }
+    }
+    else if (offset == CAN_REG_OFFSET(ESR1))
+    {
+        base->ESR1 = before & ~(after & CAN_ESR1_W1C_BITS);
+    }
+    else if (offset == CAN_REG_OFFSET(TIMER))
+    {
+        base->TIMER = before;
+        ctx->timerOffset += (after & CAN_TIMER_TIMER_MASK) - FlexCAN_Model_TimerValue(instance);
+        base->TIMER = after & CAN_TIMER_TIMER_MASK;
+    }
+    else if ((offset == CAN_REG_OFFSET(ESR2)) || (offset == CAN_REG_OFFSET(CRCR)) ||
+             (offset == CAN_REG_OFFSET(RXFIR)) || (offset == CAN_REG_OFFSET(FDCRC)))
+    {
+        *(volatile uint32_t *)((uint8_t *)base + offset) = before;
+    }
+    else if ((offset >= CAN_REG_OFFSET(RAMn)) && (offset < CAN_REG_OFFSET(RAMn) + sizeof(base->RAMn)))
+    {
+        FlexCAN_Model_RamWrite(instance, (offset - CAN_REG_OFFSET(RAMn)) / 4U, before, after);
+    }
+    else if ((offset == CAN_REG_OFFSET(CTRL1)) || (offset == CAN_REG_OFFSET(CTRL2)) ||
+             (offset == CAN_REG_OFFSET(RXMGMASK)) || (offset == CAN_REG_OFFSET(RX14MASK)) ||
+             (offset == CAN_REG_OFFSET(RX15MASK)) || (offset == CAN_REG_OFFSET(RXFGMASK)) ||
+             (offset == CAN_REG_OFFSET(ECR)) || (offset == CAN_REG_OFFSET(CBT)) ||
+             (offset == CAN_REG_OFFSET(FDCTRL)) || (offset == CAN_REG_OFFSET(FDCBT)) ||
+             ((offset >= CAN_REG_OFFSET(RXIMR)) && (offset < CAN_REG_OFFSET(RXIMR) + sizeof(base->RXIMR))))
+    {
+        /* Configuration registers only accept writes in freeze or disable mode */
+        if (!FlexCAN_Model_IsConfigurable(base))
+        {
+            *(volatile uint32_t *)((uint8_t *)base + offset) = before;
+        }
+    }
+}
+
+static void FlexCAN_Model_RamWrite(uint32_t instance, uint32_t word, uint32_t before, uint32_t after)
+{
+    CAN_Type *base = &g_flexcanModelCanPage[instance].regs;
+    FlexCAN_Model_Instance_t *ctx = &s_modelIns[instance];
+    uint32_t wordsPerMb = FlexCAN_Model_MbBytes(base) / 4U;
+    uint32_t mb = word / wordsPerMb;
+    uint32_t codeBefore = (before & MB_CS_CODE_MASK) >> MB_CS_CODE_SHIFT;
+    uint32_t codeAfter = (after & MB_CS_CODE_MASK) >> MB_CS_CODE_SHIFT;
+    bool abortEnabled = (base->MCR & CAN_MCR_AEN_MASK) != 0U;
+
+    if (((word % wordsPerMb) != 0U) || (mb >= FlexCAN_Model_MbCount(base)) || (mb < FlexCAN_Model_FirstMb(base)))
+    {
+        return;
+    }
+    if (ctx->busy && ctx->busIsTx && (ctx->txMb == mb))
+    {
+        if (abortEnabled && (codeAfter == MB_CODE_TX_ABORT))
+        {
+            /* Too late to abort: the frame completes and reports as transmitted */
+            base->RAMn[word] = before;
+        }
+        else
+        {
+            /* Inactivation while on the bus: the frame still goes out unreported */
+            ctx->txAbandoned = true;
+        }
+    }
+    else if ((codeBefore == MB_CODE_TX_DATA) && (codeAfter == MB_CODE_TX_ABORT) && abortEnabled)
+    {
+        base->RAMn[word] = (before & ~MB_CS_CODE_MASK) | (MB_CODE_TX_ABORT << MB_CS_CODE_SHIFT);
+        base->IFLAG1 |= (1UL << mb);
+    }
+    else if ((codeAfter == MB_CODE_TX_DATA) && (codeBefore != MB_CODE_TX_DATA))
+    {
+        ctx->txReadyNs[mb] = s_nowNs;
+    }
+}
+
+static void FlexCAN_Model_DmaWrite(uint32_t offset, uint32_t before, uint32_t after)
+{
+    DMA_Type *dma = &g_flexcanModelDmaPage.regs;
+
+    if (offset == (uint32_t)offsetof(DMA_Type, INT))
+    {
+        dma->INT = before & ~after;
+    }
+    else if (offset == (uint32_t)offsetof(DMA_Type, ERR))
+    {
+        dma->ERR = before & ~after;
+    }
+}
+
+static void FlexCAN_Model_NvicWrite(uint32_t offset, uint32_t after)
+{
+    S32_NVIC_Type *nvic = &g_flexcanModelNvicPage.regs;
+    uint32_t index;
+
+    if (offset < offsetof(S32_NVIC_Type, RESERVED_0))
+    {
+        index = offset / 4U;
+        s_nvicEnabled[index] |= after;
+    }
+    else if ((offset >= offsetof(S32_NVIC_Type, ICER)) && (offset < offsetof(S32_NVIC_Type, RESERVED_1)))
+    {
+        index = (offset - offsetof(S32_NVIC_Type, ICER)) / 4U;
+        s_nvicEnabled[index] &= ~after;
+    }
+    else
+    {
+        return;
+    }
+    nvic->ISER[index] = s_nvicEnabled[index];
+    nvic->ICER[index] = s_nvicEnabled[index];
+}
+
+/* Access trap, phase 1: the faulting instruction has not executed yet. Time
+ * advances by one access, read side effects are applied, then the page is
+ * opened for exactly one instruction */
+static void FlexCAN_Model_SegvHandler(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+    uintptr_t pageBase;
+    uint32_t page;
+
+    (void)sig;
+    for (page = 0U; page < FLEXCAN_MODEL_PAGE_COUNT; page++)
+    {
+        pageBase = (uintptr_t)FlexCAN_Model_PageBase(page);
+        if ((addr >= pageBase) && (addr < pageBase + FLEXCAN_MODEL_PAGE_SIZE))
+        {
+            break;
+        }
+    }
+    if ((page == FLEXCAN_MODEL_PAGE_COUNT) || s_trap.active)
+    {
+        /* Not ours: fall back so the fault is reported normally */
+        (void)sigaction(SIGSEGV, &s_oldSegvAction, NULL);
+        return;
+    }
+    FlexCAN_Model_Unprotect();
+    s_trap.active = true;
+    s_trap.page = page;
+    s_trap.offset = (uint32_t)(addr - pageBase) & ~3U;
+    s_trap.isWrite = (uc->uc_mcontext.gregs[REG_ERR] & X86_PF_WRITE) != 0;
+    s_nowNs += s_accessCostNs;
+    FlexCAN_Model_RunAll();
+    if (page < CAN_INSTANCE_COUNT)
+    {
+        if (s_trap.isWrite)
+        {
+            s_modelIns[page].stats.regWrites++;
+        }
+        else
+        {
+            s_modelIns[page].stats.regReads++;
+            FlexCAN_Model_CanRead(page, s_trap.offset);
+        }
+    }
+    s_trap.before = *(volatile uint32_t *)(pageBase + s_trap.offset);
+    uc->uc_mcontext.gregs[REG_EFL] |= X86_EFLAGS_TF;
+}
+
+/* Access trap, phase 2: the instruction has executed. Write side effects are
+ * applied and the page is closed again */
+static void FlexCAN_Model_TrapHandler(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+    uintptr_t pageBase;
+    uint32_t after;
+
+    if (!s_trap.active)
+    {
+        if ((s_oldTrapAction.sa_flags & SA_SIGINFO) != 0)
+        {
+            s_oldTrapAction.sa_sigaction(sig, info, context);
+        }
+        else if ((s_oldTrapAction.sa_handler != SIG_DFL) && (s_oldTrapAction.sa_handler != SIG_IGN))
+        {
+            s_oldTrapAction.sa_handler(sig);
+        }
+        return;
+    }
+    uc->uc_mcontext.gregs[REG_EFL] &= ~(greg_t)X86_EFLAGS_TF;
+    if (s_trap.isWrite)
+    {
+        pageBase = (uintptr_t)FlexCAN_Model_PageBase(s_trap.page);
+        after = *(volatile uint32_t *)(pageBase + s_trap.offset);
+        if (s_trap.page == FLEXCAN_MODEL_NVIC_PAGE)
+        {
+            FlexCAN_Model_NvicWrite(s_trap.offset, after);
+        }
+        else if (s_trap.page == FLEXCAN_MODEL_DMA_PAGE)
+        {
+            FlexCAN_Model_DmaWrite(s_trap.offset, s_trap.before, after);
+        }
+        else
+        {
+            FlexCAN_Model_CanWrite(s_trap.page, s_trap.offset, s_trap.before, after);
+        }
+    }
+    s_trap.active = false;
+    FlexCAN_Model_Protect();
+}
+
+void FlexCAN_Model_Init(void)
+{
+    struct sigaction action;
+    uint32_t instance;
+
+    FlexCAN_Model_Unprotect();
+    memset((void *)&g_flexcanModelNvicPage, 0, sizeof(g_flexcanModelNvicPage));
+    memset((void *)&g_flexcanModelDmaPage, 0, sizeof(g_flexcanModelDmaPage));
+    memset((void *)&g_flexcanModelDmamux, 0, sizeof(g_flexcanModelDmamux));
+    memset((void *)&g_flexcanModelPcc, 0, sizeof(g_flexcanModelPcc));
+    memset((void *)g_flexcanModelPort, 0, sizeof(g_flexcanModelPort));
+    memset(s_nvicEnabled, 0, sizeof(s_nvicEnabled));
+    memset(&s_trap, 0, sizeof(s_trap));
+    for (instance = 0U; instance < CAN_INSTANCE_COUNT; instance++)
+    {
+        s_modelIns[instance].listener = NULL;
+        FlexCAN_Model_ResetInstance(instance);
+    }
+    s_nowNs = 0U;
+    s_inIrq = false;
+    if (!s_installed)
+    {
+        memset(&action, 0, sizeof(action));
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        action.sa_sigaction = FlexCAN_Model_SegvHandler;
+        (void)sigaction(SIGSEGV, &action, &s_oldSegvAction);
+        action.sa_sigaction = FlexCAN_Model_TrapHandler;
+        (void)sigaction(SIGTRAP, &action, &s_oldTrapAction);
+        s_installed = true;
+    }
+    FlexCAN_Model_Protect();
+}
+
+void FlexCAN_Model_Deinit(void)
+{
+    if (s_installed)
+    {
+        FlexCAN_Model_Unprotect();
+        (void)sigaction(SIGSEGV, &s_oldSegvAction, NULL);
+        (void)sigaction(SIGTRAP, &s_oldTrapAction, NULL);
+        s_installed = false;
+    }
+}
+
+void FlexCAN_Model_SetPeClock(uint32_t hz)
+{
+    if (hz != 0U)
+    {
+        s_peClockHz = hz;
+    }
+}
+
+void FlexCAN_Model_SetAccessCost(uint32_t ns)
+{
+    s_accessCostNs = ns;
+}
+
+uint64_t FlexCAN_Model_GetTimeNs(void)
+{
+    return s_nowNs;
+}
+
+void FlexCAN_Model_Advance(uint64_t ns)
+{
+    uint64_t targetNs;
+    uint64_t nextNs;
+
+    FlexCAN_Model_Unprotect();
+    targetNs = s_nowNs + ns;
+    FlexCAN_Model_RunAll();
+    FlexCAN_Model_DispatchIrqs();
+    while (true)
+    {
+        nextNs = FlexCAN_Model_NextEventNs();
+        if (nextNs > targetNs)
+        {
+            break;
+        }
+        if (nextNs > s_nowNs)
+        {
+            s_nowNs = nextNs;
+        }
+        FlexCAN_Model_RunAll();
+        FlexCAN_Model_DispatchIrqs();
+    }
+    if (s_nowNs < targetNs)
+    {
+        s_nowNs = targetNs;
+    }
+    FlexCAN_Model_RunAll();
+    FlexCAN_Model_DispatchIrqs();
+    FlexCAN_Model_Protect();
+}
+
+bool FlexCAN_Model_RunUntilIdle(uint64_t maxNs)
+{
+    uint64_t deadlineNs;
+    uint64_t nextNs;
+    bool idle = false;
+
+    FlexCAN_Model_Unprotect();
+    deadlineNs = s_nowNs + maxNs;
+    while (true)
+    {
+        FlexCAN_Model_RunAll();
+        FlexCAN_Model_DispatchIrqs();
+        nextNs = FlexCAN_Model_NextEventNs();
+        if (nextNs == UINT64_MAX)
+        {
+            idle = true;
+            break;
+        }
+        if (nextNs > deadlineNs)
+        {
+            break;
+        }
+        if (nextNs > s_nowNs)
+        {
+            s_nowNs = nextNs;
+        }
+    }
+    FlexCAN_Model_Protect();
+
+    return idle;
+}
+
+/* Queues a frame sent by another node; it competes for the bus from
+ * frame->timeNs on (or immediately when timeNs lies in the past) */
+bool FlexCAN_Model_InjectFrame(uint32_t instance, const FlexCAN_Model_Frame_t *frame)
+{
+    FlexCAN_Model_Instance_t *ctx;
+    bool retVal = false;
+
+    if ((instance < CAN_INSTANCE_COUNT) && (frame != NULL))
+    {
+        ctx = &s_modelIns[instance];
+        if (ctx->rxCount < FLEXCAN_MODEL_RX_QUEUE_SIZE)
+        {
+            ctx->rxQueue[(ctx->rxHead + ctx->rxCount) % FLEXCAN_MODEL_RX_QUEUE_SIZE] = *frame;
+            if (frame->timeNs < s_nowNs)
+            {
+                ctx->rxQueue[(ctx->rxHead + ctx->rxCount) % FLEXCAN_MODEL_RX_QUEUE_SIZE].timeNs = s_nowNs;
+            }
+            ctx->rxCount++;
+            retVal = true;
+        }
+    }
+
+    return retVal;
+}
+
+void FlexCAN_Model_SetTxListener(uint32_t instance, FlexCAN_Model_TxListener listener)
+{
+    if (instance < CAN_INSTANCE_COUNT)
+    {
+        s_modelIns[instance].listener = listener;
+    }
+}
+
+void FlexCAN_Model_GetStats(uint32_t instance, FlexCAN_Model_Stats_t *stats)
+{
+    if ((instance < CAN_INSTANCE_COUNT) && (stats != NULL))
+    {
+        *stats = s_modelIns[instance].stats;
+    }
+}
+
+void FlexCAN_Model_ResetStats(void)
+{
+    uint32_t instance;
+
+    for (instance = 0U; instance < CAN_INSTANCE_COUNT; instance++)
+    {
+        memset(&s_modelIns[instance].stats, 0, sizeof(FlexCAN_Model_Stats_t));
+    }
+}
+
+/* Stand-in for the DWT cycle counter: host nanoseconds, wrapping at 32 bits */
+uint32_t FlexCAN_Model_CycleCount(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+/* Force the error counters as if bus errors had happened. The fault confinement
+ * state follows them (error passive from 128, bus off when busOff is set) and
+ * BOFFINT latches on the way into bus off */
+void FlexCAN_Model_SetErrorCounters(uint32_t instance, uint8_t txErrors, uint8_t rxErrors, bool busOff)
+{
+    CAN_Type *base;
+    uint32_t fltconf = 0U;
+
+    if (instance < CAN_INSTANCE_COUNT)
+    {
+        base = &g_flexcanModelCanPage[instance].regs;
+        if (busOff)
+        {
+            fltconf = 2U;
+        }
+        else if ((txErrors >= 128U) || (rxErrors >= 128U))
+        {
+            fltconf = 1U;
+        }
+        FlexCAN_Model_Unprotect();
+        base->ECR = ((uint32_t)txErrors << CAN_ECR_TXERRCNT_SHIFT) | ((uint32_t)rxErrors << CAN_ECR_RXERRCNT_SHIFT);
+        if (busOff && (((base->ESR1 & CAN_ESR1_FLTCONF_MASK) >> CAN_ESR1_FLTCONF_SHIFT) < 2U))
+        {
+            base->ESR1 |= CAN_ESR1_BOFFINT_MASK;
+        }
+        base->ESR1 = (base->ESR1 & ~CAN_ESR1_FLTCONF_MASK) | (fltconf << CAN_ESR1_FLTCONF_SHIFT);
+        FlexCAN_Model_Protect();
+    }
+}
+/*******************************************************************************
+ * End of file
+ ******************************************************************************/
@@ -0,0 +1,152 @@
+#ifndef __CAN_HEAP_H__
+#define __CAN_HEAP_H__
+
+/*******************************************************************************
+ * Include
+ ******************************************************************************/
+#include "can_driver.h"
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Number of slots, at most 255 */
+#ifndef CAN_HEAP_SIZE
+#define CAN_HEAP_SIZE (16U)
+#endif
+#define CAN_HEAP_PRIO_SHIFT (29U)
+
+/*******************************************************************************
+ * Datatype Definiton
+ ******************************************************************************/
+/*
+ * Frame queue ordered like arbitration among the local mailboxes: the lowest
+ * ID word (PRIO in bits 31-29, then the identifier) comes first, frames with
+ * the same ID word keep their order. Frames stay in their slot, only slot
+ * indices move through the binary heap, so an insert or a removal costs
+ * log2(CAN_HEAP_SIZE) index swaps:
+ *   producer: slot = CAN_Heap_Claim()  -> fill slot -> CAN_Heap_Commit(slot)
+ *   consumer: slot = CAN_Heap_Peek()   -> use slot  -> CAN_Heap_Release()
+ * Both sides change the heap, callers running in different contexts must keep
+ * each of these calls under a common lock.
+ */
+typedef struct
+{
+    FlexCAN_TX_MessageBuffer_t slot[CAN_HEAP_SIZE];
+    uint32_t key[CAN_HEAP_SIZE];      /* ID word of each committed slot */
+    uint32_t sequence[CAN_HEAP_SIZE]; /* Commit order of each committed slot */
+    uint8_t order[CAN_HEAP_SIZE];     /* Heap of committed slot indices, order[0] goes first */
+    uint8_t unused[CAN_HEAP_SIZE];    /* Stack of free slot indices */
+    uint32_t count;                   /* Committed slots */
+    uint32_t unusedCount;
+    uint32_t nextSequence;
+} CAN_Heap_t;
+
+/*******************************************************************************
+ * APIs
+ ******************************************************************************/
+static inline void CAN_Heap_Init(CAN_Heap_t *heap)
+{
+    uint32_t index;
+
+    for (index = 0; index < CAN_HEAP_SIZE; index++)
+    {
+        heap->unused[index] = (uint8_t)(CAN_HEAP_SIZE - 1U - index);
+    }
+    heap->count = 0U;
+    heap->unusedCount = CAN_HEAP_SIZE;
+    heap->nextSequence = 0U;
+}
+
+/* Slot a goes before slot b */
+static inline bool CAN_Heap_Before(const CAN_Heap_t *heap, uint8_t a, uint8_t b)
+{
+    return (heap->key[a] < heap->key[b]) ||
+           ((heap->key[a] == heap->key[b]) && ((int32_t)(heap->sequence[a] - heap->sequence[b]) < 0));
+}
+
+/* Position of the child of position that goes first, count when it has none */
+static inline uint32_t CAN_Heap_Child(const CAN_Heap_t *heap, uint32_t position)
+{
+    uint32_t child = (2U * position) + 1U;
+
+    if (((child + 1U) < heap->count) && (CAN_Heap_Before(heap, heap->order[child + 1U], heap->order[child])))
+    {
+        child++;
+    }
+
+    return (child < heap->count) ? child : heap->count;
+}
+
+/* Free slot for the producer, NULL when the heap is full. The slot is reserved
+ * until it is committed */
+static inline FlexCAN_TX_MessageBuffer_t *CAN_Heap_Claim(CAN_Heap_t *heap)
+{
+    FlexCAN_TX_MessageBuffer_t *slot = NULL;
+
+    if (heap->unusedCount != 0U)
+    {
+        heap->unusedCount--;
+        slot = &heap->slot[heap->unused[heap->unusedCount]];
+    }
+
+    return slot;
+}
+
+/* Queue the claimed slot by its ID word */
+static inline void CAN_Heap_Commit(CAN_Heap_t *heap, FlexCAN_TX_MessageBuffer_t *slot)
+{
+    uint8_t index = (uint8_t)(slot - heap->slot);
+    uint32_t position = heap->count;
+    uint32_t parent;
+
+    heap->key[index] = ((uint32_t)slot->cfID.prio << CAN_HEAP_PRIO_SHIFT) | slot->cfID.id;
+    heap->sequence[index] = heap->nextSequence++;
+    /* Sift up */
+    while ((position != 0U) && (CAN_Heap_Before(heap, index, heap->order[(position - 1U) / 2U])))
+    {
+        parent = (position - 1U) / 2U;
+        heap->order[position] = heap->order[parent];
+        position = parent;
+    }
+    heap->order[position] = index;
+    heap->count++;
+}
+
+/* Most important frame for the consumer, NULL when the heap is empty */
+static inline FlexCAN_TX_MessageBuffer_t *CAN_Heap_Peek(CAN_Heap_t *heap)
+{
+    return (heap->count != 0U) ? &heap->slot[heap->order[0]] : NULL;
+}
+
+/* Hand the peeked slot back to the producer */
+static inline void CAN_Heap_Release(CAN_Heap_t *heap)
+{
+    uint8_t last;
+    uint32_t position = 0U;
+    uint32_t child;
+
+    heap->unused[heap->unusedCount] = heap->order[0];
+    heap->unusedCount++;
+    heap->count--;
+    last = heap->order[heap->count];
+    /* Sift down the last entry from the root, child is the earlier of the two */
+    child = CAN_Heap_Child(heap, 0U);
+    while ((child < heap->count) && (CAN_Heap_Before(heap, heap->order[child], last)))
+    {
+        heap->order[position] = heap->order[child];
+        position = child;
+        child = CAN_Heap_Child(heap, position);
+    }
+    heap->order[position] = last;
+}
+
+static inline uint32_t CAN_Heap_Count(const CAN_Heap_t *heap)
+{
+    return heap->count;
+}
+
+/*******************************************************************************
+ * End of file
+ ******************************************************************************/
+
+#endif /* __CAN_HEAP_H__ */
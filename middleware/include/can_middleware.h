@@ -6,14 +6,37 @@
  * Include
  ******************************************************************************/
 #include "can_driver.h"
-#include "queue_can.h"
+#include "can_ring.h"
 #include "types_common.h"
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define CAN_LATENCY_BUCKET_COUNT (16U)
+/* FRAME_TYPE_NONE to FRAME_TYPE_RESET_RESPONSE */
+#define CAN_FRAME_TYPE_COUNT (9U)
+/* Entries of the periodic transmit schedule */
+#define CAN_SCHEDULE_MAX (16U)
+/* FlexCAN instances the gateway routes between, CAN0 is the node bus */
+#define CAN_GATEWAY_BUS_COUNT (3U)
+/* Entries of the gateway routing table */
+#define CAN_GATEWAY_ROUTE_MAX (32U)
+/* Nodes the forwarder keeps track of */
+#ifndef CAN_NODE_MAX
+#define CAN_NODE_MAX (32U)
+#endif
+/* Reports queued per node, must be a power of two */
+#ifndef CAN_NODE_QUEUE_DEPTH
+#define CAN_NODE_QUEUE_DEPTH (4U)
+#endif
+_Static_assert((CAN_NODE_QUEUE_DEPTH & (CAN_NODE_QUEUE_DEPTH - 1U)) == 0U, "CAN_NODE_QUEUE_DEPTH must be a power of two");
+
 /*******************************************************************************
  * Datatype Definiton
  ******************************************************************************/
 
 typedef enum CAN__Middleware_FrameTypes_t
 {
+    FRAME_TYPE_NONE                      = 0U,    /* No request received */
     FRAME_TYPE_CONFIG                    = 1U,
     FRAME_TYPE_CHECK_CONNECTION          = 2U,
     FRAME_TYPE_READ_DATA                 = 3U,
@@ -24,14 +47,141 @@ typedef enum CAN__Middleware_FrameTypes_t
     FRAME_TYPE_RESET_RESPONSE            = 8U        
 } CAN_Middleware_FrameTypes_t;
 
+/* Latency histogram in nominal bit times (FlexCAN timer ticks): bucket[0] counts
+ * 0-1, bucket[k] counts 2^k to 2^(k+1) - 1, the last bucket also holds longer ones */
+typedef struct
+{
+    uint32_t bucket[CAN_LATENCY_BUCKET_COUNT];
+    uint32_t count;
+    uint64_t sum;
+    uint64_t max;
+} CAN_Middleware_Latency_t;
+
+typedef struct
+{
+    uint32_t queued;                      /* Frames put in the queue */
+    uint32_t dropped;                     /* Frames lost because the queue was full */
+    uint32_t peak;                        /* Highest fill level seen */
+} CAN_Middleware_QueueStats_t;
+
+typedef struct
+{
+    CAN_Middleware_QueueStats_t tx;       /* Application -> transmit mailboxes */
+    CAN_Middleware_QueueStats_t rx;       /* Receive interrupt -> application */
+    uint32_t txScheduleLate;              /* Periodic releases skipped because the run came too late */
+    uint32_t txCoalesced;                 /* Node frames that overwrote a pending one of their type */
+    uint32_t txRejected;                  /* Queued or routed frames the driver refused to load, dropped */
+    uint32_t uartRejected;                /* UART frame candidates with a bad length, checksum or EOF */
+    CAN_Middleware_QueueStats_t gateway;  /* Routed frames -> transmit queue of their destination bus */
+    uint32_t nodeOverflow;                /* Frames from new nodes that found the registry full */
+} CAN_Middleware_Stats_t;
+
 typedef void (*CAN_Middleware_TxCallback)(void);
 typedef void (*CAN_Middleware_RxCallback)(void);
+/* Handle one received request, return true and fill responseData (3 bytes) to
+ * have it answered. The frame is only valid during the call */
+typedef bool (*CAN_Middleware_RequestHandler)(CAN_Middleware_FrameTypes_t frameType,
+                                              const FlexCAN_TX_MessageBuffer_t *request, uint32_t *responseData);
+/* Start one UART transmit DMA transfer, completion is reported through
+ * CANMiddlewareFwd_UartTxDone */
+typedef void (*CAN_Middleware_UartTxStart)(const uint8_t *data, uint32_t length);
+
+/* Fill the payload (and dlc if not 8) of a periodic frame at its release */
+typedef void (*CAN_Middleware_PayloadProvider)(FlexCAN_TX_MessageBuffer_t *frame);
+
+/* One periodic frame. Times are FlexCAN timer ticks (nominal bit times, see
+ * FlexCAN_GetTime): first release at offset after CANMiddleware_ScheduleConfig,
+ * then every period */
+typedef struct
+{
+    uint32_t id;                          /* Mailbox ID word layout, standard IDs in bits 28-18 */
+    uint32_t period;
+    uint32_t offset;
+    CAN_Middleware_PayloadProvider provider;
+} CAN_Middleware_Schedule_t;
+
+typedef enum
+{
+    NODE_STATE_UNKNOWN = 0U,              /* No CHECK_CONNECTION response seen yet */
+    NODE_STATE_ALIVE   = 1U,              /* Last response within the node timeout */
+    NODE_STATE_LOST    = 2U               /* Last response older than the node timeout */
+} CAN_Middleware_NodeState_t;
+
+/* What one node frame carried, time is the hardware receive time */
+typedef struct
+{
+    uint64_t time;
+    uint32_t data;                        /* Bytes 4-6 */
+    uint8_t frameType;
+    uint8_t threshold;
+} CAN_Middleware_NodeReport_t;
+
+/* Registry entry of one node, keyed by node type and node ID */
+typedef struct
+{
+    uint16_t nodeID;
+    uint8_t nodeType;
+    CAN_Middleware_NodeState_t state;     /* At the time of the read */
+    uint64_t lastSeen;                    /* Receive time of the last frame */
+    uint64_t lastAlive;                   /* Receive time of the last CHECK_CONNECTION response */
+    uint32_t frames;
+    uint32_t dropped;                     /* Reports lost to a full node queue */
+    CAN_Middleware_NodeReport_t last;
+} CAN_Middleware_Node_t;
+
+/* End of a segmented transfer with the number of bytes sent or received. A
+ * transfer sent succeeds once its last frame is on the bus. False after a
+ * timeout, a sequence error, a frame too short or an overflow reported by the
+ * receiver. Called from the CAN interrupt or with it masked */
+typedef void (*CAN_Middleware_TpCallback)(bool success, uint16_t length);
+
+/* Segmented transport with one peer, ISO 15765-2 framing on 8 byte frames */
+typedef struct
+{
+    uint32_t txId;                        /* Mailbox ID word layout of the frames sent */
+    uint32_t rxId;                        /* Of the frames received, the CAN0 receive filters must accept it */
+    uint8_t blockSize;                    /* Consecutive frames per flow control asked from the sender, 0 -> all */
+    uint8_t stMin;                        /* Separation time asked from the sender, ISO 15765-2 encoding */
+    uint16_t bitTimesPerMs;               /* Nominal bit rate / 1000, converts separation times to timer ticks */
+    uint32_t timeout;                     /* Bit times to wait for the peer's next frame, 0 -> 1 s */
+    CAN_Middleware_TpCallback txDone;
+    CAN_Middleware_TpCallback rxDone;
+} CAN_Middleware_TpConfig_t;
+
+/* One gateway route: frames received on source with (ID & mask) == (id & mask)
+ * are sent on every bus of destMask, the source excluded. An exact route (mask
+ * covering all 29 ID bits) wins over masked ones, which are tried in table
+ * order. ID bits in rewriteMask are replaced by those of rewriteId on the way
+ * out */
+typedef struct
+{
+    uint8_t source;                       /* Instance the frame arrives on, 0 to 2 */
+    uint8_t destMask;                     /* Bit n set -> sent on instance n */
+    uint8_t ide;                          /* Extended identifier */
+    uint32_t id;                          /* Mailbox ID word layout, standard IDs in bits 28-18 */
+    uint32_t mask;
+    uint32_t rewriteMask;                 /* 0 -> ID kept */
+    uint32_t rewriteId;
+} CAN_Middleware_Route_t;
 
 typedef struct CAN_MiddlewareConfig_t
 {
     CAN_Middleware_TxCallback TxCallback;
     CAN_Middleware_RxCallback RxCallback;
     Node_Config_t *nodeConfigPtr;
+    uint32_t txMbMask;                    /* Mailboxes used for transmission, 0 -> default pool */
+    FlexCAN_TxArbitration_t txArbitration; /* Which loaded mailbox goes out first */
+    uint8_t wordSize;                     /* Mailbox size in words, 0 -> 4 (8 byte payload) */
+    FlexCAN_fd_bit_timing_t *fdBitTiming; /* Data phase timing, NULL -> classic CAN */
+    bool fdBrs;                           /* Switch to the data phase bit rate in FD frames */
+    const FlexCAN_RxFifo_filter_t *rxFifoFilter; /* Receive through the Rx FIFO, NULL -> MB1 */
+    uint8_t rxFifoFilterCount;
+    FlexCAN_RxFifo_dma_frame_t *rxDmaRing; /* Rx FIFO emptied by the eDMA into this ring, NULL -> by interrupt */
+    uint16_t rxDmaRingSize;               /* Frames in rxDmaRing, even */
+    const FlexCAN_RxFilter_range_t *rxFilter; /* Accepted IDs without the Rx FIFO, NULL -> nodeID, the forwarder IDs on the forwarder */
+    uint8_t rxFilterCount;
+    CAN_Middleware_UartTxStart uartTxStart; /* Batched UART egress, NULL -> CANMiddleWare_ConvertDataCanToUart only */
+    uint32_t nodeTimeout;                 /* Bit times a node stays alive after a response, 0 -> 1000000 */
 } CAN_MiddlewareConfig_t;
 
 /*******************************************************************************
@@ -39,9 +189,29 @@ typedef struct CAN_MiddlewareConfig_t
  ******************************************************************************/
 void CANMiddleWare_ConvertDataCanToUart(uint8_t **data);
 void CANMiddlewareFwd_TransmitData(uint8_t *data);
+uint32_t CANMiddlewareFwd_ParseUart(const uint8_t *data, uint32_t length);
+uint32_t CANMiddlewareFwd_UartFlush(void);
+void CANMiddlewareFwd_UartTxDone(void);
+bool CANMiddlewareFwd_GetNode(uint8_t nodeType, uint16_t nodeID, CAN_Middleware_Node_t *node);
+bool CANMiddlewareFwd_NodeReceive(uint8_t nodeType, uint16_t nodeID, CAN_Middleware_NodeReport_t *report);
+uint32_t CANMiddlewareFwd_ListNodes(CAN_Middleware_Node_t *nodes, uint32_t maxNodes);
 void CANMiddlewareNode_TransmitData(uint32_t data, CAN_Middleware_FrameTypes_t frameType);
 CAN_Middleware_FrameTypes_t CANMiddlewareNode_CheckRequest(Node_Config_t *nodeConfig);
-void CANMiddleware_Init(CAN_MiddlewareConfig_t *config);
+void CANMiddlewareNode_RegisterHandler(CAN_Middleware_FrameTypes_t frameType, CAN_Middleware_RequestHandler handler);
+uint32_t CANMiddlewareNode_Dispatch(Node_Config_t *nodeConfig);
+void CANMiddlewareNode_SetCoalescing(CAN_Middleware_FrameTypes_t frameType, bool enable);
+bool CANMiddleware_ScheduleConfig(const CAN_Middleware_Schedule_t *table, uint8_t count);
+uint32_t CANMiddleware_ScheduleRun(void);
+bool CANMiddleware_GatewayConfig(const CAN_Middleware_Route_t *table, uint8_t count);
+bool CANMiddlewareTp_Config(const CAN_Middleware_TpConfig_t *config);
+bool CANMiddlewareTp_Send(const uint8_t *data, uint16_t length);
+bool CANMiddlewareTp_Receive(uint8_t *buffer, uint16_t size);
+uint32_t CANMiddlewareTp_Run(void);
+bool CANMiddleware_Init(CAN_MiddlewareConfig_t *config);
+void CANMiddleware_GetLatency(CAN_Middleware_Latency_t *rxLatency, CAN_Middleware_Latency_t *txLatency);
+void CANMiddleware_ResetLatency(void);
+void CANMiddleware_GetStats(CAN_Middleware_Stats_t *stats);
+void CANMiddleware_ResetStats(void);
 
 /*******************************************************************************
  * End of file
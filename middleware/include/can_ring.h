@@ -0,0 +1,95 @@
+#ifndef __CAN_RING_H__
+#define __CAN_RING_H__
+
+/*******************************************************************************
+ * Include
+ ******************************************************************************/
+#include "can_driver.h"
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Number of slots, must be a power of two */
+#ifndef CAN_RING_SIZE
+#define CAN_RING_SIZE (16U)
+#endif
+#define CAN_RING_INDEX_MASK (CAN_RING_SIZE - 1U)
+_Static_assert((CAN_RING_SIZE & (CAN_RING_SIZE - 1U)) == 0U, "CAN_RING_SIZE must be a power of two");
+
+/*******************************************************************************
+ * Datatype Definiton
+ ******************************************************************************/
+/*
+ * Single-producer/single-consumer frame ring. The producer only writes head and
+ * the consumer only writes tail; the indices run freely and are masked on use,
+ * so head - tail is the fill level. Frames are built and read in place:
+ *   producer: slot = CAN_Ring_Claim() -> fill slot -> CAN_Ring_Commit()
+ *   consumer: slot = CAN_Ring_Peek()  -> use slot  -> CAN_Ring_Release()
+ * One side may run in an interrupt, no critical section is needed.
+ */
+typedef struct
+{
+    FlexCAN_TX_MessageBuffer_t slot[CAN_RING_SIZE];
+    uint32_t head;
+    uint32_t tail;
+} CAN_Ring_t;
+
+/*******************************************************************************
+ * APIs
+ ******************************************************************************/
+static inline void CAN_Ring_Init(CAN_Ring_t *ring)
+{
+    ring->head = 0U;
+    ring->tail = 0U;
+}
+
+/* Free slot for the producer, NULL when the ring is full */
+static inline FlexCAN_TX_MessageBuffer_t *CAN_Ring_Claim(CAN_Ring_t *ring)
+{
+    FlexCAN_TX_MessageBuffer_t *slot = NULL;
+    uint32_t head = ring->head;
+
+    if ((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) < CAN_RING_SIZE)
+    {
+        slot = &ring->slot[head & CAN_RING_INDEX_MASK];
+    }
+
+    return slot;
+}
+
+/* Publish the claimed slot to the consumer */
+static inline void CAN_Ring_Commit(CAN_Ring_t *ring)
+{
+    __atomic_store_n(&ring->head, ring->head + 1U, __ATOMIC_RELEASE);
+}
+
+/* Oldest frame for the consumer, NULL when the ring is empty */
+static inline FlexCAN_TX_MessageBuffer_t *CAN_Ring_Peek(CAN_Ring_t *ring)
+{
+    FlexCAN_TX_MessageBuffer_t *slot = NULL;
+    uint32_t tail = ring->tail;
+
+    if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != tail)
+    {
+        slot = &ring->slot[tail & CAN_RING_INDEX_MASK];
+    }
+
+    return slot;
+}
+
+/* Hand the peeked slot back to the producer */
+static inline void CAN_Ring_Release(CAN_Ring_t *ring)
+{
+    __atomic_store_n(&ring->tail, ring->tail + 1U, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t CAN_Ring_Count(CAN_Ring_t *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/*******************************************************************************
+ * End of file
+ ******************************************************************************/
+
+#endif /* __CAN_RING_H__ */
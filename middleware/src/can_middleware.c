@@ -1,7 +1,9 @@
 /*******************************************************************************
  * Include
  ******************************************************************************/
+#include <string.h>
 #include "can_middleware.h"
+#include "can_heap.h"
 #
 /*******************************************************************************
  * Macros
@@ -17,16 +19,86 @@
 #define OFFSET_STANDARD_ID_MB (18U)
 #define MSG_BUF_WORD_SIZE (4u)
 
-#define MB_TRANSMIT_INDEX (0U)
 #define MB_RECEIVE_INDEX (1U)
+/* MB0 and MB2..MB7, all served by the ORed 0-15 interrupt */
+#define MB_TRANSMIT_DEFAULT_MASK (0x000000FDU)
+#define MB_TRANSMIT_IRQ_MASK (0x0000FFFFU)
+/* 8 mailboxes right after the Rx FIFO filter table */
+#define MB_TRANSMIT_FIFO_DEFAULT_MASK (0x000000FFU)
 #define MB_MAX_DLC (8U)
+#define MB_NONE (0xFFU)
 
 #define ID_FORWARDER_DISTANCE (0U)
 #define ID_FORWARDER_ANGEL (1U)
+/* Local priority (ID word PRIO field) of the transmit queue: control frames
+ * overtake bulk data sent under the same identifier */
+#define FRAME_PRIO_CONTROL (0U)
+#define FRAME_PRIO_DATA (1U)
+
+/* Gateway lookup key: source instance, IDE and the 29 bit identifier */
+#define GATEWAY_ID_MASK (0x1FFFFFFFU)
+#define GATEWAY_KEY_IDE_SHIFT (29U)
+#define GATEWAY_KEY_SOURCE_SHIFT (30U)
+/* Rx FIFO filters of a gateway bus (RFFN = 0), more routes -> accept all */
+#define GATEWAY_FIFO_FILTERS (8U)
+#define GATEWAY_CAN1_RX_PIN (12U)
+#define GATEWAY_CAN1_TX_PIN (13U)
+#define GATEWAY_CAN2_RX_PIN (16U)
+#define GATEWAY_CAN2_TX_PIN (17U)
+#define GATEWAY_PIN_MUX (3U)
+
+/* Node registry: open addressing table at most half full, so a lookup ends
+ * after a probe or two */
+#define NODE_HASH_SIZE (2U * CAN_NODE_MAX)
+#define NODE_HASH_EMPTY (0xFFU)
+#define NODE_HASH_MULTIPLIER (2654435761U)
+#define NODE_KEY(nodeType, nodeID) (((uint32_t)(nodeType) << TWO_BYTES) | (uint32_t)(nodeID))
+#define NODE_TIMEOUT_DEFAULT (1000000U)
+#if (CAN_NODE_MAX > 127U) || (CAN_NODE_QUEUE_DEPTH > 128U)
+#error "CAN_NODE_MAX must be at most 127 and CAN_NODE_QUEUE_DEPTH at most 128"
+#endif
+
+/* Segmented transport, ISO 15765-2 framing: PCI type in the high nibble of
+ * byte 0, length, sequence number or flow status in the low nibble */
+#define TP_PCI_SHIFT (4U)
+#define TP_PCI_NIBBLE_MASK (0x0FU)
+#define TP_PCI_SINGLE (0x0U)
+#define TP_PCI_FIRST (0x1U)
+#define TP_PCI_CONSECUTIVE (0x2U)
+#define TP_PCI_FLOW_CONTROL (0x3U)
+#define TP_FS_CTS (0x0U)
+#define TP_FS_WAIT (0x1U)
+#define TP_FS_OVERFLOW (0x2U)
+#define TP_SF_MAX_LENGTH (7U)
+#define TP_FF_DATA_LENGTH (6U)
+#define TP_CF_DATA_LENGTH (7U)
+#define TP_MAX_LENGTH (4095U)
+#define TP_PADDING (0xCCU)
+#define TP_TIMEOUT_MS_DEFAULT (1000U)
+/* STmin 0x00-0x7F: milliseconds, 0xF1-0xF9: 100 us steps, others: 0x7F */
+#define TP_STMIN_MS_MAX (0x7FU)
+#define TP_STMIN_US_FIRST (0xF1U)
+#define TP_STMIN_US_LAST (0xF9U)
+#define TP_STMIN_US_BASE (0xF0U)
+#define TP_STMIN_US_PER_MS (10U)
+#define TP_TX_IDLE (0U)
+#define TP_TX_WAIT_FC (1U)
+#define TP_TX_SEND_CF (2U)
+#define TP_TX_SEND_LAST (3U)           /* Last frame queued or in its mailbox */
+#define TP_MB_NONE (0xFFU)
+#define TP_RX_IDLE (0U)                /* No buffer */
+#define TP_RX_ARMED (1U)
+#define TP_RX_ACTIVE (2U)
 
 #define UART_LENGTH (12U)
 #define UART_SOF (0x53U)
 #define UART_EOF (0x45U)
+/* Every byte of a valid UART frame, checksum included, adds up to this */
+#define UART_CHECKSUM_TOTAL (0xFFU)
+/* Frames per UART egress batch, one receive ring worth */
+#ifndef UART_BATCH_FRAMES
+#define UART_BATCH_FRAMES (CAN_RING_SIZE)
+#endif
 
 /*******************************************************************************
  * Variables Definition
@@ -54,17 +126,160 @@ static FlexCAN_control_MB_t s_config =
 
 static Node_Config_t *s_NodeConfigPtr;
 static uint8_t s_txMsgBuffer[12];
-static CAN_Queue_Struct_t s_queueCanTransmit;
-static CAN_Queue_Struct_t s_queueCanReceive;
+/* TX: application -> transmit interrupt, most important frame first, changed
+ * with the CAN interrupt masked. RX: receive interrupt -> application */
+static CAN_Heap_t s_heapCanTransmit;
+static CAN_Ring_t s_ringCanReceive;
 static CAN_Middleware_TxCallback s_callbackTransmit = NULL;
 static CAN_Middleware_RxCallback s_callbackReceive = NULL;
+/* Mailboxes owned by the transmit engine and the subset currently idle */
+static uint32_t s_txMbMask;
+static uint32_t s_txMbFree;
+static bool s_rxFifoEnabled;
+/* Receive mailboxes allocated by the filter compiler */
+static uint32_t s_rxMbMask;
+/* RX: hardware timestamp -> dequeue by the application,
+ * TX: enqueue by the application -> hardware timestamp of the sent frame */
+static CAN_Middleware_Latency_t s_latencyRx;
+static CAN_Middleware_Latency_t s_latencyTx;
+static uint64_t s_txMbEnqueueTime[32];
+static CAN_Middleware_Stats_t s_stats;
+static FlexCAN_RxFifo_dma_frame_t *s_rxDmaRing;
+/* Request handlers by frame type, and the response each request type gets */
+static CAN_Middleware_RequestHandler s_requestHandler[CAN_FRAME_TYPE_COUNT];
+/* Frame types sent as "last value wins". Such a type has at most one frame in
+ * a mailbox, so same-ID mailboxes cannot send an older value after a newer one,
+ * and one frame waiting: queued, or parked outside the queue while the other
+ * is in its mailbox */
+static uint32_t s_coalesceMask;
+static uint32_t s_coalesceInFlight;
+static uint32_t s_coalesceParked;
+static FlexCAN_TX_MessageBuffer_t *s_coalesceSlot[CAN_FRAME_TYPE_COUNT];
+static uint8_t s_txMbCoalesce[32];        /* Coalesced frame type in each mailbox, CAN_FRAME_TYPE_COUNT -> none */
+/* Periodic schedule: s_scheduleOrder is a min-heap of entries by next release,
+ * so an idle run looks at one entry only */
+static const CAN_Middleware_Schedule_t *s_schedule;
+static uint64_t s_scheduleNext[CAN_SCHEDULE_MAX];
+static uint8_t s_scheduleOrder[CAN_SCHEDULE_MAX];
+static uint8_t s_scheduleCount;
+static const CAN_Middleware_FrameTypes_t s_responseType[CAN_FRAME_TYPE_COUNT] =
+{
+    FRAME_TYPE_NONE,
+    FRAME_TYPE_CONFIG_RESPONSE,
+    FRAME_TYPE_CHECK_CONNECTION_RESPONSE,
+    FRAME_TYPE_READ_DATA_RESPONSE,
+    FRAME_TYPE_RESET_RESPONSE,
+    FRAME_TYPE_NONE,
+    FRAME_TYPE_NONE,
+    FRAME_TYPE_NONE,
+    FRAME_TYPE_NONE
+};
+/* Gateway: exact routes as keys sorted for a binary search, masked routes
+ * grouped by source (s_gwMaskedFirst[source] up to s_gwMaskedFirst[source + 1])
+ * in table order; both give the index of the route in s_gwRoute. CAN1 and CAN2
+ * have their own transmit queue and mailbox pool, CAN0 uses the node queue */
+static const CAN_Middleware_Route_t *s_gwRoute;
+static uint32_t s_gwExactKey[CAN_GATEWAY_ROUTE_MAX];
+static uint8_t s_gwExactRoute[CAN_GATEWAY_ROUTE_MAX];
+static uint8_t s_gwExactCount;
+static uint32_t s_gwMaskedKey[CAN_GATEWAY_ROUTE_MAX];
+static uint32_t s_gwMaskedMask[CAN_GATEWAY_ROUTE_MAX];
+static uint8_t s_gwMaskedRoute[CAN_GATEWAY_ROUTE_MAX];
+static uint8_t s_gwMaskedFirst[CAN_GATEWAY_BUS_COUNT + 1U];
+static uint8_t s_gwBusUp;
+static CAN_Heap_t s_gwHeap[CAN_GATEWAY_BUS_COUNT - 1U];
+static uint32_t s_gwTxMbMask[CAN_GATEWAY_BUS_COUNT - 1U];
+static uint32_t s_gwTxMbFree[CAN_GATEWAY_BUS_COUNT - 1U];
+/* Node registry of the forwarder, filled by the receive interrupt or the Rx
+ * FIFO DMA callback: entries in arrival order, s_nodeHash maps a node key to
+ * its entry. Each node has a small report queue (s_nodeHead - s_nodeTail
+ * reports) for the application. Readers mask CAN0, which holds off both */
+static bool s_nodeRegistry;
+static CAN_Middleware_Node_t s_node[CAN_NODE_MAX];
+static uint8_t s_nodeHash[NODE_HASH_SIZE];
+static uint8_t s_nodeCount;
+static CAN_Middleware_NodeReport_t s_nodeQueue[CAN_NODE_MAX][CAN_NODE_QUEUE_DEPTH];
+static uint8_t s_nodeHead[CAN_NODE_MAX];
+static uint8_t s_nodeTail[CAN_NODE_MAX];
+static uint32_t s_nodeTimeout;
+/* Segmented transport, one transfer each way: the transmit side sends from the
+ * caller's data, the receive side reassembles into the caller's buffer. Both
+ * belong to the transport until their callback. s_tpTxNext is when the next
+ * consecutive frame may go, or the flow control deadline */
+static const CAN_Middleware_TpConfig_t *s_tp;
+static uint32_t s_tpTimeout;
+static const uint8_t *s_tpTxData;
+static uint16_t s_tpTxLength;
+static uint16_t s_tpTxOffset;
+static uint8_t s_tpTxState;
+static uint8_t s_tpTxSeq;
+static uint8_t s_tpTxBlockLeft;
+static uint32_t s_tpTxStMin;
+static uint64_t s_tpTxNext;
+/* Same-ID mailboxes may go out in any order, so consecutive frames go one at a
+ * time: queued (s_tpTxSlot), then in mailbox s_tpTxMb until it completes */
+static FlexCAN_TX_MessageBuffer_t *s_tpTxSlot;
+static uint8_t s_tpTxMb;
+static uint8_t *s_tpRxBuffer;
+static uint16_t s_tpRxSize;
+static uint16_t s_tpRxLength;
+static uint16_t s_tpRxOffset;
+static uint8_t s_tpRxState;
+static uint8_t s_tpRxSeq;
+static uint8_t s_tpRxBlockCount;
+static uint64_t s_tpRxDeadline;
+/* UART frame split across two chunks, s_uartFill bytes from its SOF on */
+static uint8_t s_uartFrame[UART_LENGTH];
+static uint8_t s_uartFill;
+/* UART egress: one half is sent by the DMA while the other is filled. A half
+ * with a non-zero length is complete and waits for, or is in, its transfer */
+static CAN_Middleware_UartTxStart s_uartTxStart;
+static uint8_t s_uartTxArea[2][UART_BATCH_FRAMES * UART_LENGTH];
+static uint32_t s_uartTxLength[2];
+static uint8_t s_uartTxActive;
+static bool s_uartTxBusy;
 
 /*******************************************************************************
  * Prototype
  ******************************************************************************/
-static void CANMiddleWare_ConvertDataUartToCan(FlexCAN_TX_MessageBuffer_t *messageBuffer, uint8_t *data);
-static void CANMiddleware_IrqHandler(uint8_t flagInterruptMB);
+static void CANMiddleWare_ConvertDataUartToCan(FlexCAN_TX_MessageBuffer_t *messageBuffer, const uint8_t *data);
+static bool CANMiddleware_UartFrameValid(const uint8_t *data);
+static bool CANMiddleware_UartEnqueue(const uint8_t *data);
+static void CANMiddleware_UartEncode(uint8_t *data, const FlexCAN_TX_MessageBuffer_t *rxMsgBuffer);
+static void CANMiddleware_IrqHandler(uint32_t flagMaskMB);
 static void CANMiddleWare_CreateMessageBuffer(FlexCAN_TX_MessageBuffer_t *msgBuffer, uint32_t data, CAN_Middleware_FrameTypes_t frameType);
+static void CANMiddleware_MbLoad(uint32_t instance, CAN_Heap_t *heap, uint32_t *mbFree);
+static void CANMiddleware_TxLoad(void);
+static void CANMiddleware_TxKick(void);
+static void CANMiddleware_TxComplete(uint8_t indexOfMB);
+static void CANMiddleware_RxFifoDrain(void);
+static void CANMiddleware_LatencyRecord(CAN_Middleware_Latency_t *latency, uint64_t bitTimes);
+static void CANMiddleware_QueueAccount(CAN_Middleware_QueueStats_t *stats, uint32_t depth, bool queued);
+static uint8_t CANMiddleware_FramePrio(uint8_t frameType);
+static void CANMiddleware_TxDequeue(CAN_Heap_t *heap, uint8_t indexOfMB);
+static void CANMiddleware_ScheduleSiftDown(void);
+static bool CANMiddleware_ScheduleRelease(const CAN_Middleware_Schedule_t *entry, uint64_t releaseTime);
+static void CANMiddleware_RxDmaHandler(uint32_t instance, uint16_t firstFrame, uint16_t numberOfFrame);
+static void CANMiddleware_RxDmaPoll(void);
+static bool CANMiddleware_NodeEnqueue(uint32_t data, CAN_Middleware_FrameTypes_t frameType);
+static CAN_Middleware_FrameTypes_t CANMiddleware_RequestAccept(const FlexCAN_TX_MessageBuffer_t *request, Node_Config_t *nodeConfig);
+static bool CANMiddleware_RxIngress(const FlexCAN_TX_MessageBuffer_t *frame);
+static FlexCAN_TX_MessageBuffer_t *CANMiddleware_TpEnqueue(const uint8_t *pci, uint8_t pciLength, const uint8_t *data, uint8_t dataLength, uint8_t prio);
+static uint32_t CANMiddleware_TpPump(uint64_t now);
+static void CANMiddleware_TpTxEnd(bool success);
+static void CANMiddleware_TpFlowControl(uint8_t flowStatus);
+static uint32_t CANMiddleware_TpStMinTicks(uint8_t stMin);
+static bool CANMiddleware_TpIngress(const FlexCAN_TX_MessageBuffer_t *frame);
+static uint8_t CANMiddleware_NodeFind(uint8_t nodeType, uint16_t nodeID, bool create);
+static void CANMiddleware_NodeRecord(const FlexCAN_TX_MessageBuffer_t *frame);
+static void CANMiddleware_NodeCopy(uint8_t slot, uint64_t now, CAN_Middleware_Node_t *node);
+static void CANMiddleware_GatewayRoute(uint32_t source, const FlexCAN_TX_MessageBuffer_t *frame);
+static bool CANMiddleware_GatewayEnqueue(uint32_t instance, const FlexCAN_TX_MessageBuffer_t *frame, uint32_t id);
+static void CANMiddleware_GatewayKick(uint32_t instance);
+static void CANMiddleware_GatewayIrq(uint32_t instance, uint32_t flagMaskMB);
+static void CANMiddleware_GatewayIrq1(uint32_t flagMaskMB);
+static void CANMiddleware_GatewayIrq2(uint32_t flagMaskMB);
+static void CANMiddleware_GatewayBusInit(uint32_t instance, const FlexCAN_RxFifo_filter_t *filter, uint8_t count);
 /*******************************************************************************
  * Function
  ******************************************************************************/
@@ -88,22 +303,24 @@ static void CANMiddleWare_CreateMessageBuffer(FlexCAN_TX_MessageBuffer_t *msgBuf
  * byte 7: threshold
 **/
 
-static void CANMiddleWare_ConvertDataUartToCan(FlexCAN_TX_MessageBuffer_t *messageBuffer, uint8_t *data)
+/* Bulk data goes behind the configuration, connection check and reset traffic */
+static uint8_t CANMiddleware_FramePrio(uint8_t frameType)
+{
+    return ((frameType == FRAME_TYPE_READ_DATA) || (frameType == FRAME_TYPE_READ_DATA_RESPONSE)) ?
+           FRAME_PRIO_DATA : FRAME_PRIO_CONTROL;
+}
+
+static void CANMiddleWare_ConvertDataUartToCan(FlexCAN_TX_MessageBuffer_t *messageBuffer, const uint8_t *data)
 {
     uint8_t index;
 
     if (NULL != data)
     {
-        messageBuffer->cfControl.srr = 1U;
-        messageBuffer->cfControl.ide = 1U;
-        messageBuffer->cfControl.edl = 0U;
-        messageBuffer->cfControl.brs = 0U;
-        messageBuffer->cfControl.esi = 0U;
-        messageBuffer->cfControl.rtr = 0U;
+        messageBuffer->cfControl = s_config;
         messageBuffer->cfControl.dlc = MB_MAX_DLC;
         messageBuffer->cfID.id = 0U;
         messageBuffer->cfID.id = (uint32_t)((((data[4]) << ONE_BYTE) | (data[5])) << OFFSET_STANDARD_ID_MB);
-        messageBuffer->cfID.prio = 0U;
+        messageBuffer->cfID.prio = CANMiddleware_FramePrio(data[3]);
         for (index = 0; index < messageBuffer->cfControl.dlc; index++)
         {
             messageBuffer->dataByte[index] = data[2 + index];
@@ -111,33 +328,285 @@ static void CANMiddleWare_ConvertDataUartToCan(FlexCAN_TX_MessageBuffer_t *messa
     }
 }
 
-static void CANMiddleware_IrqHandler(uint8_t flagInterruptMB)
+static void CANMiddleware_LatencyRecord(CAN_Middleware_Latency_t *latency, uint64_t bitTimes)
 {
-    FlexCAN_TX_MessageBuffer_t *msgTXBuff = NULL;
-    FlexCAN_TX_MessageBuffer_t msgRXBuff;
+    uint32_t indexOfBucket = 0;
+
+    if (bitTimes != 0U)
+    {
+        indexOfBucket = 63U - (uint32_t)__builtin_clzll(bitTimes);
+    }
+    if (indexOfBucket >= CAN_LATENCY_BUCKET_COUNT)
+    {
+        indexOfBucket = CAN_LATENCY_BUCKET_COUNT - 1U;
+    }
+    latency->bucket[indexOfBucket]++;
+    latency->count++;
+    latency->sum += bitTimes;
+    if (bitTimes > latency->max)
+    {
+        latency->max = bitTimes;
+    }
+}
+
+/* Count a frame offered to a queue, depth is taken after its commit */
+static void CANMiddleware_QueueAccount(CAN_Middleware_QueueStats_t *stats, uint32_t depth, bool queued)
+{
+    if (queued)
+    {
+        stats->queued++;
+        if (depth > stats->peak)
+        {
+            stats->peak = depth;
+        }
+    }
+    else
+    {
+        stats->dropped++;
+    }
+}
+
+/* Drop the frame just loaded into indexOfMB from the queue, MB_NONE when it was
+ * refused and is lost; from now on a new value of a coalesced type waits for
+ * that mailbox to finish. Coalescing and the transport only use the node bus */
+static void CANMiddleware_TxDequeue(CAN_Heap_t *heap, uint8_t indexOfMB)
+{
+    FlexCAN_TX_MessageBuffer_t *msgTXBuff = CAN_Heap_Peek(heap);
+    uint8_t frameType = msgTXBuff->dataByte[1];
+
+    if (heap == &s_heapCanTransmit)
+    {
+        if ((frameType < CAN_FRAME_TYPE_COUNT) && (s_coalesceSlot[frameType] == msgTXBuff))
+        {
+            s_coalesceSlot[frameType] = NULL;
+            if (indexOfMB != MB_NONE)
+            {
+                s_coalesceInFlight |= (1UL << frameType);
+                s_txMbCoalesce[indexOfMB] = frameType;
+            }
+        }
+        if (msgTXBuff == s_tpTxSlot)
+        {
+            s_tpTxSlot = NULL;
+            s_tpTxMb = indexOfMB;
+            if ((indexOfMB == MB_NONE) && (s_tpTxState != TP_TX_IDLE))
+            {
+                CANMiddleware_TpTxEnd(false);
+            }
+        }
+    }
+    CAN_Heap_Release(heap);
+}
+
+/* Move committed frames of heap into the idle transmit mailboxes mbFree of
+ * instance, from that instance's interrupt or with it masked. Serves the node
+ * bus and the gateway buses alike */
+static void CANMiddleware_MbLoad(uint32_t instance, CAN_Heap_t *heap, uint32_t *mbFree)
+{
+    FlexCAN_TX_MessageBuffer_t *msgTXBuff;
+    FlexCAN_ReturnCode_t status;
+    uint8_t indexOfMB;
+
+    msgTXBuff = CAN_Heap_Peek(heap);
+    while ((msgTXBuff != NULL) && (*mbFree != 0U))
+    {
+        indexOfMB = (uint8_t)__builtin_ctz(*mbFree);
+        *mbFree &= ~(1UL << indexOfMB);
+        if (instance == CAN_0)
+        {
+            s_txMbEnqueueTime[indexOfMB] = msgTXBuff->time;
+        }
+        status = FlexCAN_SendAsync(instance, indexOfMB, msgTXBuff, NULL);
+        if (status == FLEXCAN_RETURN_CODE_SUCCESS)
+        {
+            CANMiddleware_TxDequeue(heap, indexOfMB);
+        }
+        else if (status != FLEXCAN_RETURN_CODE_BUSY)
+        {
+            /* The frame does not fit the mailbox: drop it, keep the mailbox */
+            s_stats.txRejected++;
+            CANMiddleware_TxDequeue(heap, MB_NONE);
+            *mbFree |= (1UL << indexOfMB);
+        }
+        else
+        {
+            /* Still sending: the frame waits, the completion frees the mailbox */
+        }
+        msgTXBuff = CAN_Heap_Peek(heap);
+    }
+}
+
+static void CANMiddleware_TxLoad(void)
+{
+    CANMiddleware_MbLoad(CAN_0, &s_heapCanTransmit, &s_txMbFree);
+}
+
+/* The transmit interrupt is the queue's consumer, so the application only
+ * takes that role with it masked */
+static void CANMiddleware_TxKick(void)
+{
+    FlexCAN_DisableIRQ(CAN_0);
+    CANMiddleware_TxLoad();
+    FlexCAN_EnableIRQ(CAN_0);
+}
+
+/* Refill the mailbox that just finished with the most important queued frame */
+static void CANMiddleware_TxComplete(uint8_t indexOfMB)
+{
+    uint64_t sentTime;
+    uint8_t frameType;
 
-    if (flagInterruptMB == MB_TRANSMIT_INDEX)
+    /* The timestamp is lost once the mailbox is loaded again */
+    if (FlexCAN_GetTxTimeStamp(CAN_0, indexOfMB, &sentTime) == FLEXCAN_RETURN_CODE_SUCCESS)
     {
-        FlexCAN_ClearInterruptFlag(CAN_0, MB_TRANSMIT_INDEX);
-        CAN_Queue_Pop(&s_queueCanTransmit);
-        CAN_Queue_Peek(&s_queueCanTransmit, &msgTXBuff);
-        if (msgTXBuff != NULL)
+        CANMiddleware_LatencyRecord(&s_latencyTx, sentTime - s_txMbEnqueueTime[indexOfMB]);
+    }
+    if (indexOfMB == s_tpTxMb)
+    {
+        s_tpTxMb = TP_MB_NONE;
+        if (s_tpTxState == TP_TX_SEND_LAST)
+        {
+            CANMiddleware_TpTxEnd(true);
+        }
+    }
+    /* The value parked behind this one may go now */
+    frameType = s_txMbCoalesce[indexOfMB];
+    if (frameType < CAN_FRAME_TYPE_COUNT)
+    {
+        s_txMbCoalesce[indexOfMB] = CAN_FRAME_TYPE_COUNT;
+        s_coalesceInFlight &= ~(1UL << frameType);
+        if ((s_coalesceParked & (1UL << frameType)) != 0U)
+        {
+            s_coalesceParked &= ~(1UL << frameType);
+            CAN_Heap_Commit(&s_heapCanTransmit, s_coalesceSlot[frameType]);
+        }
+    }
+
+    s_txMbFree |= (1UL << indexOfMB);
+    CANMiddleware_TxLoad();
+}
+
+/* Empty the Rx FIFO into the receive ring in one pass; frames that find the
+ * ring full are read and dropped so the FIFO keeps accepting new ones */
+static void CANMiddleware_RxFifoDrain(void)
+{
+    FlexCAN_TX_MessageBuffer_t *msgRXBuff;
+    FlexCAN_TX_MessageBuffer_t msgDiscard;
+
+    msgRXBuff = CAN_Ring_Claim(&s_ringCanReceive);
+    while (FlexCAN_ReadRxFifo(CAN_0, (msgRXBuff != NULL) ? msgRXBuff : &msgDiscard, NULL) == FLEXCAN_RETURN_CODE_SUCCESS)
+    {
+        if (!CANMiddleware_RxIngress((msgRXBuff != NULL) ? msgRXBuff : &msgDiscard))
         {
-            FlexCAN_Send(CAN_0, MB_TRANSMIT_INDEX, msgTXBuff);
+            if (msgRXBuff != NULL)
+            {
+                CAN_Ring_Commit(&s_ringCanReceive);
+            }
+            CANMiddleware_QueueAccount(&s_stats.rx, CAN_Ring_Count(&s_ringCanReceive), (msgRXBuff != NULL));
+            if(s_callbackReceive != NULL)
+            {
+                s_callbackReceive();
+            }
         }
-        if(s_callbackTransmit != NULL) 
+        msgRXBuff = CAN_Ring_Claim(&s_ringCanReceive);
+    }
+}
+
+/* Frames copied by the DMA: decode them into the receive ring, dropping what
+ * does not fit. Runs from the DMA channel interrupt, which
+ * FlexCAN_DisableIRQ(CAN_0) masks along with the CAN0 vectors, so the ingress
+ * (routing, registry, transport) is locked out like from IrqHandler, or from
+ * CANMiddleware_RxDmaPoll with interrupts held off */
+static void CANMiddleware_RxDmaHandler(uint32_t instance, uint16_t firstFrame, uint16_t numberOfFrame)
+{
+    FlexCAN_TX_MessageBuffer_t *msgRXBuff;
+    FlexCAN_TX_MessageBuffer_t *frame;
+    FlexCAN_TX_MessageBuffer_t msgDiscard;
+    uint16_t index;
+    uint64_t now = FlexCAN_GetTime(instance);
+
+    for (index = firstFrame; index < (firstFrame + numberOfFrame); index++)
+    {
+        /* A frame that finds the ring full is still decoded for the ingress */
+        msgRXBuff = CAN_Ring_Claim(&s_ringCanReceive);
+        frame = (msgRXBuff != NULL) ? msgRXBuff : &msgDiscard;
+        FlexCAN_DecodeRxFifoFrame(&s_rxDmaRing[index], frame);
+        frame->time = FlexCAN_ExtendTimeStamp(now, (uint16_t)frame->cfControl.timeStamp);
+        if (!CANMiddleware_RxIngress(frame))
         {
-        	s_callbackTransmit();
+            if (msgRXBuff != NULL)
+            {
+                CAN_Ring_Commit(&s_ringCanReceive);
+            }
+            CANMiddleware_QueueAccount(&s_stats.rx, CAN_Ring_Count(&s_ringCanReceive), (msgRXBuff != NULL));
+            if(s_callbackReceive != NULL)
+            {
+                s_callbackReceive();
+            }
         }
     }
-    if (flagInterruptMB == MB_RECEIVE_INDEX)
+}
+
+/* Frames below the DMA watermark would wait for a half of the ring to fill;
+ * the receive and periodic entry points hand them over first. Not to be
+ * called with CAN_0 masked */
+static void CANMiddleware_RxDmaPoll(void)
+{
+    if (s_rxDmaRing != NULL)
+    {
+        (void)FlexCAN_PollRxFifoDma(CAN_0);
+    }
+}
+
+static void CANMiddleware_IrqHandler(uint32_t flagMaskMB)
+{
+    FlexCAN_TX_MessageBuffer_t *msgRXBuff;
+    FlexCAN_TX_MessageBuffer_t msgDiscard;
+    uint8_t indexOfMB;
+
+    /* Frames available, warning and overflow all mean the FIFO needs draining */
+    if ((s_rxFifoEnabled) && ((flagMaskMB & FLEXCAN_RX_FIFO_FLAG_MASK) != 0U))
+    {
+        flagMaskMB &= ~FLEXCAN_RX_FIFO_FLAG_MASK;
+        CANMiddleware_RxFifoDrain();
+    }
+
+    while (flagMaskMB != 0U)
     {
-        FlexCAN_ClearInterruptFlag(CAN_0, MB_RECEIVE_INDEX);
-        FlexCAN_Receive(CAN_0, MB_RECEIVE_INDEX, &msgRXBuff);
-        CAN_Queue_Push(&s_queueCanReceive, &msgRXBuff);
-        if(s_callbackReceive != NULL)
+        indexOfMB = (uint8_t)__builtin_ctz(flagMaskMB);
+        flagMaskMB &= flagMaskMB - 1U;
+        if ((s_txMbMask >> indexOfMB) & 1U)
+        {
+            CANMiddleware_TxComplete(indexOfMB);
+            /* A freed slot lets the next consecutive frames of a transfer in */
+            if (s_tpTxState == TP_TX_SEND_CF)
+            {
+                (void)CANMiddleware_TpPump(FlexCAN_GetTime(CAN_0));
+                CANMiddleware_TxLoad();
+            }
+            if(s_callbackTransmit != NULL) 
+            {
+            	s_callbackTransmit();
+            }
+        }
+        else if ((s_rxMbMask >> indexOfMB) & 1U)
         {
-        	s_callbackReceive();
+            /* Read straight into the ring; when it is full the mailbox is still
+             * read to unlock it and the frame is dropped */
+            msgRXBuff = CAN_Ring_Claim(&s_ringCanReceive);
+            FlexCAN_Receive(CAN_0, indexOfMB, (msgRXBuff != NULL) ? msgRXBuff : &msgDiscard);
+            if (!CANMiddleware_RxIngress((msgRXBuff != NULL) ? msgRXBuff : &msgDiscard))
+            {
+                if (msgRXBuff != NULL)
+                {
+                    CAN_Ring_Commit(&s_ringCanReceive);
+                }
+                CANMiddleware_QueueAccount(&s_stats.rx, CAN_Ring_Count(&s_ringCanReceive), (msgRXBuff != NULL));
+                if(s_callbackReceive != NULL)
+                {
+                	s_callbackReceive();
+                }
+            }
         }
     }
 }
@@ -153,6 +622,7 @@ static void CANMiddleWare_CreateMessageBuffer(FlexCAN_TX_MessageBuffer_t *msgBuf
     {
         msgBuffer->cfID.id = (uint32_t)(ID_FORWARDER_ANGEL << OFFSET_STANDARD_ID_MB); /* 1 */
     }
+    msgBuffer->cfID.prio = CANMiddleware_FramePrio((uint8_t)frameType);
     msgBuffer->cfControl.dlc = MB_MAX_DLC;
     msgBuffer->dataByte[0] = (uint8_t)(s_NodeConfigPtr->nodeType);
     msgBuffer->dataByte[1] = (uint8_t)frameType;
@@ -164,123 +634,1526 @@ static void CANMiddleWare_CreateMessageBuffer(FlexCAN_TX_MessageBuffer_t *msgBuf
     msgBuffer->dataByte[7] = (uint8_t)(s_NodeConfigPtr->threshold);
 }
 
-/* Can middleware for Forwarder */
-void CANMiddleWare_ConvertDataCanToUart(uint8_t **data)
+/* One received frame as a UART frame of UART_LENGTH bytes */
+static void CANMiddleware_UartEncode(uint8_t *data, const FlexCAN_TX_MessageBuffer_t *rxMsgBuffer)
 {
     uint8_t index = 0;
     uint8_t checkSum = 0;
+
+    data[0] = UART_SOF;
+    data[1] = UART_LENGTH;
+    data[2] = rxMsgBuffer->dataByte[0]; /* node type */
+    data[3] = rxMsgBuffer->dataByte[1]; /* frame type */
+    data[4] = rxMsgBuffer->dataByte[3]; /* node id */
+    data[5] = rxMsgBuffer->dataByte[2]; /* node id */
+    for (index = 6; index < 9; index++)
+    {
+        data[index] = rxMsgBuffer->dataByte[index-2]; /* data */
+    }
+    data[9] = rxMsgBuffer->dataByte[7]; /* threshold */
+    data[11] = UART_EOF;
+    /* checksum */
+    checkSum += UART_EOF + UART_SOF + UART_LENGTH;
+    for (index = 2; index < UART_LENGTH - 2; index++)
+    {
+        checkSum += data[index];
+    }
+    data[10] = (uint8_t)(0xFFU - checkSum);
+}
+
+/* Can middleware for Forwarder */
+/* One frame per call into a single buffer, valid until the next call */
+void CANMiddleWare_ConvertDataCanToUart(uint8_t **data)
+{
     FlexCAN_TX_MessageBuffer_t *rxMsgBuffer = NULL;
 
     if (NULL != data)
     {
-        CAN_Queue_Peek(&s_queueCanReceive, &rxMsgBuffer);
-        CAN_Queue_Pop(&s_queueCanReceive);
+        CANMiddleware_RxDmaPoll();
+        rxMsgBuffer = CAN_Ring_Peek(&s_ringCanReceive);
         if (NULL != rxMsgBuffer)
         {
-            s_txMsgBuffer[0] = UART_SOF;
-            s_txMsgBuffer[1] = UART_LENGTH;
-            s_txMsgBuffer[2] = rxMsgBuffer->dataByte[0]; /* node type */
-            s_txMsgBuffer[3] = rxMsgBuffer->dataByte[1]; /* frame type */
-            s_txMsgBuffer[4] = rxMsgBuffer->dataByte[3]; /* node id */
-            s_txMsgBuffer[5] = rxMsgBuffer->dataByte[2]; /* node id */
-            for (index = 6; index < 9; index++)
-            {
-                s_txMsgBuffer[index] = rxMsgBuffer->dataByte[index-2]; /* data */
-            }
-            s_txMsgBuffer[9] = rxMsgBuffer->dataByte[7]; /* threshold */
-            s_txMsgBuffer[11] = UART_EOF;
-            /* checksum */
-            checkSum += UART_EOF + UART_SOF + UART_LENGTH;
-            for (index = 2; index < UART_LENGTH - 2; index++)
+            CANMiddleware_UartEncode(s_txMsgBuffer, rxMsgBuffer);
+            *data = (uint8_t *)&s_txMsgBuffer[0];
+            CANMiddleware_LatencyRecord(&s_latencyRx, FlexCAN_GetTime(CAN_0) - rxMsgBuffer->time);
+            /* Slot goes back to the interrupt only once it has been read */
+            CAN_Ring_Release(&s_ringCanReceive);
+        }
+    }
+}
+
+/*
+ * Batched egress for the forwarder: every received frame waiting in the ring is
+ * encoded back to back into the half of the UART area the DMA is not sending,
+ * and that half is handed to uartTxStart as one transfer. While a transfer is in
+ * flight the batch waits and CANMiddlewareFwd_UartTxDone starts it as soon as
+ * the first one ends; with both halves taken the frames stay in the ring for the
+ * next call. Returns the number of frames encoded
+ */
+uint32_t CANMiddlewareFwd_UartFlush(void)
+{
+    FlexCAN_TX_MessageBuffer_t *rxMsgBuffer;
+    uint8_t fill;
+    uint32_t length = 0;
+    uint64_t now;
+
+    CANMiddleware_RxDmaPoll();
+    fill = __atomic_load_n(&s_uartTxBusy, __ATOMIC_ACQUIRE) ? (uint8_t)(s_uartTxActive ^ 1U) : s_uartTxActive;
+    if ((s_uartTxStart != NULL) && (__atomic_load_n(&s_uartTxLength[fill], __ATOMIC_ACQUIRE) == 0U))
+    {
+        now = FlexCAN_GetTime(CAN_0);
+        rxMsgBuffer = CAN_Ring_Peek(&s_ringCanReceive);
+        while ((rxMsgBuffer != NULL) && (length < sizeof(s_uartTxArea[fill])))
+        {
+            CANMiddleware_UartEncode(&s_uartTxArea[fill][length], rxMsgBuffer);
+            CANMiddleware_LatencyRecord(&s_latencyRx, now - rxMsgBuffer->time);
+            CAN_Ring_Release(&s_ringCanReceive);
+            length += UART_LENGTH;
+            rxMsgBuffer = CAN_Ring_Peek(&s_ringCanReceive);
+        }
+        if (length != 0U)
+        {
+            __atomic_store_n(&s_uartTxLength[fill], length, __ATOMIC_RELEASE);
+            /* Idle, or the transfer in flight ended while this half was filled */
+            if (!__atomic_exchange_n(&s_uartTxBusy, true, __ATOMIC_ACQ_REL))
             {
-                checkSum += s_txMsgBuffer[index];
+                s_uartTxActive = fill;
+                s_uartTxStart(s_uartTxArea[fill], length);
             }
-            s_txMsgBuffer[10] = (uint8_t)(0xFFU - checkSum);
-            *data = (uint8_t *)&s_txMsgBuffer[0];
         }
     }
+
+    return length / UART_LENGTH;
+}
+
+/* Call from the UART transmit DMA completion interrupt: the sent half is free
+ * again and the other one goes out at once when a batch is waiting in it */
+void CANMiddlewareFwd_UartTxDone(void)
+{
+    s_uartTxLength[s_uartTxActive] = 0U;
+    s_uartTxActive ^= 1U;
+    if (__atomic_load_n(&s_uartTxLength[s_uartTxActive], __ATOMIC_ACQUIRE) != 0U)
+    {
+        s_uartTxStart(s_uartTxArea[s_uartTxActive], s_uartTxLength[s_uartTxActive]);
+    }
+    else
+    {
+        __atomic_store_n(&s_uartTxBusy, false, __ATOMIC_RELEASE);
+    }
+}
+
+/* SOF, length and EOF in place and checksum = 0xFF - sum of every other byte */
+static bool CANMiddleware_UartFrameValid(const uint8_t *data)
+{
+    uint8_t index;
+    uint8_t checkSum = 0;
+
+    for (index = 0; index < UART_LENGTH; index++)
+    {
+        checkSum += data[index];
+    }
+
+    return (data[0] == UART_SOF) && (data[1] == UART_LENGTH) && (data[UART_LENGTH - 1U] == UART_EOF) &&
+           (checkSum == UART_CHECKSUM_TOTAL);
+}
+
+/* Encode a valid UART frame straight into a transmit queue slot, false when
+ * the queue is full and the frame is dropped */
+static bool CANMiddleware_UartEnqueue(const uint8_t *data)
+{
+    FlexCAN_TX_MessageBuffer_t *msgBuff;
+
+    FlexCAN_DisableIRQ(CAN_0);
+    msgBuff = CAN_Heap_Claim(&s_heapCanTransmit);
+    if (msgBuff != NULL)
+    {
+        CANMiddleWare_ConvertDataUartToCan(msgBuff, data);
+        msgBuff->time = FlexCAN_GetTime(CAN_0);
+        CAN_Heap_Commit(&s_heapCanTransmit, msgBuff);
+    }
+    CANMiddleware_QueueAccount(&s_stats.tx, CAN_Heap_Count(&s_heapCanTransmit), (msgBuff != NULL));
+    FlexCAN_EnableIRQ(CAN_0);
+
+    return (msgBuff != NULL);
 }
 
 /* Can middleware send  for Forwarder */
+/* One aligned UART frame; frames that fail the checks are rejected, frames
+ * that find the transmit queue full are dropped */
 void CANMiddlewareFwd_TransmitData(uint8_t *data)
 {
-    FlexCAN_TX_MessageBuffer_t msgBuff;
+    if ((data != NULL) && (CANMiddleware_UartFrameValid(data)))
+    {
+        if (CANMiddleware_UartEnqueue(data))
+        {
+            CANMiddleware_TxKick();
+        }
+    }
+    else
+    {
+        s_stats.uartRejected++;
+    }
+}
+
+/*
+ * Feed UART bytes in chunks of any size, e.g. each newly written part of a UART
+ * receive DMA ring (a wrapped region is passed as two calls). Frames are found
+ * by their SOF, checked like CANMiddleWare_ConvertDataCanToUart builds them and
+ * queued for transmission; after a bad frame the search restarts on the byte
+ * following its SOF. Frames lying whole in the chunk are checked in place, only
+ * one cut by the chunk end is copied. The mailboxes are loaded once per call.
+ * Returns the number of frames queued
+ */
+uint32_t CANMiddlewareFwd_ParseUart(const uint8_t *data, uint32_t length)
+{
+    const uint8_t *frame;
+    const uint8_t *start;
+    uint32_t index = 0;
+    uint32_t count;
+    uint32_t queued = 0;
+
+    while ((data != NULL) && (index < length))
+    {
+        frame = NULL;
+        if (s_uartFill == 0U)
+        {
+            /* Skip to the next start of frame */
+            start = memchr(&data[index], UART_SOF, length - index);
+            index = (start != NULL) ? (uint32_t)(start - data) : length;
+            if ((start != NULL) && ((length - index) >= UART_LENGTH))
+            {
+                frame = start;
+                index += UART_LENGTH;
+            }
+            else if (start != NULL)
+            {
+                s_uartFill = (uint8_t)(length - index);
+                memcpy(s_uartFrame, start, s_uartFill);
+                index = length;
+            }
+        }
+        else
+        {
+            count = UART_LENGTH - s_uartFill;
+            if (count > (length - index))
+            {
+                count = length - index;
+            }
+            memcpy(&s_uartFrame[s_uartFill], &data[index], count);
+            s_uartFill += (uint8_t)count;
+            index += count;
+            if (s_uartFill == UART_LENGTH)
+            {
+                frame = s_uartFrame;
+            }
+        }
+
+        if ((frame != NULL) && (CANMiddleware_UartFrameValid(frame)))
+        {
+            s_uartFill = 0U;
+            queued += CANMiddleware_UartEnqueue(frame) ? 1U : 0U;
+        }
+        else if (frame == s_uartFrame)
+        {
+            /* Resynchronize on the next SOF among the bytes already copied */
+            s_stats.uartRejected++;
+            start = memchr(&s_uartFrame[1], UART_SOF, UART_LENGTH - 1U);
+            s_uartFill = (start != NULL) ? (uint8_t)(&s_uartFrame[UART_LENGTH] - start) : 0U;
+            memmove(s_uartFrame, (start != NULL) ? start : s_uartFrame, s_uartFill);
+        }
+        else if (frame != NULL)
+        {
+            s_stats.uartRejected++;
+            index = (uint32_t)(frame - data) + 1U;
+        }
+    }
+    if (queued != 0U)
+    {
+        CANMiddleware_TxKick();
+    }
+
+    return queued;
+}
+
+/* Build a node frame in the transmit queue, false when the queue is full. A
+ * coalesced type overwrites its frame still waiting: the ID word stays the
+ * same, so does its place in the queue, and time restarts from the new value */
+static bool CANMiddleware_NodeEnqueue(uint32_t data, CAN_Middleware_FrameTypes_t frameType)
+{
+    FlexCAN_TX_MessageBuffer_t *msgBuff = NULL;
+    bool coalesce = ((uint32_t)frameType < CAN_FRAME_TYPE_COUNT) && ((s_coalesceMask & (1UL << frameType)) != 0U);
+    bool queued;
+
+    FlexCAN_DisableIRQ(CAN_0);
+    if (coalesce)
+    {
+        msgBuff = s_coalesceSlot[frameType];
+    }
+    if (msgBuff != NULL)
+    {
+        CANMiddleWare_CreateMessageBuffer(msgBuff, data, frameType);
+        msgBuff->time = FlexCAN_GetTime(CAN_0);
+        s_stats.txCoalesced++;
+        queued = true;
+    }
+    else
+    {
+        msgBuff = CAN_Heap_Claim(&s_heapCanTransmit);
+        queued = (msgBuff != NULL);
+        if (queued)
+        {
+            CANMiddleWare_CreateMessageBuffer(msgBuff, data, frameType);
+            msgBuff->time = FlexCAN_GetTime(CAN_0);
+            if (coalesce)
+            {
+                s_coalesceSlot[frameType] = msgBuff;
+            }
+            if ((coalesce) && ((s_coalesceInFlight & (1UL << frameType)) != 0U))
+            {
+                s_coalesceParked |= (1UL << frameType);
+            }
+            else
+            {
+                CAN_Heap_Commit(&s_heapCanTransmit, msgBuff);
+            }
+        }
+        CANMiddleware_QueueAccount(&s_stats.tx, CAN_Heap_Count(&s_heapCanTransmit), queued);
+    }
+    FlexCAN_EnableIRQ(CAN_0);
+
+    return queued;
+}
 
-    CANMiddleWare_ConvertDataUartToCan(&msgBuff, data);
-    CAN_Queue_Push(&s_queueCanTransmit, &msgBuff);
-    if (s_queueCanTransmit.size == 1u)
+/* "Last value wins" for a node frame type: a new value replaces the one still
+ * waiting in the transmit queue instead of being queued behind it */
+void CANMiddlewareNode_SetCoalescing(CAN_Middleware_FrameTypes_t frameType, bool enable)
+{
+    if ((uint32_t)frameType < CAN_FRAME_TYPE_COUNT)
     {
-        FlexCAN_Send(CAN_0, MB_TRANSMIT_INDEX, &msgBuff);
+        FlexCAN_DisableIRQ(CAN_0);
+        if (enable)
+        {
+            s_coalesceMask |= (1UL << frameType);
+        }
+        else
+        {
+            s_coalesceMask &= ~(1UL << frameType);
+            if ((s_coalesceParked & (1UL << frameType)) != 0U)
+            {
+                s_coalesceParked &= ~(1UL << frameType);
+                CAN_Heap_Commit(&s_heapCanTransmit, s_coalesceSlot[frameType]);
+            }
+            s_coalesceSlot[frameType] = NULL;
+        }
+        FlexCAN_EnableIRQ(CAN_0);
     }
 }
 
 void CANMiddlewareNode_TransmitData(uint32_t data, CAN_Middleware_FrameTypes_t frameType)
 {
-    FlexCAN_TX_MessageBuffer_t msgBuff;
+    if (CANMiddleware_NodeEnqueue(data, frameType))
+    {
+        CANMiddleware_TxKick();
+    }
+}
+
+/* Request type of a received frame; a CONFIG request also updates nodeConfig */
+static CAN_Middleware_FrameTypes_t CANMiddleware_RequestAccept(const FlexCAN_TX_MessageBuffer_t *request, Node_Config_t *nodeConfig)
+{
+    CAN_Middleware_FrameTypes_t retVal;
 
-    CANMiddleWare_CreateMessageBuffer(&msgBuff, data, frameType);
-    CAN_Queue_Push(&s_queueCanTransmit, &msgBuff);
-    if (s_queueCanTransmit.size == 1)
+    /* Get request type */
+    retVal = (request->dataByte[1]);
+    if (retVal == FRAME_TYPE_CONFIG)
     {
-        FlexCAN_Send(CAN_0, MB_TRANSMIT_INDEX, &msgBuff);
+        nodeConfig->nodeID = (uint16_t)(request->dataByte[6]) | (uint16_t)((request->dataByte[5]) << ONE_BYTE);
+        nodeConfig->nodeType = request->dataByte[0];
+        nodeConfig->threshold = request->dataByte[7];
     }
+    CANMiddleware_LatencyRecord(&s_latencyRx, FlexCAN_GetTime(CAN_0) - request->time);
+
+    return retVal;
 }
 
+/* Oldest request only, FRAME_TYPE_NONE when nothing was received */
 CAN_Middleware_FrameTypes_t CANMiddlewareNode_CheckRequest(Node_Config_t *nodeConfig)
 {
     FlexCAN_TX_MessageBuffer_t *dataReceive = NULL;
-    CAN_Middleware_FrameTypes_t retVal = FRAME_TYPE_CONFIG;
+    CAN_Middleware_FrameTypes_t retVal = FRAME_TYPE_NONE;
 
-    CAN_Queue_Peek(&s_queueCanReceive, &dataReceive);
-    CAN_Queue_Pop(&s_queueCanReceive);
+    CANMiddleware_RxDmaPoll();
+    dataReceive = CAN_Ring_Peek(&s_ringCanReceive);
     if (dataReceive != NULL)
     {
-        /* Get request type */
-        retVal = (dataReceive->dataByte[1]);
-
-        if (retVal == FRAME_TYPE_CONFIG)
-        {
-            nodeConfig->nodeID = (uint16_t)(dataReceive->dataByte[6]) | (uint16_t)((dataReceive->dataByte[5]) << ONE_BYTE);
-            nodeConfig->nodeType = dataReceive->dataByte[0];
-            nodeConfig->threshold = dataReceive->dataByte[7];
-        }
+        retVal = CANMiddleware_RequestAccept(dataReceive, nodeConfig);
+        CAN_Ring_Release(&s_ringCanReceive);
     }
 
     return retVal;
 }
 
-void CANMiddleware_Init(CAN_MiddlewareConfig_t *config)
+/* NULL removes the handler, requests of that type are then consumed silently */
+void CANMiddlewareNode_RegisterHandler(CAN_Middleware_FrameTypes_t frameType, CAN_Middleware_RequestHandler handler)
+{
+    if ((uint32_t)frameType < CAN_FRAME_TYPE_COUNT)
+    {
+        s_requestHandler[frameType] = handler;
+    }
+}
+
+/*
+ * Hand every request queued on entry to the handler of its frame type. CONFIG,
+ * CHECK_CONNECTION, READ_DATA and RESET requests whose handler returns true are
+ * answered with the matching *_RESPONSE frame carrying responseData; responses
+ * are queued as they come and the transmit mailboxes are loaded once at the end.
+ * Returns the number of requests consumed, 0 when nothing was received
+ */
+uint32_t CANMiddlewareNode_Dispatch(Node_Config_t *nodeConfig)
 {
-    FlexCAN_RX_MessageBuffer_t configMbRx;
+    FlexCAN_TX_MessageBuffer_t *dataReceive;
+    CAN_Middleware_FrameTypes_t frameType;
+    CAN_Middleware_RequestHandler handler;
+    uint32_t pending;
+    uint32_t handled = 0;
+    uint32_t responded = 0;
+    uint32_t responseData;
 
-    /* CAN0: RX -> PTE4 */
-    PORTE->PCR[4] &= (~(PORT_PCR_MUX_MASK));
-    PORTE->PCR[4] |= PORT_PCR_MUX(5);
-    /* CAN0: TX -> PTE5 */
-    PORTE->PCR[5] &= (~(PORT_PCR_MUX_MASK));
-    PORTE->PCR[5] |= PORT_PCR_MUX(5);
-    s_callbackTransmit = config->TxCallback;
-    s_callbackReceive = config->RxCallback;
-    s_NodeConfigPtr = config->nodeConfigPtr;
-    configMbRx.cfControl = s_config;
-    
-    /**** Config ID for CAN for fwd ****/
-    if ((s_NodeConfigPtr->nodeType == NODE_TYPE_FORWARDER) \
-    || (s_NodeConfigPtr->nodeType == NODE_TYPE_ANGLE)      \
-    || (s_NodeConfigPtr->nodeType == NODE_TYPE_DISTANCE))
+    CANMiddleware_RxDmaPoll();
+    pending = CAN_Ring_Count(&s_ringCanReceive);
+    while (handled < pending)
     {
-        configMbRx.RxIdMask = 0;
-        configMbRx.RxIdMask = (s_NodeConfigPtr->nodeID) << OFFSET_STANDARD_ID_MB;
-        configMbRx.cfID.id  = 0;
-        configMbRx.cfID.id  = (s_NodeConfigPtr->nodeID) << OFFSET_STANDARD_ID_MB;
+        dataReceive = CAN_Ring_Peek(&s_ringCanReceive);
+        frameType = CANMiddleware_RequestAccept(dataReceive, nodeConfig);
+        handler = ((uint32_t)frameType < CAN_FRAME_TYPE_COUNT) ? s_requestHandler[frameType] : NULL;
+        responseData = 0U;
+        if ((handler != NULL) && (handler(frameType, dataReceive, &responseData)) &&
+            (s_responseType[frameType] != FRAME_TYPE_NONE))
+        {
+            responded += CANMiddleware_NodeEnqueue(responseData, s_responseType[frameType]) ? 1U : 0U;
+        }
+        CAN_Ring_Release(&s_ringCanReceive);
+        handled++;
     }
-  
-    FlexCAN_Init(CAN_0, MSG_BUF_WORD_SIZE, &s_bitTiming);
-    FlexCAN_Config_RX_MessageBuffer(CAN_0, MB_RECEIVE_INDEX, &configMbRx);
-    /* enable interrupt */
-    FlexCAN_ConfigInterrupt(CAN_0, MB_TRANSMIT_INDEX);
-    FlexCAN_ConfigInterrupt(CAN_0, MB_RECEIVE_INDEX);
-    FlexCAN_InitIRQ(CAN_0, CAN0_ORed_0_15_MB_IRQn, CANMiddleware_IrqHandler);
+    if (responded != 0U)
+    {
+        CANMiddleware_TxKick();
+    }
+
+    return handled;
+}
+
+/* Queue one periodic frame built at its release, false when the queue is full.
+ * The provider fills a local frame, so it runs with the CAN interrupt enabled;
+ * payload bytes it leaves alone go out as 0 */
+static bool CANMiddleware_ScheduleRelease(const CAN_Middleware_Schedule_t *entry, uint64_t releaseTime)
+{
+    FlexCAN_TX_MessageBuffer_t *msgBuff;
+    FlexCAN_TX_MessageBuffer_t frame;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.cfControl = s_config;
+    frame.cfControl.dlc = MB_MAX_DLC;
+    frame.cfID.id = entry->id;
+    frame.cfID.prio = FRAME_PRIO_CONTROL;
+    entry->provider(&frame);
+    /* Latency is counted from the planned release, lateness of the run included */
+    frame.time = releaseTime;
+
+    FlexCAN_DisableIRQ(CAN_0);
+    msgBuff = CAN_Heap_Claim(&s_heapCanTransmit);
+    if (msgBuff != NULL)
+    {
+        *msgBuff = frame;
+        CAN_Heap_Commit(&s_heapCanTransmit, msgBuff);
+    }
+    CANMiddleware_QueueAccount(&s_stats.tx, CAN_Heap_Count(&s_heapCanTransmit), (msgBuff != NULL));
+    FlexCAN_EnableIRQ(CAN_0);
+
+    return (msgBuff != NULL);
+}
+
+/* Restore the heap order after the release time of the root entry grew */
+static void CANMiddleware_ScheduleSiftDown(void)
+{
+    uint8_t root = s_scheduleOrder[0];
+    uint32_t position = 0U;
+    uint32_t child = 1U;
+
+    while (child < s_scheduleCount)
+    {
+        if (((child + 1U) < s_scheduleCount) &&
+            (s_scheduleNext[s_scheduleOrder[child + 1U]] < s_scheduleNext[s_scheduleOrder[child]]))
+        {
+            child++;
+        }
+        if (s_scheduleNext[s_scheduleOrder[child]] < s_scheduleNext[root])
+        {
+            s_scheduleOrder[position] = s_scheduleOrder[child];
+            position = child;
+            child = (2U * position) + 1U;
+        }
+        else
+        {
+            child = s_scheduleCount;
+        }
+    }
+    s_scheduleOrder[position] = root;
+}
+
+/*
+ * Install a periodic transmit schedule (NULL or count 0 removes it). The table
+ * is used in place and must stay valid; every entry needs a provider and a
+ * non-zero period. Offsets count from this call
+ */
+bool CANMiddleware_ScheduleConfig(const CAN_Middleware_Schedule_t *table, uint8_t count)
+{
+    bool retVal = (count <= CAN_SCHEDULE_MAX) && ((table != NULL) || (count == 0U));
+    uint64_t now;
+    uint8_t index;
+    uint32_t position;
+
+    for (index = 0U; (retVal) && (index < count); index++)
+    {
+        retVal = (table[index].provider != NULL) && (table[index].period != 0U);
+    }
+    if (retVal)
+    {
+        s_scheduleCount = 0U;
+        s_schedule = table;
+        now = FlexCAN_GetTime(CAN_0);
+        for (index = 0U; index < count; index++)
+        {
+            /* Sift the new entry up */
+            s_scheduleNext[index] = now + table[index].offset;
+            position = index;
+            while ((position != 0U) && (s_scheduleNext[index] < s_scheduleNext[s_scheduleOrder[(position - 1U) / 2U]]))
+            {
+                s_scheduleOrder[position] = s_scheduleOrder[(position - 1U) / 2U];
+                position = (position - 1U) / 2U;
+            }
+            s_scheduleOrder[position] = index;
+        }
+        s_scheduleCount = count;
+    }
+
+    return retVal;
+}
+
+/*
+ * Release every scheduled frame that is due, to be called from a periodic tick
+ * (e.g. SysTick) at a rate finer than the shortest period. Frames are queued
+ * with their planned release as time and the mailboxes are loaded once. When a
+ * run comes more than a period late the missed releases are skipped rather than
+ * sent back to back. Returns the number of frames released
+ */
+uint32_t CANMiddleware_ScheduleRun(void)
+{
+    const CAN_Middleware_Schedule_t *entry;
+    uint64_t now;
+    uint64_t release;
+    uint32_t released = 0;
+    uint8_t index;
+
+    CANMiddleware_RxDmaPoll();
+    if (s_scheduleCount != 0U)
+    {
+        now = FlexCAN_GetTime(CAN_0);
+        while (s_scheduleNext[s_scheduleOrder[0]] <= now)
+        {
+            index = s_scheduleOrder[0];
+            entry = &s_schedule[index];
+            release = s_scheduleNext[index];
+            released += CANMiddleware_ScheduleRelease(entry, release) ? 1U : 0U;
+            s_scheduleNext[index] = release + entry->period;
+            if (s_scheduleNext[index] <= now)
+            {
+                s_stats.txScheduleLate += (uint32_t)((now - s_scheduleNext[index]) / entry->period) + 1U;
+                s_scheduleNext[index] += (((now - s_scheduleNext[index]) / entry->period) + 1U) * entry->period;
+            }
+            CANMiddleware_ScheduleSiftDown();
+        }
+        if (released != 0U)
+        {
+            CANMiddleware_TxKick();
+        }
+    }
+
+    return released;
+}
+
+/* What the middleware does with a CAN0 frame on arrival, before it reaches the
+ * receive ring (or is dropped because the ring is full). Returns true when the
+ * frame belongs to the transport and must not reach the ring */
+static bool CANMiddleware_RxIngress(const FlexCAN_TX_MessageBuffer_t *frame)
+{
+    bool consumed = CANMiddleware_TpIngress(frame);
+
+    if (!consumed)
+    {
+        CANMiddleware_NodeRecord(frame);
+        CANMiddleware_GatewayRoute(CAN_0, frame);
+    }
+
+    return consumed;
+}
+
+/* Queue one transport frame: PCI bytes, data, padding up to 8 bytes. From the
+ * CAN interrupt or with it masked; NULL when the queue is full */
+static FlexCAN_TX_MessageBuffer_t *CANMiddleware_TpEnqueue(const uint8_t *pci, uint8_t pciLength, const uint8_t *data, uint8_t dataLength, uint8_t prio)
+{
+    FlexCAN_TX_MessageBuffer_t *msgBuff = CAN_Heap_Claim(&s_heapCanTransmit);
+
+    if (msgBuff != NULL)
+    {
+        msgBuff->cfControl = s_config;
+        msgBuff->cfControl.dlc = MB_MAX_DLC;
+        msgBuff->cfID.id = s_tp->txId;
+        msgBuff->cfID.prio = prio;
+        memcpy(msgBuff->dataByte, pci, pciLength);
+        memcpy(&msgBuff->dataByte[pciLength], data, dataLength);
+        memset(&msgBuff->dataByte[pciLength + dataLength], TP_PADDING, MB_MAX_DLC - pciLength - dataLength);
+        msgBuff->time = FlexCAN_GetTime(CAN_0);
+        CAN_Heap_Commit(&s_heapCanTransmit, msgBuff);
+    }
+    CANMiddleware_QueueAccount(&s_stats.tx, CAN_Heap_Count(&s_heapCanTransmit), (msgBuff != NULL));
+
+    return msgBuff;
+}
+
+/* Separation time asked for by a flow control, in timer ticks */
+static uint32_t CANMiddleware_TpStMinTicks(uint8_t stMin)
+{
+    uint32_t ticks = TP_STMIN_MS_MAX * (uint32_t)s_tp->bitTimesPerMs;
+
+    if (stMin <= TP_STMIN_MS_MAX)
+    {
+        ticks = stMin * (uint32_t)s_tp->bitTimesPerMs;
+    }
+    else if ((stMin >= TP_STMIN_US_FIRST) && (stMin <= TP_STMIN_US_LAST))
+    {
+        ticks = ((stMin - TP_STMIN_US_BASE) * (uint32_t)s_tp->bitTimesPerMs) / TP_STMIN_US_PER_MS;
+    }
+
+    return ticks;
+}
+
+/* Queue the next consecutive frame once it is due and the previous one has
+ * been sent, from the CAN interrupt or with it masked. The transfer waits for a
+ * flow control after each block and keeps the receiver's separation time
+ * between frames, and ends once its last frame is on the bus; returns the
+ * frames queued */
+static uint32_t CANMiddleware_TpPump(uint64_t now)
+{
+    uint32_t queued = 0;
+    uint8_t dataLength;
+    uint8_t pci;
+
+    if ((s_tpTxState == TP_TX_SEND_CF) && (s_tpTxNext <= now) && (s_tpTxSlot == NULL) && (s_tpTxMb == TP_MB_NONE))
+    {
+        pci = (uint8_t)((TP_PCI_CONSECUTIVE << TP_PCI_SHIFT) | s_tpTxSeq);
+        dataLength = ((uint32_t)(s_tpTxLength - s_tpTxOffset) < TP_CF_DATA_LENGTH) ? (uint8_t)(s_tpTxLength - s_tpTxOffset) : TP_CF_DATA_LENGTH;
+        s_tpTxSlot = CANMiddleware_TpEnqueue(&pci, 1U, &s_tpTxData[s_tpTxOffset], dataLength, FRAME_PRIO_DATA);
+        if (s_tpTxSlot != NULL)
+        {
+            s_tpTxOffset += dataLength;
+            s_tpTxSeq = (s_tpTxSeq + 1U) & TP_PCI_NIBBLE_MASK;
+            s_tpTxNext = now + s_tpTxStMin;
+            queued++;
+            if (s_tpTxOffset == s_tpTxLength)
+            {
+                s_tpTxState = TP_TX_SEND_LAST;
+                s_tpTxNext = now + s_tpTimeout;
+            }
+            else if (s_tpTxBlockLeft != 0U)
+            {
+                s_tpTxBlockLeft--;
+                if (s_tpTxBlockLeft == 0U)
+                {
+                    s_tpTxState = TP_TX_WAIT_FC;
+                    s_tpTxNext = now + s_tpTimeout;
+                }
+            }
+        }
+    }
+
+    return queued;
+}
+
+/* End our transfer: success once its last frame was sent, failure on a flow
+ * control overflow, a timeout or a frame the driver refused */
+static void CANMiddleware_TpTxEnd(bool success)
+{
+    s_tpTxState = TP_TX_IDLE;
+    if (s_tp->txDone != NULL)
+    {
+        s_tp->txDone(success, success ? s_tpTxLength : s_tpTxOffset);
+    }
+}
+
+/* Answer the sender of the transfer being received, from the CAN interrupt */
+static void CANMiddleware_TpFlowControl(uint8_t flowStatus)
+{
+    uint8_t pci[3];
+
+    pci[0] = (uint8_t)((TP_PCI_FLOW_CONTROL << TP_PCI_SHIFT) | flowStatus);
+    pci[1] = s_tp->blockSize;
+    pci[2] = s_tp->stMin;
+    if (CANMiddleware_TpEnqueue(pci, 3U, pci, 0U, FRAME_PRIO_CONTROL) != NULL)
+    {
+        CANMiddleware_TxLoad();
+    }
+}
+
+/* Transport frames from the peer, from the CAN interrupt: segments are copied
+ * straight into the caller's buffer, flow controls drive our own transfer.
+ * Returns true when the frame belongs to the transport */
+static bool CANMiddleware_TpIngress(const FlexCAN_TX_MessageBuffer_t *frame)
+{
+    const uint8_t *data = frame->dataByte;
+    bool consumed = (s_tp != NULL) && (frame->cfID.id == s_tp->rxId) && (frame->cfControl.ide == s_config.ide) &&
+                    (frame->cfControl.rtr == 0U) && (frame->cfControl.dlc != 0U);
+    uint8_t type = data[0] >> TP_PCI_SHIFT;
+    uint8_t frameLength = FlexCAN_DlcToLength((uint8_t)frame->cfControl.dlc);
+    uint8_t dataLength;
+    uint16_t length;
+
+    if ((consumed) && ((type == TP_PCI_SINGLE) || (type == TP_PCI_FIRST)))
+    {
+        /* Either one starts a new reception, one under way is dropped */
+        length = (type == TP_PCI_SINGLE) ? (uint16_t)(data[0] & TP_PCI_NIBBLE_MASK) :
+                 (uint16_t)(((uint16_t)(data[0] & TP_PCI_NIBBLE_MASK) << ONE_BYTE) | data[1]);
+        if ((type == TP_PCI_SINGLE) && (s_tpRxState != TP_RX_IDLE) && (length != 0U) &&
+            (length <= TP_SF_MAX_LENGTH) && (length <= s_tpRxSize) && (length < frameLength))
+        {
+            memcpy(s_tpRxBuffer, &data[1], length);
+            s_tpRxState = TP_RX_IDLE;
+            if (s_tp->rxDone != NULL)
+            {
+                s_tp->rxDone(true, length);
+            }
+        }
+        else if ((type == TP_PCI_FIRST) && (s_tpRxState != TP_RX_IDLE) && (length > TP_SF_MAX_LENGTH) &&
+                 (length <= s_tpRxSize) && (frameLength >= MB_MAX_DLC))
+        {
+            memcpy(s_tpRxBuffer, &data[2], TP_FF_DATA_LENGTH);
+            s_tpRxLength = length;
+            s_tpRxOffset = TP_FF_DATA_LENGTH;
+            s_tpRxSeq = 1U;
+            s_tpRxBlockCount = 0U;
+            s_tpRxDeadline = frame->time + s_tpTimeout;
+            s_tpRxState = TP_RX_ACTIVE;
+            CANMiddleware_TpFlowControl(TP_FS_CTS);
+        }
+        else if ((type == TP_PCI_FIRST) && (frameLength >= MB_MAX_DLC))
+        {
+            /* No buffer, or one too small */
+            CANMiddleware_TpFlowControl(TP_FS_OVERFLOW);
+        }
+    }
+    else if ((consumed) && (type == TP_PCI_CONSECUTIVE) && (s_tpRxState == TP_RX_ACTIVE))
+    {
+        /* A frame out of sequence or too short for its segment ends the transfer */
+        dataLength = ((uint32_t)(s_tpRxLength - s_tpRxOffset) < TP_CF_DATA_LENGTH) ? (uint8_t)(s_tpRxLength - s_tpRxOffset) : TP_CF_DATA_LENGTH;
+        if (((data[0] & TP_PCI_NIBBLE_MASK) == s_tpRxSeq) && (dataLength < frameLength))
+        {
+            memcpy(&s_tpRxBuffer[s_tpRxOffset], &data[1], dataLength);
+            s_tpRxOffset += dataLength;
+            s_tpRxSeq = (s_tpRxSeq + 1U) & TP_PCI_NIBBLE_MASK;
+            s_tpRxDeadline = frame->time + s_tpTimeout;
+            s_tpRxBlockCount++;
+            if (s_tpRxOffset == s_tpRxLength)
+            {
+                s_tpRxState = TP_RX_IDLE;
+                if (s_tp->rxDone != NULL)
+                {
+                    s_tp->rxDone(true, s_tpRxLength);
+                }
+            }
+            else if ((s_tp->blockSize != 0U) && (s_tpRxBlockCount == s_tp->blockSize))
+            {
+                s_tpRxBlockCount = 0U;
+                CANMiddleware_TpFlowControl(TP_FS_CTS);
+            }
+        }
+        else
+        {
+            s_tpRxState = TP_RX_IDLE;
+            if (s_tp->rxDone != NULL)
+            {
+                s_tp->rxDone(false, s_tpRxOffset);
+            }
+        }
+    }
+    else if ((consumed) && (type == TP_PCI_FLOW_CONTROL) && (s_tpTxState == TP_TX_WAIT_FC))
+    {
+        if ((data[0] & TP_PCI_NIBBLE_MASK) == TP_FS_CTS)
+        {
+            s_tpTxBlockLeft = data[1];
+            s_tpTxStMin = CANMiddleware_TpStMinTicks(data[2]);
+            s_tpTxNext = frame->time;
+            s_tpTxState = TP_TX_SEND_CF;
+            if (CANMiddleware_TpPump(frame->time) != 0U)
+            {
+                CANMiddleware_TxLoad();
+            }
+        }
+        else if ((data[0] & TP_PCI_NIBBLE_MASK) == TP_FS_WAIT)
+        {
+            s_tpTxNext = frame->time + s_tpTimeout;
+        }
+        else
+        {
+            CANMiddleware_TpTxEnd(false);
+        }
+    }
+
+    return consumed;
+}
+
+/* Install the transport configuration, NULL turns it off. Transfers under way
+ * are dropped; the configuration is used in place and must stay valid */
+bool CANMiddlewareTp_Config(const CAN_Middleware_TpConfig_t *config)
+{
+    bool retVal = (config == NULL) || (config->bitTimesPerMs != 0U);
+
+    if (retVal)
+    {
+        FlexCAN_DisableIRQ(CAN_0);
+        s_tp = config;
+        s_tpTxState = TP_TX_IDLE;
+        s_tpRxState = TP_RX_IDLE;
+        if (config != NULL)
+        {
+            s_tpTimeout = (config->timeout != 0U) ? config->timeout : (TP_TIMEOUT_MS_DEFAULT * (uint32_t)config->bitTimesPerMs);
+        }
+        FlexCAN_EnableIRQ(CAN_0);
+    }
+
+    return retVal;
+}
+
+/* Start sending length bytes (1 to 4095) to the peer, false while a transfer
+ * is under way or the queue is full. data is read until txDone */
+bool CANMiddlewareTp_Send(const uint8_t *data, uint16_t length)
+{
+    uint8_t pci[2];
+    bool retVal = (s_tp != NULL) && (data != NULL) && (length != 0U) && (length <= TP_MAX_LENGTH);
+
+    if (retVal)
+    {
+        FlexCAN_DisableIRQ(CAN_0);
+        /* A frame left by a transfer that timed out still holds the order */
+        retVal = (s_tpTxState == TP_TX_IDLE) && (s_tpTxSlot == NULL) && (s_tpTxMb == TP_MB_NONE);
+        if ((retVal) && (length <= TP_SF_MAX_LENGTH))
+        {
+            pci[0] = (uint8_t)length;
+            s_tpTxSlot = CANMiddleware_TpEnqueue(pci, 1U, data, (uint8_t)length, FRAME_PRIO_DATA);
+            retVal = (s_tpTxSlot != NULL);
+            if (retVal)
+            {
+                s_tpTxLength = length;
+                s_tpTxOffset = length;
+                s_tpTxNext = FlexCAN_GetTime(CAN_0) + s_tpTimeout;
+                s_tpTxState = TP_TX_SEND_LAST;
+            }
+        }
+        else if (retVal)
+        {
+            pci[0] = (uint8_t)((TP_PCI_FIRST << TP_PCI_SHIFT) | (length >> ONE_BYTE));
+            pci[1] = (uint8_t)length;
+            retVal = (CANMiddleware_TpEnqueue(pci, 2U, data, TP_FF_DATA_LENGTH, FRAME_PRIO_DATA) != NULL);
+            if (retVal)
+            {
+                s_tpTxData = data;
+                s_tpTxLength = length;
+                s_tpTxOffset = TP_FF_DATA_LENGTH;
+                s_tpTxSeq = 1U;
+                s_tpTxNext = FlexCAN_GetTime(CAN_0) + s_tpTimeout;
+                s_tpTxState = TP_TX_WAIT_FC;
+            }
+        }
+        FlexCAN_EnableIRQ(CAN_0);
+        if (retVal)
+        {
+            CANMiddleware_TxKick();
+        }
+    }
+
+    return retVal;
+}
+
+/* Give the transport a buffer for the next transfer from the peer, false while
+ * one is being received. The buffer is written until rxDone */
+bool CANMiddlewareTp_Receive(uint8_t *buffer, uint16_t size)
+{
+    bool retVal = (s_tp != NULL) && (buffer != NULL) && (size != 0U);
+
+    if (retVal)
+    {
+        FlexCAN_DisableIRQ(CAN_0);
+        retVal = (s_tpRxState != TP_RX_ACTIVE);
+        if (retVal)
+        {
+            s_tpRxBuffer = buffer;
+            s_tpRxSize = size;
+            s_tpRxState = TP_RX_ARMED;
+        }
+        FlexCAN_EnableIRQ(CAN_0);
+    }
+
+    return retVal;
+}
+
+/*
+ * Advance the transfers, to be called from a periodic tick like
+ * CANMiddleware_ScheduleRun: queues the consecutive frames whose separation
+ * time has passed and gives up transfers whose peer stayed silent, or whose
+ * last frame was not sent, for the timeout. Returns the number of frames queued
+ */
+uint32_t CANMiddlewareTp_Run(void)
+{
+    uint64_t now;
+    uint32_t queued = 0;
+
+    CANMiddleware_RxDmaPoll();
+    now = FlexCAN_GetTime(CAN_0);
+    if (s_tp != NULL)
+    {
+        FlexCAN_DisableIRQ(CAN_0);
+        if (((s_tpTxState == TP_TX_WAIT_FC) || (s_tpTxState == TP_TX_SEND_LAST)) && (s_tpTxNext < now))
+        {
+            CANMiddleware_TpTxEnd(false);
+        }
+        if ((s_tpRxState == TP_RX_ACTIVE) && (s_tpRxDeadline < now))
+        {
+            s_tpRxState = TP_RX_IDLE;
+            if (s_tp->rxDone != NULL)
+            {
+                s_tp->rxDone(false, s_tpRxOffset);
+            }
+        }
+        queued = CANMiddleware_TpPump(now);
+        CANMiddleware_TxLoad();
+        FlexCAN_EnableIRQ(CAN_0);
+    }
+
+    return queued;
+}
+
+/* Registry entry of a node, CAN_NODE_MAX when it is unknown. With create an
+ * unknown node gets an entry while the registry has room */
+static uint8_t CANMiddleware_NodeFind(uint8_t nodeType, uint16_t nodeID, bool create)
+{
+    uint32_t key = NODE_KEY(nodeType, nodeID);
+    uint32_t position = ((key * NODE_HASH_MULTIPLIER) >> TWO_BYTES) % NODE_HASH_SIZE;
+    uint32_t probe;
+    uint8_t retVal = CAN_NODE_MAX;
+
+    for (probe = 0U; (probe < NODE_HASH_SIZE) && (retVal == CAN_NODE_MAX) && (s_nodeHash[position] != NODE_HASH_EMPTY); probe++)
+    {
+        if (NODE_KEY(s_node[s_nodeHash[position]].nodeType, s_node[s_nodeHash[position]].nodeID) == key)
+        {
+            retVal = s_nodeHash[position];
+        }
+        else
+        {
+            position = (position + 1U) % NODE_HASH_SIZE;
+        }
+    }
+    /* The table is at most half full, position is an empty bucket */
+    if ((retVal == CAN_NODE_MAX) && (create) && (s_nodeCount < CAN_NODE_MAX))
+    {
+        retVal = s_nodeCount;
+        memset(&s_node[retVal], 0, sizeof(CAN_Middleware_Node_t));
+        s_node[retVal].nodeType = nodeType;
+        s_node[retVal].nodeID = nodeID;
+        s_nodeHead[retVal] = 0U;
+        s_nodeTail[retVal] = 0U;
+        s_nodeHash[position] = retVal;
+        s_nodeCount++;
+    }
+
+    return retVal;
+}
+
+/* Update the registry with a node frame received by the forwarder */
+static void CANMiddleware_NodeRecord(const FlexCAN_TX_MessageBuffer_t *frame)
+{
+    CAN_Middleware_Node_t *node;
+    uint8_t slot;
+
+    if ((s_nodeRegistry) && (frame->cfControl.rtr == 0U) && (frame->cfControl.dlc >= MB_MAX_DLC))
+    {
+        slot = CANMiddleware_NodeFind(frame->dataByte[0],
+                                      (uint16_t)(frame->dataByte[2] | ((uint16_t)frame->dataByte[3] << ONE_BYTE)), true);
+        if (slot < CAN_NODE_MAX)
+        {
+            node = &s_node[slot];
+            node->last.time = frame->time;
+            node->last.data = ((uint32_t)frame->dataByte[4] << TWO_BYTES) | ((uint32_t)frame->dataByte[5] << ONE_BYTE) |
+                              frame->dataByte[6];
+            node->last.frameType = frame->dataByte[1];
+            node->last.threshold = frame->dataByte[7];
+            node->lastSeen = frame->time;
+            node->frames++;
+            if (frame->dataByte[1] == FRAME_TYPE_CHECK_CONNECTION_RESPONSE)
+            {
+                node->lastAlive = frame->time;
+                node->state = NODE_STATE_ALIVE;
+            }
+            if ((uint8_t)(s_nodeHead[slot] - s_nodeTail[slot]) < CAN_NODE_QUEUE_DEPTH)
+            {
+                s_nodeQueue[slot][s_nodeHead[slot] & (CAN_NODE_QUEUE_DEPTH - 1U)] = node->last;
+                s_nodeHead[slot]++;
+            }
+            else
+            {
+                node->dropped++;
+            }
+        }
+        else
+        {
+            s_stats.nodeOverflow++;
+        }
+    }
+}
+
+/* Copy a registry entry, an alive node without a response for longer than the
+ * node timeout is lost from now on */
+static void CANMiddleware_NodeCopy(uint8_t slot, uint64_t now, CAN_Middleware_Node_t *node)
+{
+    if ((s_node[slot].state == NODE_STATE_ALIVE) && ((now - s_node[slot].lastAlive) > s_nodeTimeout))
+    {
+        s_node[slot].state = NODE_STATE_LOST;
+    }
+    *node = s_node[slot];
+}
+
+/* Registry entry of one node, false when the forwarder has not heard from it */
+bool CANMiddlewareFwd_GetNode(uint8_t nodeType, uint16_t nodeID, CAN_Middleware_Node_t *node)
+{
+    uint64_t now;
+    uint8_t slot = CAN_NODE_MAX;
+
+    CANMiddleware_RxDmaPoll();
+    now = FlexCAN_GetTime(CAN_0);
+    if (node != NULL)
+    {
+        FlexCAN_DisableIRQ(CAN_0);
+        slot = CANMiddleware_NodeFind(nodeType, nodeID, false);
+        if (slot < CAN_NODE_MAX)
+        {
+            CANMiddleware_NodeCopy(slot, now, node);
+        }
+        FlexCAN_EnableIRQ(CAN_0);
+    }
+
+    return (slot < CAN_NODE_MAX);
+}
+
+/* Oldest queued report of one node, false when there is none */
+bool CANMiddlewareFwd_NodeReceive(uint8_t nodeType, uint16_t nodeID, CAN_Middleware_NodeReport_t *report)
+{
+    bool retVal = false;
+    uint8_t slot;
+
+    CANMiddleware_RxDmaPoll();
+    if (report != NULL)
+    {
+        FlexCAN_DisableIRQ(CAN_0);
+        slot = CANMiddleware_NodeFind(nodeType, nodeID, false);
+        if ((slot < CAN_NODE_MAX) && (s_nodeHead[slot] != s_nodeTail[slot]))
+        {
+            *report = s_nodeQueue[slot][s_nodeTail[slot] & (CAN_NODE_QUEUE_DEPTH - 1U)];
+            s_nodeTail[slot]++;
+            retVal = true;
+        }
+        FlexCAN_EnableIRQ(CAN_0);
+    }
+
+    return retVal;
+}
+
+/* Copy up to maxNodes registry entries in the order the nodes first appeared,
+ * with their state and last report. Returns the number copied */
+uint32_t CANMiddlewareFwd_ListNodes(CAN_Middleware_Node_t *nodes, uint32_t maxNodes)
+{
+    uint64_t now;
+    uint32_t count = 0;
+
+    CANMiddleware_RxDmaPoll();
+    now = FlexCAN_GetTime(CAN_0);
+    if (nodes != NULL)
+    {
+        FlexCAN_DisableIRQ(CAN_0);
+        while ((count < s_nodeCount) && (count < maxNodes))
+        {
+            CANMiddleware_NodeCopy((uint8_t)count, now, &nodes[count]);
+            count++;
+        }
+        FlexCAN_EnableIRQ(CAN_0);
+    }
+
+    return count;
+}
+
+/* Forward a frame received on source to the destinations of its route, from
+ * the receive interrupt of the source bus. Frames are copied once, straight
+ * into the transmit queue of each destination */
+static void CANMiddleware_GatewayRoute(uint32_t source, const FlexCAN_TX_MessageBuffer_t *frame)
+{
+    const CAN_Middleware_Route_t *route = NULL;
+    uint32_t key;
+    uint32_t low = 0U;
+    uint32_t high;
+    uint32_t middle;
+    uint32_t id;
+    uint8_t destMask;
+    uint8_t index;
+
+    if ((s_gwRoute != NULL) && (frame->cfControl.rtr == 0U))
+    {
+        key = (source << GATEWAY_KEY_SOURCE_SHIFT) | ((uint32_t)frame->cfControl.ide << GATEWAY_KEY_IDE_SHIFT) |
+              (frame->cfID.id & GATEWAY_ID_MASK);
+        /* Exact routes: first key not below the frame's */
+        high = s_gwExactCount;
+        while (low < high)
+        {
+            middle = (low + high) / 2U;
+            if (s_gwExactKey[middle] < key)
+            {
+                low = middle + 1U;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        if ((low < s_gwExactCount) && (s_gwExactKey[low] == key))
+        {
+            route = &s_gwRoute[s_gwExactRoute[low]];
+        }
+        for (index = s_gwMaskedFirst[source]; (route == NULL) && (index < s_gwMaskedFirst[source + 1U]); index++)
+        {
+            if (((key ^ s_gwMaskedKey[index]) & s_gwMaskedMask[index]) == 0U)
+            {
+                route = &s_gwRoute[s_gwMaskedRoute[index]];
+            }
+        }
+        if (route != NULL)
+        {
+            id = (frame->cfID.id & ~route->rewriteMask) | (route->rewriteId & route->rewriteMask);
+            destMask = route->destMask & s_gwBusUp & (uint8_t)~(1U << source);
+            while (destMask != 0U)
+            {
+                index = (uint8_t)__builtin_ctz(destMask);
+                destMask &= destMask - 1U;
+                if (CANMiddleware_GatewayEnqueue(index, frame, id & GATEWAY_ID_MASK))
+                {
+                    if (index == CAN_0)
+                    {
+                        CANMiddleware_TxKick();
+                    }
+                    else
+                    {
+                        CANMiddleware_GatewayKick(index);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Queue a routed frame on a destination bus, false when its queue is full or
+ * the frame is an FD frame for a classic gateway bus */
+static bool CANMiddleware_GatewayEnqueue(uint32_t instance, const FlexCAN_TX_MessageBuffer_t *frame, uint32_t id)
+{
+    CAN_Heap_t *heap = (instance == CAN_0) ? &s_heapCanTransmit : &s_gwHeap[instance - CAN_1];
+    FlexCAN_TX_MessageBuffer_t *msgTXBuff = NULL;
+    uint8_t dataLength = FlexCAN_DlcToLength((uint8_t)frame->cfControl.dlc);
+
+    if ((frame->cfControl.edl == 0U) && (dataLength > MB_MAX_DLC))
+    {
+        dataLength = MB_MAX_DLC;
+    }
+    FlexCAN_DisableIRQ(instance);
+    if ((instance == CAN_0) || (frame->cfControl.edl == 0U))
+    {
+        msgTXBuff = CAN_Heap_Claim(heap);
+    }
+    if (msgTXBuff != NULL)
+    {
+        msgTXBuff->cfControl = frame->cfControl;
+        msgTXBuff->cfControl.esi = 0U;
+        msgTXBuff->cfID.id = id;
+        msgTXBuff->cfID.prio = FRAME_PRIO_CONTROL;
+        memcpy(msgTXBuff->dataByte, frame->dataByte, dataLength);
+        msgTXBuff->time = FlexCAN_GetTime(instance);
+        CAN_Heap_Commit(heap, msgTXBuff);
+    }
+    CANMiddleware_QueueAccount(&s_stats.gateway, CAN_Heap_Count(heap), (msgTXBuff != NULL));
+    FlexCAN_EnableIRQ(instance);
+
+    return (msgTXBuff != NULL);
+}
+
+/* Move queued frames of a gateway bus into its idle transmit mailboxes */
+static void CANMiddleware_GatewayKick(uint32_t instance)
+{
+    FlexCAN_DisableIRQ(instance);
+    CANMiddleware_MbLoad(instance, &s_gwHeap[instance - CAN_1], &s_gwTxMbFree[instance - CAN_1]);
+    FlexCAN_EnableIRQ(instance);
+}
+
+/* Interrupt of a gateway bus: route what the Rx FIFO holds, refill the
+ * transmit mailboxes that finished */
+static void CANMiddleware_GatewayIrq(uint32_t instance, uint32_t flagMaskMB)
+{
+    FlexCAN_TX_MessageBuffer_t msgRXBuff;
+
+    if ((flagMaskMB & FLEXCAN_RX_FIFO_FLAG_MASK) != 0U)
+    {
+        flagMaskMB &= ~FLEXCAN_RX_FIFO_FLAG_MASK;
+        while (FlexCAN_ReadRxFifo(instance, &msgRXBuff, NULL) == FLEXCAN_RETURN_CODE_SUCCESS)
+        {
+            CANMiddleware_GatewayRoute(instance, &msgRXBuff);
+        }
+    }
+
+    s_gwTxMbFree[instance - CAN_1] |= flagMaskMB & s_gwTxMbMask[instance - CAN_1];
+    CANMiddleware_MbLoad(instance, &s_gwHeap[instance - CAN_1], &s_gwTxMbFree[instance - CAN_1]);
+}
+
+static void CANMiddleware_GatewayIrq1(uint32_t flagMaskMB)
+{
+    CANMiddleware_GatewayIrq(CAN_1, flagMaskMB);
+}
+
+static void CANMiddleware_GatewayIrq2(uint32_t flagMaskMB)
+{
+    CANMiddleware_GatewayIrq(CAN_2, flagMaskMB);
+}
+
+/* Bring up CAN1 or CAN2 as a classic gateway bus at the node bit rate: Rx FIFO
+ * with the given filters, the mailboxes after it transmit */
+static void CANMiddleware_GatewayBusInit(uint32_t instance, const FlexCAN_RxFifo_filter_t *filter, uint8_t count)
+{
+    PORT_Type *port = (instance == CAN_1) ? PORTA : PORTC;
+    uint32_t rxPin = (instance == CAN_1) ? GATEWAY_CAN1_RX_PIN : GATEWAY_CAN2_RX_PIN;
+    uint32_t txPin = (instance == CAN_1) ? GATEWAY_CAN1_TX_PIN : GATEWAY_CAN2_TX_PIN;
+    uint32_t txMbMask;
+    uint8_t firstFreeMB;
+
+    /* CAN1: RX -> PTA12, TX -> PTA13. CAN2: RX -> PTC16, TX -> PTC17 */
+    port->PCR[rxPin] = (port->PCR[rxPin] & ~PORT_PCR_MUX_MASK) | PORT_PCR_MUX(GATEWAY_PIN_MUX);
+    port->PCR[txPin] = (port->PCR[txPin] & ~PORT_PCR_MUX_MASK) | PORT_PCR_MUX(GATEWAY_PIN_MUX);
+    CAN_Heap_Init(&s_gwHeap[instance - CAN_1]);
+    FlexCAN_Init(instance, MSG_BUF_WORD_SIZE, &s_bitTiming);
+    FlexCAN_ConfigBegin(instance);
+    (void)FlexCAN_ConfigRxFifo(instance, filter, count);
+    firstFreeMB = FlexCAN_GetFirstFreeMB(instance);
+    txMbMask = MB_TRANSMIT_IRQ_MASK & ~((1UL << firstFreeMB) - 1U);
+    if (FlexCAN_GetNumberOfMB(instance) < 32U)
+    {
+        txMbMask &= (1UL << FlexCAN_GetNumberOfMB(instance)) - 1U;
+    }
+    s_gwTxMbMask[instance - CAN_1] = txMbMask;
+    s_gwTxMbFree[instance - CAN_1] = txMbMask;
+    FlexCAN_ConfigInterruptMask(instance, txMbMask | FLEXCAN_RX_FIFO_FLAG_MASK);
+    FlexCAN_ConfigCommit(instance);
+    FlexCAN_InitIRQ(instance, (instance == CAN_1) ? CAN1_ORed_0_15_MB_IRQn : CAN2_ORed_0_15_MB_IRQn,
+                    (instance == CAN_1) ? CANMiddleware_GatewayIrq1 : CANMiddleware_GatewayIrq2);
+}
+
+/*
+ * Install the gateway routing table (NULL or count 0 removes it), after
+ * CANMiddleware_Init. The table is used in place and must stay valid. CAN1 and
+ * CAN2 are brought up the first time a route names them; their Rx FIFO accepts
+ * the IDs routed from them (everything when more than 8 routes start there).
+ * Frames from CAN0 are routed as they are received, so its filters have to
+ * accept them too. Frames that find a destination queue full are dropped
+ */
+bool CANMiddleware_GatewayConfig(const CAN_Middleware_Route_t *table, uint8_t count)
+{
+    FlexCAN_RxFifo_filter_t filter[GATEWAY_FIFO_FILTERS];
+    bool retVal = (count <= CAN_GATEWAY_ROUTE_MAX) && ((table != NULL) || (count == 0U));
+    uint8_t busMask = 0U;
+    uint8_t filterCount;
+    uint8_t index;
+    uint8_t position;
+    uint32_t instance;
+    uint32_t key;
+
+    for (index = 0U; (retVal) && (index < count); index++)
+    {
+        retVal = (table[index].source < CAN_GATEWAY_BUS_COUNT) &&
+                 ((table[index].destMask & ~((1U << CAN_GATEWAY_BUS_COUNT) - 1U)) == 0U) &&
+                 (table[index].id <= GATEWAY_ID_MASK) && (table[index].ide <= 1U);
+        busMask |= (uint8_t)((1U << table[index].source) | table[index].destMask);
+    }
+    if (retVal)
+    {
+        for (instance = CAN_0; instance < CAN_GATEWAY_BUS_COUNT; instance++)
+        {
+            if ((s_gwBusUp & (1U << instance)) != 0U)
+            {
+                FlexCAN_DisableIRQ(instance);
+            }
+        }
+        s_gwRoute = NULL;
+        s_gwExactCount = 0U;
+        s_gwMaskedFirst[CAN_0] = 0U;
+        for (instance = CAN_0; instance < CAN_GATEWAY_BUS_COUNT; instance++)
+        {
+            s_gwMaskedFirst[instance + 1U] = s_gwMaskedFirst[instance];
+            filterCount = 0U;
+            for (index = 0U; index < count; index++)
+            {
+                if (table[index].source == instance)
+                {
+                    key = (instance << GATEWAY_KEY_SOURCE_SHIFT) | ((uint32_t)table[index].ide << GATEWAY_KEY_IDE_SHIFT) |
+                          (table[index].id & table[index].mask);
+                    if ((table[index].mask & GATEWAY_ID_MASK) == GATEWAY_ID_MASK)
+                    {
+                        /* Insert after the equal keys, the first of them wins */
+                        position = s_gwExactCount;
+                        while ((position != 0U) && (s_gwExactKey[position - 1U] > key))
+                        {
+                            s_gwExactKey[position] = s_gwExactKey[position - 1U];
+                            s_gwExactRoute[position] = s_gwExactRoute[position - 1U];
+                            position--;
+                        }
+                        s_gwExactKey[position] = key;
+                        s_gwExactRoute[position] = index;
+                        s_gwExactCount++;
+                    }
+                    else
+                    {
+                        position = s_gwMaskedFirst[instance + 1U];
+                        s_gwMaskedKey[position] = key;
+                        s_gwMaskedMask[position] = (0x3UL << GATEWAY_KEY_SOURCE_SHIFT) | (1UL << GATEWAY_KEY_IDE_SHIFT) |
+                                                   (table[index].mask & GATEWAY_ID_MASK);
+                        s_gwMaskedRoute[position] = index;
+                        s_gwMaskedFirst[instance + 1U]++;
+                    }
+                    if (filterCount < GATEWAY_FIFO_FILTERS)
+                    {
+                        filter[filterCount].id = table[index].id;
+                        filter[filterCount].mask = table[index].mask;
+                        filter[filterCount].ide = table[index].ide;
+                        filter[filterCount].rtr = 0U;
+                    }
+                    filterCount++;
+                }
+            }
+            if ((instance != CAN_0) && ((busMask & (1U << instance)) != 0U))
+            {
+                if ((filterCount == 0U) || (filterCount > GATEWAY_FIFO_FILTERS))
+                {
+                    /* Standard and extended frames with any ID */
+                    memset(filter, 0, 2U * sizeof(FlexCAN_RxFifo_filter_t));
+                    filter[1].ide = 1U;
+                    filterCount = 2U;
+                }
+                if ((s_gwBusUp & (1U << instance)) != 0U)
+                {
+                    (void)FlexCAN_ConfigRxFifo(instance, filter, filterCount);
+                }
+                else
+                {
+                    CANMiddleware_GatewayBusInit(instance, filter, filterCount);
+                    s_gwBusUp |= (uint8_t)(1U << instance);
+                    FlexCAN_DisableIRQ(instance);
+                }
+            }
+        }
+        s_gwRoute = (count != 0U) ? table : NULL;
+        for (instance = CAN_0; instance < CAN_GATEWAY_BUS_COUNT; instance++)
+        {
+            if ((s_gwBusUp & (1U << instance)) != 0U)
+            {
+                FlexCAN_EnableIRQ(instance);
+            }
+        }
+    }
+
+    return retVal;
+}
+
+/* False when FlexCAN_Init rejects the configuration (e.g. a wordSize above
+ * FLEXCAN_MAX_PAYLOAD), CAN0 is then left unconfigured, or when the receive
+ * filters cannot be set up in the mailboxes left by txMbMask */
+bool CANMiddleware_Init(CAN_MiddlewareConfig_t *config)
+{
+    FlexCAN_RxFilter_range_t nodeFilter[2] = { { 0U, 0U, 0U }, { 0U, 0U, 0U } };
+    uint8_t nodeFilterCount = 1U;
+    uint8_t firstFreeMB;
+    bool retVal;
+
+    /* CAN0: RX -> PTE4 */
+    PORTE->PCR[4] &= (~(PORT_PCR_MUX_MASK));
+    PORTE->PCR[4] |= PORT_PCR_MUX(5);
+    /* CAN0: TX -> PTE5 */
+    PORTE->PCR[5] &= (~(PORT_PCR_MUX_MASK));
+    PORTE->PCR[5] |= PORT_PCR_MUX(5);
+    s_callbackTransmit = config->TxCallback;
+    s_callbackReceive = config->RxCallback;
+    s_NodeConfigPtr = config->nodeConfigPtr;
+    CAN_Heap_Init(&s_heapCanTransmit);
+    memset(s_coalesceSlot, 0, sizeof(s_coalesceSlot));
+    memset(s_txMbCoalesce, CAN_FRAME_TYPE_COUNT, sizeof(s_txMbCoalesce));
+    s_coalesceInFlight = 0U;
+    s_coalesceParked = 0U;
+    s_scheduleCount = 0U;
+    s_gwRoute = NULL;
+    s_gwBusUp = (1U << CAN_0);
+    s_tp = NULL;
+    s_tpTxState = TP_TX_IDLE;
+    s_tpRxState = TP_RX_IDLE;
+    s_tpTxSlot = NULL;
+    s_tpTxMb = TP_MB_NONE;
+    s_nodeRegistry = (s_NodeConfigPtr->nodeType == NODE_TYPE_FORWARDER);
+    memset(s_nodeHash, NODE_HASH_EMPTY, sizeof(s_nodeHash));
+    s_nodeCount = 0U;
+    s_nodeTimeout = (config->nodeTimeout != 0U) ? config->nodeTimeout : NODE_TIMEOUT_DEFAULT;
+    CAN_Ring_Init(&s_ringCanReceive);
+    s_uartFill = 0U;
+    s_uartTxStart = config->uartTxStart;
+    s_uartTxLength[0] = 0U;
+    s_uartTxLength[1] = 0U;
+    s_uartTxActive = 0U;
+    s_uartTxBusy = false;
+    /* Frames of this node go out as FD frames when a data phase timing is given */
+    s_config.edl = (config->fdBitTiming != NULL) ? 1U : 0U;
+    s_config.brs = ((config->fdBitTiming != NULL) && (config->fdBrs)) ? 1U : 0U;
+    
+    /**** Config ID for CAN by default: the forwarder takes the IDs both node
+     * classes send to, a sensor node only frames to its own node ID ****/
+    if (s_NodeConfigPtr->nodeType == NODE_TYPE_FORWARDER)
+    {
+        nodeFilter[0].idLow  = (uint32_t)ID_FORWARDER_DISTANCE;
+        nodeFilter[0].idHigh = nodeFilter[0].idLow;
+        nodeFilter[0].ide    = s_config.ide;
+        nodeFilter[1].idLow  = (uint32_t)(ID_FORWARDER_ANGEL << OFFSET_STANDARD_ID_MB);
+        nodeFilter[1].idHigh = nodeFilter[1].idLow;
+        nodeFilter[1].ide    = s_config.ide;
+        nodeFilterCount = 2U;
+    }
+    else if ((s_NodeConfigPtr->nodeType == NODE_TYPE_ANGLE) \
+    || (s_NodeConfigPtr->nodeType == NODE_TYPE_DISTANCE))
+    {
+        nodeFilter[0].idLow  = (s_NodeConfigPtr->nodeID) << OFFSET_STANDARD_ID_MB;
+        nodeFilter[0].idHigh = nodeFilter[0].idLow;
+        nodeFilter[0].ide    = s_config.ide;
+    }
+  
+    retVal = (FlexCAN_Init(CAN_0, (config->wordSize != 0U) ? config->wordSize : MSG_BUF_WORD_SIZE, &s_bitTiming) ==
+              FLEXCAN_RETURN_CODE_SUCCESS);
+    if (retVal)
+    {
+        /* Everything below is applied in a single freeze window */
+        FlexCAN_ConfigBegin(CAN_0);
+        if (config->fdBitTiming != NULL)
+        {
+            FlexCAN_ConfigFD(CAN_0, config->fdBitTiming);
+        }
+        s_rxFifoEnabled = false;
+        if (config->rxFifoFilter != NULL)
+        {
+            s_rxFifoEnabled = (FlexCAN_ConfigRxFifo(CAN_0, config->rxFifoFilter, config->rxFifoFilterCount) == FLEXCAN_RETURN_CODE_SUCCESS);
+        }
+        /* The Rx FIFO and its filter table own the mailboxes below the first free one */
+        firstFreeMB = FlexCAN_GetFirstFreeMB(CAN_0);
+        if (config->txMbMask != 0U)
+        {
+            s_txMbMask = config->txMbMask;
+        }
+        else if (s_rxFifoEnabled)
+        {
+            s_txMbMask = MB_TRANSMIT_FIFO_DEFAULT_MASK << firstFreeMB;
+        }
+        else
+        {
+            s_txMbMask = MB_TRANSMIT_DEFAULT_MASK;
+        }
+        s_txMbMask &= MB_TRANSMIT_IRQ_MASK & ~((1UL << firstFreeMB) - 1U);
+        if (!s_rxFifoEnabled)
+        {
+            s_txMbMask &= ~(1UL << MB_RECEIVE_INDEX);
+        }
+        /* Keep the pool inside the mailboxes that fit the configured layout */
+        if (FlexCAN_GetNumberOfMB(CAN_0) < 32U)
+        {
+            s_txMbMask &= (1UL << FlexCAN_GetNumberOfMB(CAN_0)) - 1U;
+        }
+        s_txMbFree = s_txMbMask;
+        FlexCAN_ConfigTxArbitration(CAN_0, config->txArbitration);
+        /* Receive filters go to the interrupt-served mailboxes left by the transmit
+         * pool, MB1 first */
+        s_rxMbMask = 0U;
+        if (!s_rxFifoEnabled)
+        {
+            retVal = (FlexCAN_ConfigRxFilter(CAN_0, (config->rxFilter != NULL) ? config->rxFilter : nodeFilter,
+                                             (config->rxFilter != NULL) ? config->rxFilterCount : nodeFilterCount,
+                                             MB_TRANSMIT_IRQ_MASK & ~s_txMbMask, &s_rxMbMask) ==
+                      FLEXCAN_RETURN_CODE_SUCCESS);
+        }
+        /* enable interrupt */
+        FlexCAN_ConfigInterruptMask(CAN_0, s_txMbMask | s_rxMbMask | ((s_rxFifoEnabled) ? FLEXCAN_RX_FIFO_FLAG_MASK : 0U));
+        /* The DMA takes over the FIFO interrupts enabled above */
+        s_rxDmaRing = NULL;
+        if ((s_rxFifoEnabled) && (config->rxDmaRing != NULL) &&
+            (FlexCAN_ConfigRxFifoDma(CAN_0, config->rxDmaRing, config->rxDmaRingSize, CANMiddleware_RxDmaHandler) == FLEXCAN_RETURN_CODE_SUCCESS))
+        {
+            s_rxDmaRing = config->rxDmaRing;
+        }
+        FlexCAN_ConfigCommit(CAN_0);
+        FlexCAN_InitIRQ(CAN_0, CAN0_ORed_0_15_MB_IRQn, CANMiddleware_IrqHandler);
+    }
+
+    return retVal;
+}
+
+/* Copy the latency histograms; the transmit one is updated by the interrupt */
+void CANMiddleware_GetLatency(CAN_Middleware_Latency_t *rxLatency, CAN_Middleware_Latency_t *txLatency)
+{
+    FlexCAN_DisableIRQ(CAN_0);
+    if (rxLatency != NULL)
+    {
+        *rxLatency = s_latencyRx;
+    }
+    if (txLatency != NULL)
+    {
+        *txLatency = s_latencyTx;
+    }
+    FlexCAN_EnableIRQ(CAN_0);
+}
+
+void CANMiddleware_ResetLatency(void)
+{
+    FlexCAN_DisableIRQ(CAN_0);
+    memset(&s_latencyRx, 0, sizeof(s_latencyRx));
+    memset(&s_latencyTx, 0, sizeof(s_latencyTx));
+    FlexCAN_EnableIRQ(CAN_0);
+}
+
+/* Ring counters of the middleware, the driver counters come from FlexCAN_GetStats */
+void CANMiddleware_GetStats(CAN_Middleware_Stats_t *stats)
+{
+    if (stats != NULL)
+    {
+        FlexCAN_DisableIRQ(CAN_0);
+        *stats = s_stats;
+        FlexCAN_EnableIRQ(CAN_0);
+    }
+}
+
+void CANMiddleware_ResetStats(void)
+{
+    FlexCAN_DisableIRQ(CAN_0);
+    memset(&s_stats, 0, sizeof(s_stats));
+    FlexCAN_EnableIRQ(CAN_0);
+    FlexCAN_ResetStats(CAN_0);
 }
 
 /*******************************************************************************